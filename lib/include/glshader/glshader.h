@@ -96,6 +96,14 @@ public:
     if (geometryPath != nullptr)
       glDeleteShader(geometry);
   }
+  // wraps a program that is already linked, e.g. one loaded with glProgramBinary
+  // ------------------------------------------------------------------------
+  static Shader fromProgram(unsigned int program)
+  {
+    Shader shader;
+    shader.ID = program;
+    return shader;
+  }
   // activate the shader
   // ------------------------------------------------------------------------
   void use()
@@ -4,8 +4,23 @@
 
 void close()
 {
+  uploadThread.stop();
+
+  // what was shared over the run, before the handles go away
+  nsi::AssetRegistry::get().printReport();
+
+  fpsCam.setTerrain(nullptr);
+  if (terrainCollider)
+    delete terrainCollider;
+
+  if (scatterModel)
+    delete scatterModel;
+
   if (worldModel)
     delete worldModel;
+
+  if (jobSystem)
+    delete jobSystem;
   if (gridEBO)
     glDeleteBuffers(1, &gridEBO);
   if (gridVBO)
@@ -19,30 +34,6 @@ void close()
   SDL_Quit();
 }
 
-void checkShaderCompilation(GLuint shader, const char *type)
-{
-  GLint success;
-  GLchar infoLog[1024];
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-  if (!success)
-  {
-    glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-    std::cerr << "Shader Compilation Error (" << type << "): " << infoLog << std::endl;
-  }
-}
-
-void checkShaderLinking(GLuint program)
-{
-  GLint success;
-  GLchar infoLog[1024];
-  glGetProgramiv(program, GL_LINK_STATUS, &success);
-  if (!success)
-  {
-    glGetProgramInfoLog(program, 1024, NULL, infoLog);
-    std::cerr << "Shader Linking Error: " << infoLog << std::endl;
-  }
-}
-
 // Main Functions
 
 bool init()
@@ -96,54 +87,62 @@ bool init()
     return false;
   }
 
+  // textures are block compressed only into formats this driver can sample
+  nsi::TextureCache::get().setFormatSupport(nsi::detectTextureFormatSupport());
+
+  // linked programs kept across launches, per driver
+  nsi::ProgramCache::get().init();
+  nsi::ShaderManager::get().init();
+  if (hotReload)
+    nsi::ShaderManager::get().enableHotReload();
+
+  // model textures as handles in a material block, no texture units touched per mesh.
+  // A handle freezes every level of its texture, so an explicit budget turns it off and
+  // otherwise it turns streaming off
+  bool bindless = nsi::BindlessTextures::get().init(requestBindless && textureBudgetMB <= 0);
+  cout << "Bindless textures: " << (bindless ? "on" : !GLEW_ARB_bindless_texture ? "unsupported" : requestBindless ? "off, streaming under --texture-budget" : "off") << endl;
+
+  // textures start with coarse levels and gain detail as they come close
+  int budgetMB = textureBudgetMB >= 0 ? textureBudgetMB : bindless ? 0 : defaultTextureBudgetMB;
+  nsi::TextureStreamerSettings streaming;
+  streaming.enabled = budgetMB > 0;
+  streaming.budgetBytes = size_t(budgetMB) << 20;
+  nsi::TextureStreamer::get().setSettings(streaming);
+  if (streaming.enabled)
+    cout << "Texture streaming: " << budgetMB << " MB budget" << endl;
+  else
+    cout << "Texture streaming: off" << (bindless ? ", bindless textures keep every level" : "") << endl;
+
+  // not fatal, uploads then happen on the render thread
+  if (!uploadThread.start(window, context))
+    cerr << "Upload thread unavailable, uploading on the render thread" << endl;
+  else
+    nsi::TextureStreamer::get().setUploader(&uploadThread);
+
   return true;
 }
 
-GLuint loadShader(const char *vertexPath, const char *fragPath)
+// every program goes to the driver before anything loads and compiles meanwhile
+void submitShaders()
 {
-  GLuint shaderProgram = glCreateProgram();
-
-  ifstream vertexFile(vertexPath), fragFile(fragPath);
-  stringstream vertexStream, fragStream;
-
-  vertexStream << vertexFile.rdbuf();
-  fragStream << fragFile.rdbuf();
-
-  string vertexCode = vertexStream.str();
-  string fragCode = fragStream.str();
-
-  const char *vertexStr = vertexCode.c_str();
-  const char *fragStr = fragCode.c_str();
-
-  // vertex creation
-  GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertexShader, 1, &vertexStr, NULL);
-  glCompileShader(vertexShader);
-  checkShaderCompilation(vertexShader, "vertex");
-
-  // fragment creation
-  GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragShader, 1, &fragStr, NULL);
-  glCompileShader(fragShader);
-  checkShaderCompilation(fragShader, "fragment");
-
-  // shader binding
-  shaderProgram = glCreateProgram();
-  glAttachShader(shaderProgram, vertexShader);
-  glAttachShader(shaderProgram, fragShader);
-  glLinkProgram(shaderProgram);
-  checkShaderLinking(shaderProgram);
-
-  // delete shaders after linking
-  glDeleteShader(vertexShader);
-  glDeleteShader(fragShader);
-
-  return shaderProgram;
+  nsi::ShaderManager &shaders = nsi::ShaderManager::get();
+  gridShaderProgram = &shaders.submit("src/shaders/infiniteGrid/vertex.glsl", "src/shaders/infiniteGrid/frag.glsl");
+  terrainProgram = &shaders.submit("src/shaders/terrain/vertex.glsl", "src/shaders/terrain/frag.glsl");
+  clipmapProgram = &shaders.submit("src/shaders/clipmap/vertex.glsl", "src/shaders/clipmap/frag.glsl");
+  if (scatterPath)
+  {
+    // one program per set of maps the model's materials have, built as meshes need them;
+    // models whose materials fit no bindless block keep the plain ones
+    unsigned bindless = nsi::BindlessTextures::get().isEnabled() ? nsi::MATERIAL_BINDLESS : 0u;
+    instancedShaders = nsi::ShaderVariants("src/shaders/instanced/vertex.glsl", "src/shaders/instanced/frag.glsl", nsi::materialFeatureDefines());
+    instancedShaders.setFragmentFor(nsi::MATERIAL_BINDLESS, "src/shaders/instanced/fragBindless.glsl");
+    // diffuse only is what most models need, it compiles alongside loading like the rest
+    instancedShaders.variant(nsi::MATERIAL_DIFFUSE | bindless);
+  }
 }
 
 bool initGrid()
 {
-  gridShaderProgram = Shader("src/shaders/infiniteGrid/vertex.glsl", "src/shaders/infiniteGrid/frag.glsl");
   glGenVertexArrays(1, &gridVAO);
   glGenBuffers(1, &gridVBO);
   glGenBuffers(1, &gridEBO);
@@ -169,8 +168,16 @@ bool initGrid()
 
 bool drawWorldModel()
 {
-  worldProgram = Shader("src/shaders/worldModel/vertex.glsl", "src/shaders/worldModel/frag.glsl");
-  worldModel = new nsi::World("ext/models/mountain1/mesh_range01_05K_OBJ.obj", glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f), glm::vec3(1.0f));
+  nsi::TerrainSettings terrainSettings;
+  terrainSettings.worldSize = 16384.0f;
+  terrainSettings.lodLevels = 10;
+
+  // scanned mountain in the middle, procedural terrain everywhere else
+  auto heightSource = std::make_unique<nsi::BlendedHeightSource>(
+      std::make_unique<nsi::MeshHeightSource>("ext/models/mountain1/mesh_range01_05K_OBJ.obj", 1024, jobSystem),
+      std::make_unique<nsi::NoiseHeightSource>());
+  // placed at the origin so the collider's terrain space is world space
+  worldModel = new nsi::World(std::move(heightSource), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f), terrainSettings, jobSystem);
 
   if (worldModel == nullptr)
   {
@@ -178,9 +185,42 @@ bool drawWorldModel()
     return false;
   }
 
+  if (drawData.init())
+    worldModel->setDrawData(&drawData);
+
+  terrainCollider = new nsi::TerrainCollider(worldModel->getHeightSource(), 512.0f, 1.0f, jobSystem);
+  fpsCam.setTerrain(terrainCollider);
+
   return true;
 }
 
+void scatterInstances()
+{
+  if (!scatterPath)
+    return;
+
+  scatterModel = new nsi::InstancedModel(scatterPath, jobSystem, &uploadThread);
+  if (drawData.isReady())
+    scatterModel->setDrawData(&drawData);
+
+  const nsi::HeightSource &ground = worldModel->getHeightSource();
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> spread(-3000.0f, 3000.0f);
+  std::uniform_real_distribution<float> turn(0.0f, 6.2831853f);
+  std::uniform_real_distribution<float> size(0.8f, 1.2f);
+
+  nsi::InstanceSet &instances = scatterModel->getInstances();
+  instances.reserve(size_t(scatterCount));
+  for (int i = 0; i < scatterCount; i++)
+  {
+    float x = spread(rng);
+    float z = spread(rng);
+    glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(x, ground.heightAt(x, z), z));
+    transform = glm::rotate(transform, turn(rng), glm::vec3(0.0f, 1.0f, 0.0f));
+    instances.add(glm::scale(transform, glm::vec3(size(rng))));
+  }
+}
+
 void update()
 {
   // FPS Update logic
@@ -236,46 +276,312 @@ void handleFPSKeyMovement(SDL_Scancode key, float deltaTime)
 
 void handleKeys(SDL_Scancode key, float deltaTime)
 {
+  if (key == SDL_SCANCODE_TAB)
+    useFPSCamera = !useFPSCamera;
+
+  // M switches the terrain between CDLOD chunks and geometry clipmaps
+  if (key == SDL_SCANCODE_M)
+  {
+    bool clipmap = terrainMode == nsi::TerrainMode::CLIPMAP;
+    terrainMode = clipmap ? nsi::TerrainMode::CDLOD : nsi::TerrainMode::CLIPMAP;
+  }
+
   handleFPSKeyMovement(key, deltaTime);
 }
 
-void render()
+glm::mat4 getActiveViewMatrix()
+{
+  return useFPSCamera ? fpsCam.getViewMatrix(scheduler.getAlpha()) : orbitCam.getViewMatrix();
+}
+
+glm::vec3 getActiveCameraPosition()
+{
+  return useFPSCamera ? fpsCam.getRenderPosition(scheduler.getAlpha()) : orbitCam.Position;
+}
+
+glm::vec3 getActiveCameraFront()
+{
+  return useFPSCamera ? fpsCam.front : orbitCam.Front;
+}
+
+void logTerrainStats()
+{
+  const nsi::TerrainStats &stats = worldModel->getStats();
+  const nsi::StreamingStats &streaming = stats.streaming;
+
+  if (worldModel->getMode() == nsi::TerrainMode::CLIPMAP)
+  {
+    cout << "terrain (clipmap): tris " << stats.triangles
+         << " draws " << stats.drawCalls
+         << " uploaded texels " << stats.clipmap.uploadedTexels
+         << endl;
+    return;
+  }
+
+  cout << "terrain: nodes " << stats.selectedNodes
+       << " tris " << stats.triangles
+       << " draws " << stats.drawCalls
+       << " | resident " << streaming.residentChunks << " (" << streaming.gpuBytes / 1024 << " KB gpu)"
+       << " cpu " << streaming.cpuChunks << " (" << streaming.cpuBytes / 1024 << " KB)"
+       << " queued " << streaming.queued
+       << " building " << streaming.inFlight
+       << " evicted " << streaming.evictedGpu << "/" << streaming.evictedCpu
+       << endl;
+}
+
+void logSchedulerStats()
+{
+  const nsi::SchedulerStats &stats = scheduler.getStats();
+
+  cout << "simulation: frame " << stats.frameSeconds * 1000.0 << " ms"
+       << " steps " << stats.steps
+       << " deferred " << stats.deferredSteps
+       << " step cost " << stats.averageStepSeconds * 1e6 << " us"
+       << " dropped " << stats.droppedSeconds * 1000.0 << " ms"
+       << endl;
+}
+
+// simulation side: snapshot the camera and the draw list for the render thread
+void buildFramePacket(nsi::FramePacket &packet, bool logStats)
+{
+  packet.frame = frameIndex++;
+  packet.view = getActiveViewMatrix();
+  packet.projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_WIDTH / SCREEN_HEIGHT, NEAR_PLANE, FAR_PLANE);
+  packet.cameraPosition = getActiveCameraPosition();
+  packet.cameraFront = getActiveCameraFront();
+  packet.terrainMode = terrainMode;
+  packet.logStats = logStats;
+
+  Shader *worldShader = terrainMode == nsi::TerrainMode::CLIPMAP ? clipmapProgram : terrainProgram;
+  packet.draws.push_back({worldModel, worldShader, worldModel->getModelMatrix()});
+
+  if (scatterModel)
+    packet.draws.push_back({scatterModel, nullptr, scatterModel->getModelMatrix(), &instancedShaders});
+}
+
+// render thread side: everything here may touch GL
+// once every program is ready: how long they took and what the binary cache spared
+void logProgramStats()
 {
+  const nsi::ShaderManagerStats &shaders = nsi::ShaderManager::get().getStats();
+  const nsi::ProgramCacheStats &programs = nsi::ProgramCache::get().getStats();
+  cout << "Programs: " << shaders.submitted << " ready " << shaders.readySeconds * 1000.0 << " ms after submission ("
+       << (nsi::ShaderManager::get().hasParallelCompile() ? "parallel" : "deferred") << " compile), " << shaders.failed << " failed, "
+       << shaders.waited << " waited for at first use (" << shaders.waitSeconds * 1000.0 << " ms)" << endl;
+  cout << "Program cache: " << programs.hits << " from the binary cache, " << programs.misses << " compiled (" << programs.rejected
+       << " binaries rejected); compiling " << programs.compileSeconds * 1000.0 << " ms, loading " << programs.loadSeconds * 1000.0
+       << " ms, saved " << programs.savedSeconds * 1000.0 << " ms" << endl;
+}
+
+void renderFrame(const nsi::FramePacket &packet)
+{
+  // assets whose upload fence has passed become drawable this frame
+  uploadThread.collect();
+
   glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  glm::mat4 model = worldModel->getModelMatrix();
-  glm::mat4 view = orbitCam.getViewMatrix();
-  // glm::mat4 view = fpsCam.getViewMatrix();
-  glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_WIDTH / SCREEN_HEIGHT, 0.1f, 100.0f);
+  glm::mat4 model = glm::mat4(1.0f);
+  const glm::mat4 &view = packet.view;
+  const glm::mat4 &projection = packet.projection;
 
-  // Draw Grid
-  gridShaderProgram.use();
-  GLuint modelLoc = glGetUniformLocation(gridShaderProgram.ID, "model");
-  GLuint viewLoc = glGetUniformLocation(gridShaderProgram.ID, "view");
-  GLuint projLoc = glGetUniformLocation(gridShaderProgram.ID, "projection");
+  // programs the driver finished meanwhile, the rest are waited for at their first draw;
+  // reloaded ones are swapped in here, before anything of this frame is drawn
+  nsi::ShaderManager &shaders = nsi::ShaderManager::get();
+  if (shaders.poll())
+    logProgramStats();
 
-  glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-  glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-  glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-  glUniform1f(glGetUniformLocation(gridShaderProgram.ID, "spacing"), 10.0f);
+  // Draw Grid, unless its program failed to build
+  if (shaders.ready(*gridShaderProgram))
+  {
+    gridShaderProgram->use();
+    GLuint modelLoc = glGetUniformLocation(gridShaderProgram->ID, "model");
+    GLuint viewLoc = glGetUniformLocation(gridShaderProgram->ID, "view");
+    GLuint projLoc = glGetUniformLocation(gridShaderProgram->ID, "projection");
+
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniform1f(glGetUniformLocation(gridShaderProgram->ID, "spacing"), 10.0f);
+
+    glBindVertexArray(gridVAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+  }
 
-  glBindVertexArray(gridVAO);
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
+  // mode switches build GL resources, so they are applied here
+  worldModel->setMode(packet.terrainMode);
 
-  worldProgram.use();
-  modelLoc = glGetUniformLocation(worldProgram.ID, "model");
-  viewLoc = glGetUniformLocation(worldProgram.ID, "view");
-  projLoc = glGetUniformLocation(worldProgram.ID, "projection");
+  // every model writes its draw records first, then they go up in one upload
+  drawData.beginFrame();
+  nsi::TextureStreamer &streamer = nsi::TextureStreamer::get();
+  streamer.beginFrame(packet.frame, projection, SCREEN_HEIGHT);
+  for (const nsi::DrawItem &item : packet.draws)
+  {
+    item.model->prepare(item.transform, packet.cameraPosition, packet.cameraFront, projection * view);
+  }
+  drawData.commit();
+  // texture levels follow what prepare asked for, before anything samples them
+  streamer.update();
+
+  auto drawStart = std::chrono::steady_clock::now();
+  for (const nsi::DrawItem &item : packet.draws)
+  {
+    if (item.variants)
+    {
+      // every variant the model binds gets these
+      item.variants->setTransforms(item.transform, view, projection);
+      item.model->draw(*item.variants);
+      continue;
+    }
+
+    // a program that failed to build draws nothing
+    if (!shaders.ready(*item.shader))
+      continue;
+    // the model matrix travels in the draw records prepare wrote
+    item.shader->use();
+    item.shader->setMat4("view", view);
+    item.shader->setMat4("projection", projection);
+
+    item.model->draw(*item.shader);
+  }
+  drawData.endFrame();
+  drawSubmitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - drawStart).count();
+  drawSubmitFrames++;
+
+  if (packet.logStats)
+  {
+    logTerrainStats();
+
+    if (scatterModel)
+    {
+      const nsi::InstanceStats &instances = scatterModel->getStats();
+      cout << "instances: " << instances.visible << " / " << instances.instances << " visible"
+           << (instances.overflow ? " (buffer full)" : "") << endl;
+    }
+
+    nsi::UploadStats uploads = uploadThread.getStats();
+    cout << "uploads: queued " << uploads.queued
+         << " in flight " << uploads.inFlight
+         << " done " << uploads.completed
+         << " (" << uploads.uploadSeconds * 1000.0 << " ms on the upload thread)"
+         << endl;
+
+    if (streamer.isEnabled())
+    {
+      const nsi::TextureStreamerStats &textures = streamer.getStats();
+      cout << "textures: " << textures.textures << " streamed, " << textures.residentBytes / (1 << 20) << " / "
+           << textures.fullBytes / (1 << 20) << " MB resident, " << textures.waiting << " waiting, +"
+           << textures.raisedLevels << " -" << textures.droppedLevels << " levels ("
+           << textures.uploadedBytes / 1024 << " KB uploaded)" << endl;
+    }
 
-  worldModel->draw(worldProgram);
+    // CPU side only; compare runs with and without --no-bindless
+    cout << "draw submission: " << drawSubmitSeconds * 1000.0 / std::max(drawSubmitFrames, 1) << " ms/frame, model textures "
+         << (nsi::BindlessTextures::get().isEnabled() ? "bindless" : "bound per mesh") << endl;
+    drawSubmitSeconds = 0.0;
+    drawSubmitFrames = 0;
+
+    nsi::AssetRegistry::get().printReport(false);
+  }
 }
 
 int main(int argc, char *argv[])
 {
+  for (int i = 1; i < argc; i++)
+  {
+    // pins the thread count (caller included) for reproducible runs
+    if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+    {
+      setenv("NSI_WORKERS", argv[++i], 1);
+      continue;
+    }
+
+    if (strcmp(argv[i], "--scatter") == 0 && i + 2 < argc)
+    {
+      scatterPath = argv[++i];
+      scatterCount = atoi(argv[++i]);
+      continue;
+    }
+
+    if (strcmp(argv[i], "--no-bindless") == 0)
+    {
+      requestBindless = false;
+      continue;
+    }
+
+    if (strcmp(argv[i], "--hot-reload") == 0)
+    {
+      hotReload = true;
+      continue;
+    }
+
+    if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+    {
+      textureBudgetMB = std::max(0, atoi(argv[++i]));
+      continue;
+    }
+
+    if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+    {
+      packPath = argv[++i];
+      continue;
+    }
+
+    // offline: packs the models and shaders for --pack and exits
+    if (strcmp(argv[i], "--build-pack") == 0 && i + 1 < argc)
+    {
+      buildPackPath = argv[++i];
+      continue;
+    }
+
+    // raw, lz4, zstd or auto (per file) for --build-pack
+    if (strcmp(argv[i], "--pack-compression") == 0 && i + 1 < argc)
+    {
+      if (!nsi::packCodec::parse(argv[++i], packCompression))
+        cerr << "Unknown pack compression " << argv[i] << ", using " << nsi::packCodec::name(packCompression) << endl;
+      continue;
+    }
+
+    if (strncmp(argv[i], "--bench-", 8) == 0)
+    {
+      benchmark = argv[i] + 8;
+      continue;
+    }
+  }
+
+  // options like --workers apply wherever they were given
+  if (benchmark)
+  {
+    if (strcmp(benchmark, "io") == 0)
+      nsi::runIOBenchmark();
+    else if (strcmp(benchmark, "pack") == 0)
+      nsi::runPackBenchmark();
+    else if (strcmp(benchmark, "instances") == 0)
+      nsi::runInstanceBenchmark();
+    else if (strcmp(benchmark, "jobs") == 0)
+      nsi::runJobBenchmark();
+    else if (strcmp(benchmark, "noise") == 0)
+      nsi::runNoiseBenchmark();
+    else if (strcmp(benchmark, "physics") == 0)
+      nsi::runPhysicsBenchmark();
+    else
+    {
+      cerr << "Unknown benchmark --bench-" << benchmark << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (buildPackPath)
+    return nsi::AssetPack::build(buildPackPath, {"src/shaders", "ext/models"}, packCompression) ? 0 : 1;
+
+  // mapped before anything loads; loaders fall back to loose files without it
+  nsi::AssetPack &pack = nsi::AssetPack::get();
+  if (pack.open(packPath))
+    cout << "Asset pack " << packPath << ": " << pack.getFileCount() << " files, " << pack.getMappedBytes() / (1024 * 1024) << " MB mapped" << endl;
+
   float deltaTime = 0.0f;
-  float lastFrame = 0.0f;
 
   SDL_SetHint(SDL_HINT_TRACKPAD_IS_TOUCH_ONLY, "1");
 
@@ -289,32 +595,49 @@ int main(int argc, char *argv[])
     return -1;
   }
 
+  submitShaders();
+
   if (!initGrid())
   {
     cerr << "Failed to initialize OpenGl" << endl;
     return -1;
   }
 
+  jobSystem = new nsi::JobSystem();
+
   if (!drawWorldModel())
   {
     cerr << "Failed to initialize WorldModel" << endl;
     return -1;
   }
 
+  // whatever finished compiling while the terrain loaded
+  if (nsi::ShaderManager::get().poll())
+    logProgramStats();
+  scatterInstances();
+
   glEnable(GL_BLEND);
   glEnable(GL_DEPTH_TEST);
 
+  // from here on GL belongs to the render thread
+  SDL_GL_MakeCurrent(window, nullptr);
+  renderThread.start(window, context, renderFrame);
+
   SDL_Event evt;
   bool running = true;
 
   int lastX = SCREEN_WIDTH / 2, lastY = SCREEN_HEIGHT / 2;
   bool firstMouse = true;
 
+  double lastStatsLog = 0.0;
+
+  // don't count loading time as the first frame
+  scheduler.beginFrame();
+
   while (running)
   {
-    float currentFrame = SDL_GetTicks() / 1000.0f;
-    deltaTime = currentFrame - lastFrame;
-    lastFrame = currentFrame;
+    deltaTime = float(scheduler.beginFrame());
+    double currentFrame = scheduler.getTime();
 
     while (SDL_PollEvent(&evt))
     {
@@ -330,18 +653,35 @@ int main(int argc, char *argv[])
           running = false;
         }
       }
-      handleOrbitMouseMovement(evt);
-      handleOrbitZoom(evt);
-      // handleFPSMouseMovement(evt);
+      if (useFPSCamera)
+      {
+        handleFPSMouseMovement(evt);
+      }
+      else
+      {
+        handleOrbitMouseMovement(evt);
+        handleOrbitZoom(evt);
+      }
     }
 
-    fpsCam.updatePhysics(deltaTime);
+    scheduler.run([](float stepSeconds, int stepsLeft)
+                  { fpsCam.fixedUpdate(stepSeconds, stepsLeft); });
 
-    render();
+    bool logStats = currentFrame - lastStatsLog >= 2.0;
+    if (logStats)
+    {
+      logSchedulerStats();
+      lastStatsLog = currentFrame;
+    }
 
-    SDL_GL_SwapWindow(window);
+    // overlaps with the render thread drawing the previous packet
+    buildFramePacket(renderThread.beginFrame(), logStats);
+    renderThread.submit();
   }
 
+  renderThread.stop();
+  SDL_GL_MakeCurrent(window, context);
+
   close();
 
   return 0;
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <random>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -12,13 +13,35 @@
 
 #include "src/camera/orbit.h"
 #include "src/camera/fps.h"
+#include "src/assets/assetPack.h"
+#include "src/assets/assetRegistry.h"
+#include "src/assets/textureStreamer.h"
+#include "src/core/simulationScheduler.h"
 #include "src/models/world/world.h"
+#include "src/models/instanced/instancedModel.h"
+#include "src/render/bindlessMaterials.h"
+#include "src/render/renderThread.h"
+#include "src/render/shaderManager.h"
+#include "src/render/uploadThread.h"
+#include "src/render/drawData.h"
+#include "src/terrain/noiseHeightSource.h"
+#include "src/bench/noiseBenchmark.h"
+#include "src/bench/packBenchmark.h"
+#include "src/bench/physicsBenchmark.h"
+#include "src/bench/jobBenchmark.h"
+#include "src/bench/instanceBenchmark.h"
+#include "src/bench/ioBenchmark.h"
+#include "src/jobs/jobSystem.h"
+#include "src/physics/terrainCollider.h"
 
 using namespace std;
 
 const int SCREEN_WIDTH = 1200;
 const int SCREEN_HEIGHT = 768;
 
+const float NEAR_PLANE = 0.5f;
+const float FAR_PLANE = 20000.0f;
+
 float pVertices[] = {
     -1000.0f, 0.0f, -1000.0f,
     1000.0f, 0.0f, -1000.0f,
@@ -34,7 +57,8 @@ static SDL_Renderer *renderer = NULL;
 static SDL_GLContext context;
 
 // Open GL vars
-Shader gridShaderProgram;
+// the shader manager's, so hot reloads reach them
+Shader *gridShaderProgram = nullptr;
 GLuint gridVAO, gridVBO, gridEBO;
 GLuint dotVAO, dotVBO;
 
@@ -47,8 +71,52 @@ OrbitCamera orbitCam(
 
 FPSCamera fpsCam(glm::vec3(0.0f, 1.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f), -90.0f, 0.0f);
 
+// TAB switches between the orbit and fps camera
+bool useFPSCamera = false;
+
+// fixed-rate simulation, rendering interpolates by its alpha
+nsi::SimulationScheduler scheduler;
+
 // Models
-Shader worldProgram;
+Shader *terrainProgram = nullptr;
+Shader *clipmapProgram = nullptr;
 nsi::World *worldModel = nullptr;
 
+// --scatter <model> <count> drops instanced copies of a model over the terrain
+nsi::ShaderVariants instancedShaders;
+nsi::InstancedModel *scatterModel = nullptr;
+const char *scatterPath = nullptr;
+int scatterCount = 0;
+// --texture-budget <MB> caps video memory of streamed textures, 0 uploads every level at load.
+// Unset it is the default unless bindless textures are on, which cannot stream
+const int defaultTextureBudgetMB = 512;
+int textureBudgetMB = -1;
+// --pack <file> serves models, textures and shaders from a mapped archive (--build-pack writes one)
+const char *packPath = "assets.pack";
+const char *buildPackPath = nullptr;
+nsi::PackCompression packCompression = nsi::PackCompression::Auto;
+// --no-bindless keeps binding model textures to units where bindless handles would work
+bool requestBindless = true;
+// --hot-reload rebuilds programs whose shader files change while running
+bool hotReload = false;
+// --bench-<name> runs that benchmark instead of the app, after every option is parsed
+const char *benchmark = nullptr;
+// render thread time spent issuing the frame's draws, since the last stats line
+double drawSubmitSeconds = 0.0;
+int drawSubmitFrames = 0;
+nsi::TerrainCollider *terrainCollider = nullptr;
+
+// shared worker pool for loading and generation, sized by NSI_WORKERS / --workers
+nsi::JobSystem *jobSystem = nullptr;
+
+// the render thread owns the GL context between startup and shutdown; terrainMode is
+// what the simulation asks for, the renderer applies it when the frame is drawn
+nsi::RenderThread renderThread;
+// background buffer/texture uploads on a shared context, published by the render thread
+nsi::UploadThread uploadThread;
+// per-draw records of every model, one upload per frame
+nsi::DrawDataBuffer drawData;
+nsi::TerrainMode terrainMode = nsi::TerrainMode::CDLOD;
+uint64_t frameIndex = 0;
+
 void close();
\ No newline at end of file
@@ -0,0 +1,495 @@
+#ifndef ASSETS_ASSET_PACK_H
+#define ASSETS_ASSET_PACK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../jobs/jobSystem.h"
+#include "packCompression.h"
+
+namespace nsi
+{
+  // on disk, little-endian: header, every file's bytes starting on a page boundary, then
+  // the table of contents, the block table and the names. Files keep the order they were
+  // packed in, so everything one model needs lies together
+  struct PackHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t tocOffset;
+    uint64_t blocksOffset;
+    uint64_t blockCount;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+  };
+
+  struct PackEntry
+  {
+    uint64_t offset;
+    // as the loaders see it
+    uint64_t size;
+    // in the pack
+    uint64_t storedSize;
+    // the source's modification time when packed, like the texture cache records it
+    int64_t sourceTime;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    // PackCompression; compressed files are split into blocks of packCodec::blockSize
+    uint32_t compression;
+    uint32_t blockCount;
+    uint64_t firstBlock;
+  };
+
+  // one independently decodable block of a compressed file
+  struct PackBlock
+  {
+    uint64_t offset;
+    // equal to size for a block that did not shrink and is stored as is
+    uint32_t storedSize;
+    uint32_t size;
+  };
+
+  // a packed file's metadata; data points into the mapping only for files stored raw
+  struct PackView
+  {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    int64_t sourceTime = 0;
+    PackCompression compression = PackCompression::None;
+  };
+
+  // a packed file's bytes: in the mapping when stored raw, otherwise in buffer
+  struct PackFile
+  {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    int64_t sourceTime = 0;
+    std::vector<unsigned char> buffer;
+  };
+
+  // read-only archive of assets, memory-mapped whole. Loaders look files up by the path
+  // they would have opened and read straight from the mapping, or decode its blocks in
+  // parallel; files not in the pack, or changed on disk since it was built, are read
+  // loose as before. Open it before anything loads, lookups are then safe from any thread
+  class AssetPack
+  {
+  public:
+    static constexpr char MAGIC[8] = {'N', 'S', 'I', 'P', 'A', 'C', 'K', 0};
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint64_t ALIGNMENT = 4096;
+
+    static AssetPack &get()
+    {
+      static AssetPack pack;
+      return pack;
+    }
+
+    ~AssetPack()
+    {
+      close();
+    }
+
+    // false, and nothing mounted, when the file is missing or not a pack
+    bool open(const std::string &path)
+    {
+      close();
+#ifdef _WIN32
+      std::cerr << "ERROR::ASSET_PACK::MAPPING_UNSUPPORTED " << path << std::endl;
+      return false;
+#else
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+        return false;
+
+      struct stat info;
+      if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(PackHeader))
+      {
+        ::close(fd);
+        std::cerr << "ERROR::ASSET_PACK::INVALID " << path << std::endl;
+        return false;
+      }
+
+      size_t size = size_t(info.st_size);
+      void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      // the mapping keeps its own reference to the file
+      ::close(fd);
+      if (mapping == MAP_FAILED)
+      {
+        std::cerr << "ERROR::ASSET_PACK::MMAP_FAILED " << path << std::endl;
+        return false;
+      }
+
+      data = static_cast<const unsigned char *>(mapping);
+      dataSize = size;
+      if (!readIndex())
+      {
+        std::cerr << "ERROR::ASSET_PACK::INVALID " << path << std::endl;
+        close();
+        return false;
+      }
+
+      // one readahead over the whole file instead of a fault per page as loaders go
+      madvise(mapping, size, MADV_WILLNEED);
+
+      std::error_code error;
+      root = std::filesystem::current_path(error);
+      dropStale(path);
+      return true;
+#endif
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+      if (data)
+        munmap(const_cast<unsigned char *>(data), dataSize);
+#endif
+      data = nullptr;
+      dataSize = 0;
+      blocks = nullptr;
+      index.clear();
+    }
+
+    bool isOpen() const { return data != nullptr; }
+    size_t getFileCount() const { return index.size(); }
+    size_t getMappedBytes() const { return dataSize; }
+
+    // packed names, in no particular order
+    std::vector<std::string> getFileNames() const
+    {
+      std::vector<std::string> names;
+      names.reserve(index.size());
+      for (const auto &[name, entry] : index)
+      {
+        names.emplace_back(name);
+      }
+      return names;
+    }
+
+    // the packed file for a path as a loader would open it, relative to the working
+    // directory the pack was opened in or absolute below it
+    bool find(const std::string &path, PackView &view) const
+    {
+      const PackEntry *entry = lookup(path);
+      if (!entry)
+        return false;
+
+      view.compression = PackCompression(entry->compression);
+      view.data = view.compression == PackCompression::None ? data + entry->offset : nullptr;
+      view.size = size_t(entry->size);
+      view.sourceTime = entry->sourceTime;
+      return true;
+    }
+
+    bool contains(const std::string &path) const
+    {
+      return lookup(path) != nullptr;
+    }
+
+    // the file's bytes, decoded into file.buffer when compressed (blocks spread over jobs
+    // when given). False when it is not packed or cannot be decoded, callers then read
+    // the loose file
+    bool read(const std::string &path, PackFile &file, JobSystem *jobs = nullptr) const
+    {
+      const PackEntry *entry = lookup(path);
+      if (!entry)
+        return false;
+
+      file.size = size_t(entry->size);
+      file.sourceTime = entry->sourceTime;
+      if (PackCompression(entry->compression) == PackCompression::None)
+      {
+        file.data = data + entry->offset;
+        file.buffer.clear();
+        return true;
+      }
+
+      file.buffer.resize(file.size);
+      file.data = file.buffer.data();
+      return decode(*entry, file.buffer.data(), jobs);
+    }
+
+    // offline: every file below the roots (relative to the working directory, in the
+    // given order) written to output, compressed as requested. Files go in one
+    // sequential pass; the tables follow
+    static bool build(const std::string &output, const std::vector<std::string> &roots, PackCompression compression = PackCompression::None)
+    {
+      if (compression != PackCompression::Auto && !packCodec::available(compression))
+      {
+        std::cerr << "ERROR::ASSET_PACK::CODEC_UNAVAILABLE " << packCodec::name(compression) << ", storing raw" << std::endl;
+        compression = PackCompression::None;
+      }
+
+      std::error_code baseError;
+      std::filesystem::path base = std::filesystem::current_path(baseError);
+      std::vector<std::filesystem::path> files;
+      for (const std::string &root : roots)
+      {
+        std::error_code error;
+        std::vector<std::filesystem::path> found;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        {
+          if (it->is_regular_file())
+            found.push_back(it->path());
+        }
+        if (error)
+          std::cerr << "ERROR::ASSET_PACK::CANNOT_READ " << root << std::endl;
+        // files of one directory stay together
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+      }
+
+      std::string temporary = output + ".tmp";
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      if (!out)
+      {
+        std::cerr << "ERROR::ASSET_PACK::CANNOT_WRITE " << temporary << std::endl;
+        return false;
+      }
+
+      PackHeader header{};
+      std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+      std::vector<PackEntry> entries;
+      std::vector<PackBlock> blockTable;
+      std::string names;
+      std::vector<unsigned char> buffer;
+      std::vector<unsigned char> compressed;
+      std::vector<unsigned char> stored;
+      uint64_t offset = sizeof(header);
+      uint64_t sourceBytes = 0;
+      for (const std::filesystem::path &file : files)
+      {
+        std::ifstream in(file, std::ios::binary);
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(file, error);
+        int64_t time = int64_t(std::filesystem::last_write_time(file, error).time_since_epoch().count());
+        buffer.resize(size_t(size));
+        if (error || !in || !in.read(reinterpret_cast<char *>(buffer.data()), std::streamsize(size)))
+        {
+          std::cerr << "ERROR::ASSET_PACK::CANNOT_READ " << file.string() << std::endl;
+          continue;
+        }
+
+        // named the way lookups name them, relative to the working directory
+        std::string name = packName(file.string(), base);
+        PackEntry entry{0, size, size, time, uint32_t(names.size()), uint32_t(name.size()), 0, 0, blockTable.size()};
+        PackCompression chosen = choosePackCompression(compression, name, size);
+
+        // blocks that do not shrink are stored as they are; a file where none shrank stays
+        // raw and readable in place
+        std::vector<PackBlock> fileBlocks;
+        bool shrunk = false;
+        stored.clear();
+        for (size_t begin = 0; chosen != PackCompression::None && begin < buffer.size(); begin += packCodec::blockSize)
+        {
+          size_t blockBytes = std::min(packCodec::blockSize, buffer.size() - begin);
+          bool packed = packCodec::compress(chosen, buffer.data() + begin, blockBytes, compressed);
+          const unsigned char *block = packed ? compressed.data() : buffer.data() + begin;
+          size_t storedBytes = packed ? compressed.size() : blockBytes;
+          fileBlocks.push_back({stored.size(), uint32_t(storedBytes), uint32_t(blockBytes)});
+          stored.insert(stored.end(), block, block + storedBytes);
+          shrunk |= packed;
+        }
+        const std::vector<unsigned char> &bytes = shrunk ? stored : buffer;
+
+        // page-aligned, so every file is its own run of pages in the mapping
+        uint64_t aligned = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        static const char padding[ALIGNMENT] = {};
+        out.write(padding, std::streamsize(aligned - offset));
+        out.write(reinterpret_cast<const char *>(bytes.data()), std::streamsize(bytes.size()));
+
+        entry.offset = aligned;
+        if (shrunk)
+        {
+          entry.storedSize = stored.size();
+          entry.compression = uint32_t(chosen);
+          entry.blockCount = uint32_t(fileBlocks.size());
+          for (PackBlock &block : fileBlocks)
+          {
+            block.offset += aligned;
+            blockTable.push_back(block);
+          }
+        }
+
+        entries.push_back(entry);
+        names += name;
+        offset = aligned + bytes.size();
+        sourceBytes += size;
+      }
+
+      // the tables are read in place, so they start aligned for their entries
+      uint64_t tocOffset = (offset + alignof(PackEntry) - 1) / alignof(PackEntry) * alignof(PackEntry);
+      static const char padding[alignof(PackEntry)] = {};
+      out.write(padding, std::streamsize(tocOffset - offset));
+
+      header.entryCount = uint32_t(entries.size());
+      header.tocOffset = tocOffset;
+      header.blocksOffset = tocOffset + entries.size() * sizeof(PackEntry);
+      header.blockCount = blockTable.size();
+      header.namesOffset = header.blocksOffset + blockTable.size() * sizeof(PackBlock);
+      header.namesSize = names.size();
+      out.write(reinterpret_cast<const char *>(entries.data()), std::streamsize(entries.size() * sizeof(PackEntry)));
+      out.write(reinterpret_cast<const char *>(blockTable.data()), std::streamsize(blockTable.size() * sizeof(PackBlock)));
+      out.write(names.data(), std::streamsize(names.size()));
+      out.seekp(0);
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      out.close();
+      if (!out)
+      {
+        std::cerr << "ERROR::ASSET_PACK::CANNOT_WRITE " << temporary << std::endl;
+        return false;
+      }
+
+      std::error_code error;
+      std::filesystem::rename(temporary, output, error);
+      if (error)
+      {
+        std::cerr << "ERROR::ASSET_PACK::CANNOT_WRITE " << output << std::endl;
+        return false;
+      }
+
+      uint64_t packBytes = header.namesOffset + header.namesSize;
+      std::cout << "Asset pack " << output << " (" << packCodec::name(compression) << "): " << entries.size() << " files, "
+                << sourceBytes / 1024 << " KB in " << packBytes / 1024 << " KB" << std::endl;
+      return true;
+    }
+
+  private:
+    const unsigned char *data = nullptr;
+    size_t dataSize = 0;
+    const PackBlock *blocks = nullptr;
+    std::filesystem::path root;
+    // names point into the mapping
+    std::unordered_map<std::string_view, const PackEntry *> index;
+
+    AssetPack() = default;
+
+    bool readIndex()
+    {
+      PackHeader header;
+      std::memcpy(&header, data, sizeof(header));
+      if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+          header.tocOffset + uint64_t(header.entryCount) * sizeof(PackEntry) > dataSize ||
+          header.blocksOffset + header.blockCount * sizeof(PackBlock) > dataSize || header.namesOffset + header.namesSize > dataSize ||
+          header.tocOffset % alignof(PackEntry) != 0 || header.blocksOffset % alignof(PackBlock) != 0)
+        return false;
+
+      const PackEntry *entries = reinterpret_cast<const PackEntry *>(data + header.tocOffset);
+      const char *names = reinterpret_cast<const char *>(data + header.namesOffset);
+      blocks = reinterpret_cast<const PackBlock *>(data + header.blocksOffset);
+      index.reserve(header.entryCount);
+      for (uint32_t i = 0; i < header.entryCount; i++)
+      {
+        const PackEntry &entry = entries[i];
+        if (entry.offset + entry.storedSize > dataSize || uint64_t(entry.nameOffset) + entry.nameLength > header.namesSize ||
+            entry.firstBlock + entry.blockCount > header.blockCount)
+          return false;
+        index.emplace(std::string_view(names + entry.nameOffset, entry.nameLength), &entry);
+      }
+      return true;
+    }
+
+    // a loose file that no longer matches what was packed has been edited since; it is
+    // read loose instead. Files only in the pack stay served from it
+    void dropStale(const std::string &path)
+    {
+      size_t stale = 0;
+      for (auto it = index.begin(); it != index.end();)
+      {
+        std::error_code error;
+        std::filesystem::path loose = root / std::filesystem::path(std::string(it->first));
+        uint64_t size = std::filesystem::file_size(loose, error);
+        int64_t time = error ? 0 : int64_t(std::filesystem::last_write_time(loose, error).time_since_epoch().count());
+        if (!error && (size != it->second->size || time != it->second->sourceTime))
+        {
+          it = index.erase(it);
+          stale++;
+        }
+        else
+          ++it;
+      }
+
+      if (stale)
+        std::cerr << "ERROR::ASSET_PACK::STALE " << path << ": " << stale << " files changed since packing, reading them loose" << std::endl;
+    }
+
+    const PackEntry *lookup(const std::string &path) const
+    {
+      if (!data)
+        return nullptr;
+
+      auto found = index.find(packName(path, root));
+      return found == index.end() ? nullptr : found->second;
+    }
+
+    // every block of a compressed entry into out, which holds entry.size bytes; blocks
+    // are independent, so each is a job of its own
+    bool decode(const PackEntry &entry, unsigned char *out, JobSystem *jobs) const
+    {
+      PackCompression compression = PackCompression(entry.compression);
+      if (!packCodec::available(compression))
+      {
+        std::cerr << "ERROR::ASSET_PACK::CODEC_UNAVAILABLE " << packCodec::name(compression) << std::endl;
+        return false;
+      }
+
+      const PackBlock *first = blocks + entry.firstBlock;
+      std::atomic<bool> failed{false};
+      auto decodeBlocks = [&](size_t begin, size_t end)
+      {
+        for (size_t i = begin; i < end; i++)
+        {
+          const PackBlock &block = first[i];
+          unsigned char *target = out + i * packCodec::blockSize;
+          bool valid = block.offset + block.storedSize <= dataSize && i * packCodec::blockSize + block.size <= entry.size;
+          if (valid && block.storedSize == block.size)
+            std::memcpy(target, data + block.offset, block.size);
+          else if (!valid || !packCodec::decompress(compression, data + block.offset, block.storedSize, target, block.size))
+            failed = true;
+        }
+      };
+
+      if (jobs)
+        jobs->parallelFor(entry.blockCount, 1, decodeBlocks);
+      else
+        decodeBlocks(0, entry.blockCount);
+
+      if (failed)
+        std::cerr << "ERROR::ASSET_PACK::CORRUPT_BLOCK at " << entry.offset << std::endl;
+      return !failed;
+    }
+
+    // the name a file is packed under: relative to base, '/'-separated, without . and ..
+    static std::string packName(std::string path, const std::filesystem::path &base)
+    {
+      std::replace(path.begin(), path.end(), '\\', '/');
+      std::filesystem::path name(path);
+      if (name.is_absolute())
+        name = name.lexically_relative(base);
+      return name.lexically_normal().generic_string();
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,267 @@
+#ifndef ASSETS_ASSET_REGISTRY_H
+#define ASSETS_ASSET_REGISTRY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nsi
+{
+  // identifies an asset: what it is, the normalised file it came from and the options it
+  // was loaded with (import flags, texture slot, resolution, ...)
+  struct AssetKey
+  {
+    std::string kind;
+    std::string path;
+    unsigned int options = 0;
+
+    bool operator==(const AssetKey &other) const
+    {
+      return options == other.options && path == other.path && kind == other.kind;
+    }
+  };
+
+  struct AssetKeyHash
+  {
+    size_t operator()(const AssetKey &key) const
+    {
+      size_t hash = std::hash<std::string>()(key.path);
+      hash ^= std::hash<std::string>()(key.kind) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+      hash ^= std::hash<unsigned int>()(key.options) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+      return hash;
+    }
+  };
+
+  struct AssetCounts
+  {
+    // acquires served from a live or loading entry, and loads
+    size_t hits = 0;
+    size_t misses = 0;
+  };
+
+  struct AssetReportEntry
+  {
+    AssetKey key;
+    // live handles
+    long references = 0;
+    size_t bytes = 0;
+  };
+
+  struct AssetReport
+  {
+    std::vector<AssetReportEntry> entries;
+    AssetCounts total;
+    std::map<std::string, AssetCounts> kinds;
+    // memory actually held, and what it would take if every handle had its own copy
+    size_t residentBytes = 0;
+    size_t unsharedBytes = 0;
+  };
+
+  // process-wide cache of loaded assets. Handles are shared_ptrs; the registry only keeps
+  // weak references, so an asset is freed with its last handle and reloaded on the next
+  // acquire. Asset types provide size_t getMemoryBytes() const for the report
+  class AssetRegistry
+  {
+  public:
+    static AssetRegistry &get()
+    {
+      static AssetRegistry registry;
+      return registry;
+    }
+
+    // the key for a file however it was spelled: absolute, '/'-separated, without . and ..
+    // components; purely lexical, so no file system access
+    static AssetKey makeKey(const std::string &kind, const std::string &path, unsigned int options)
+    {
+      return AssetKey{kind, normalizePath(path), options};
+    }
+
+    static std::string normalizePath(std::string path)
+    {
+      // material paths written on Windows
+      std::replace(path.begin(), path.end(), '\\', '/');
+
+      std::error_code error;
+      std::filesystem::path absolute = std::filesystem::absolute(path, error);
+      if (error)
+        absolute = path;
+      return absolute.lexically_normal().generic_string();
+    }
+
+    template <typename T>
+    std::shared_ptr<T> acquire(const std::string &kind, const std::string &path, unsigned int options, const std::function<std::shared_ptr<T>()> &load)
+    {
+      return acquire<T>(makeKey(kind, path, options), load);
+    }
+
+    // the live asset for the key, or load() run once even when several threads ask at the
+    // same time; a null result is not cached, nor is an exception from load(), which
+    // reaches every thread waiting on that load
+    template <typename T>
+    std::shared_ptr<T> acquire(const AssetKey &key, const std::function<std::shared_ptr<T>()> &load)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      AssetCounts &counts = kindCounts[key.kind];
+
+      auto found = entries.find(key);
+      if (found != entries.end())
+      {
+        if (std::shared_ptr<void> live = found->second.asset.lock())
+        {
+          counts.hits++;
+          return std::static_pointer_cast<T>(live);
+        }
+
+        if (found->second.loading.valid())
+        {
+          std::shared_future<std::shared_ptr<void>> loading = found->second.loading;
+          counts.hits++;
+          lock.unlock();
+          return std::static_pointer_cast<T>(loading.get());
+        }
+      }
+
+      counts.misses++;
+      std::promise<std::shared_ptr<void>> promise;
+      entries[key].loading = promise.get_future().share();
+      lock.unlock();
+
+      std::shared_ptr<T> asset;
+      try
+      {
+        asset = load();
+      }
+      catch (...)
+      {
+        // the key is free for the next acquire to try again; current waiters get the error
+        lock.lock();
+        entries[key].loading = {};
+        lock.unlock();
+        promise.set_exception(std::current_exception());
+        throw;
+      }
+
+      lock.lock();
+      // references into an unordered_map survive the rehashes other inserts may cause
+      Entry &entry = entries[key];
+      entry.loading = {};
+      entry.asset = asset;
+      std::weak_ptr<T> weak = asset;
+      entry.bytes = [weak]()
+      {
+        std::shared_ptr<T> live = weak.lock();
+        return live ? live->getMemoryBytes() : size_t(0);
+      };
+      lock.unlock();
+
+      promise.set_value(asset);
+      return asset;
+    }
+
+    // the live asset for the key without loading it; counted as a hit when found
+    template <typename T>
+    std::shared_ptr<T> find(const AssetKey &key)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto found = entries.find(key);
+      if (found == entries.end())
+        return nullptr;
+
+      std::shared_ptr<void> live = found->second.asset.lock();
+      if (live)
+        kindCounts[key.kind].hits++;
+      return std::static_pointer_cast<T>(live);
+    }
+
+    AssetReport report()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      AssetReport report;
+      for (const auto &[kind, counts] : kindCounts)
+      {
+        report.kinds[kind] = counts;
+        report.total.hits += counts.hits;
+        report.total.misses += counts.misses;
+      }
+
+      for (auto it = entries.begin(); it != entries.end();)
+      {
+        std::shared_ptr<void> live = it->second.asset.lock();
+        if (!live && !it->second.loading.valid())
+        {
+          // released since the last report
+          it = entries.erase(it);
+          continue;
+        }
+
+        AssetReportEntry entry;
+        entry.key = it->first;
+        // minus the one we hold right now
+        entry.references = live ? live.use_count() - 1 : 0;
+        entry.bytes = it->second.bytes ? it->second.bytes() : 0;
+
+        report.residentBytes += entry.bytes;
+        report.unsharedBytes += entry.bytes * size_t(std::max(entry.references, 1L));
+        report.entries.push_back(entry);
+        ++it;
+      }
+
+      std::sort(report.entries.begin(), report.entries.end(), [](const AssetReportEntry &a, const AssetReportEntry &b)
+                { return a.key.kind != b.key.kind ? a.key.kind < b.key.kind : a.key.path < b.key.path; });
+
+      return report;
+    }
+
+    // one summary line and the hits per kind, then a line per live asset when detailed
+    void printReport(bool detailed = true)
+    {
+      AssetReport current = report();
+
+      std::cout << "assets: " << current.entries.size() << " live, " << current.total.hits << " hits / " << current.total.misses << " loads, "
+                << current.residentBytes / 1024 << " KB resident, "
+                << (current.unsharedBytes - current.residentBytes) / 1024 << " KB saved by sharing" << std::endl;
+
+      for (const auto &[kind, counts] : current.kinds)
+      {
+        std::cout << "  " << kind << ": " << counts.hits << " hits / " << counts.misses << " loads" << std::endl;
+      }
+
+      if (!detailed)
+        return;
+
+      for (const AssetReportEntry &entry : current.entries)
+      {
+        std::cout << "  " << entry.key.kind << " " << entry.key.path << " [" << entry.key.options << "] x" << entry.references << " "
+                  << entry.bytes / 1024 << " KB" << std::endl;
+      }
+    }
+
+  private:
+    struct Entry
+    {
+      std::weak_ptr<void> asset;
+      // set while the first acquire is still loading
+      std::shared_future<std::shared_ptr<void>> loading;
+      std::function<size_t()> bytes;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<AssetKey, Entry, AssetKeyHash> entries;
+    std::unordered_map<std::string, AssetCounts> kindCounts;
+
+    AssetRegistry() = default;
+  };
+}
+
+#endif
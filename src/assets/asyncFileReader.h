@@ -0,0 +1,504 @@
+#ifndef ASSETS_ASYNC_FILE_READER_H
+#define ASSETS_ASYNC_FILE_READER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef NSI_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "../jobs/jobSystem.h"
+
+namespace nsi
+{
+  // a whole file read into memory
+  struct FileBuffer
+  {
+    std::string path;
+    std::vector<unsigned char> bytes;
+    bool ok = false;
+  };
+
+  enum class FileReadBackend
+  {
+    // io_uring where built in and allowed by the kernel, threads otherwise
+    Auto,
+    IoUring,
+    Threads
+  };
+
+  struct FileReadStats
+  {
+    const char *backend = "";
+    size_t files = 0;
+    size_t failed = 0;
+    size_t bytes = 0;
+    double seconds = 0.0;
+    // reads in flight, sampled as every read is issued
+    double averageQueueDepth = 0.0;
+    size_t maxQueueDepth = 0;
+
+    double megabytesPerSecond() const
+    {
+      return seconds > 0.0 ? double(bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+    }
+  };
+
+  // the blocking reads of every AsyncFileReader on the threads backend: threads are
+  // started as a batch first needs them, up to maxThreads, and stay for the rest of
+  // the launch instead of being spawned per batch
+  class FileReadThreads
+  {
+  public:
+    static constexpr size_t maxThreads = 64;
+
+    static FileReadThreads &get()
+    {
+      static FileReadThreads pool;
+      return pool;
+    }
+
+    FileReadThreads(const FileReadThreads &) = delete;
+    FileReadThreads &operator=(const FileReadThreads &) = delete;
+
+    ~FileReadThreads()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      wake.notify_all();
+      for (std::thread &thread : threads)
+      {
+        thread.join();
+      }
+    }
+
+    // runs task on a reader thread, with at least threadCount of them around (capped)
+    void run(std::function<void()> task, size_t threadCount)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+        while (threads.size() < std::min(threadCount, maxThreads))
+        {
+          threads.emplace_back([this]()
+                               { readerLoop(); });
+        }
+      }
+      wake.notify_one();
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    FileReadThreads() = default;
+
+    void readerLoop()
+    {
+      while (true)
+      {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          wake.wait(lock, [this]()
+                    { return stopping || !tasks.empty(); });
+          if (tasks.empty())
+            return;
+          task = std::move(tasks.front());
+          tasks.pop_front();
+        }
+        task();
+      }
+    }
+  };
+
+  // reads batches of whole files with up to queueDepth reads in flight, through io_uring
+  // on Linux when built with liburing (NSI_HAVE_LIBURING) and through pread on the shared
+  // FileReadThreads otherwise. Every file is handed to onRead on the calling thread as soon as it
+  // is complete, in completion order, so decode jobs submitted from there run while the
+  // rest is still on its way. A reader serves one batch at a time
+  class AsyncFileReader
+  {
+  public:
+    using Callback = std::function<void(size_t index, FileBuffer &&file)>;
+
+    // 0 queue depth means defaultQueueDepth()
+    explicit AsyncFileReader(unsigned queueDepth = 0, FileReadBackend backend = FileReadBackend::Auto)
+        : queueDepth(queueDepth > 0 ? queueDepth : defaultQueueDepth()), backend(backend) {}
+
+    // one read in flight per thread of the job system that decodes what arrives, so it
+    // follows NSI_WORKERS / --workers
+    static unsigned defaultQueueDepth()
+    {
+      return unsigned(JobSystem::defaultWorkerCount() + 1);
+    }
+
+    // whether this build has the io_uring backend; the kernel may still refuse it
+    static bool hasIoUring()
+    {
+#ifdef NSI_HAVE_LIBURING
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    // returns once every file has been delivered; files that cannot be read arrive with
+    // ok unset
+    FileReadStats readAll(const std::vector<std::string> &paths, const Callback &onRead)
+    {
+      stats = FileReadStats();
+      stats.files = paths.size();
+      depthSamples = 0;
+      depthSum = 0;
+      if (paths.empty())
+        return stats;
+
+      auto start = std::chrono::steady_clock::now();
+      bool done = false;
+#ifdef NSI_HAVE_LIBURING
+      if (backend != FileReadBackend::Threads)
+        done = readUring(paths, onRead);
+#endif
+      if (!done)
+        readThreads(paths, onRead);
+
+      stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      stats.averageQueueDepth = depthSamples > 0 ? double(depthSum) / double(depthSamples) : 0.0;
+      return stats;
+    }
+
+  private:
+    unsigned queueDepth;
+    FileReadBackend backend;
+    FileReadStats stats;
+    size_t depthSamples = 0;
+    size_t depthSum = 0;
+
+    void sampleDepth(size_t inFlight)
+    {
+      depthSamples++;
+      depthSum += inFlight;
+      stats.maxQueueDepth = std::max(stats.maxQueueDepth, inFlight);
+    }
+
+    void deliver(size_t index, FileBuffer &&file, const Callback &onRead)
+    {
+      if (file.ok)
+        stats.bytes += file.bytes.size();
+      else
+      {
+        stats.failed++;
+        std::cerr << "ERROR::FILE_READER::CANNOT_READ " << file.path << std::endl;
+      }
+      onRead(index, std::move(file));
+    }
+
+    // opens the file and sizes its buffer; -1 when it cannot be read
+    static int openFile(FileBuffer &file)
+    {
+#ifdef _WIN32
+      return -1;
+#else
+      int fd = ::open(file.path.c_str(), O_RDONLY);
+      struct stat info;
+      if (fd >= 0 && fstat(fd, &info) != 0)
+      {
+        ::close(fd);
+        fd = -1;
+      }
+      if (fd >= 0)
+      {
+        file.bytes.resize(size_t(info.st_size));
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+      }
+      return fd;
+#endif
+    }
+
+    // every file read by up to queueDepth tasks on the reader threads, each a blocking
+    // pread loop; results come back to the calling thread through a queue
+    void readThreads(const std::vector<std::string> &paths, const Callback &onRead)
+    {
+      stats.backend = "threads";
+
+      std::mutex mutex;
+      std::condition_variable ready;
+      std::deque<std::pair<size_t, FileBuffer>> completed;
+      std::atomic<size_t> next{0};
+      std::atomic<size_t> inFlight{0};
+      std::vector<size_t> samples;
+      // tasks done, they use this frame's state so all of them are waited for
+      size_t finished = 0;
+
+      auto work = [&]()
+      {
+        for (size_t index = next++; index < paths.size(); index = next++)
+        {
+          size_t depth = ++inFlight;
+          FileBuffer file;
+          file.path = paths[index];
+          int fd = openFile(file);
+#ifndef _WIN32
+          if (fd >= 0)
+          {
+            size_t done = 0;
+            while (done < file.bytes.size())
+            {
+              ssize_t count = pread(fd, file.bytes.data() + done, file.bytes.size() - done, off_t(done));
+              if (count <= 0)
+                break;
+              done += size_t(count);
+            }
+            file.ok = done == file.bytes.size();
+            ::close(fd);
+          }
+#endif
+          inFlight--;
+
+          std::lock_guard<std::mutex> lock(mutex);
+          samples.push_back(depth);
+          completed.emplace_back(index, std::move(file));
+          ready.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished++;
+        ready.notify_one();
+      };
+
+      size_t taskCount = std::min(size_t(queueDepth), paths.size());
+      FileReadThreads &pool = FileReadThreads::get();
+      for (size_t i = 0; i < taskCount; i++)
+      {
+        pool.run(work, taskCount);
+      }
+
+      for (size_t delivered = 0; delivered < paths.size(); delivered++)
+      {
+        std::pair<size_t, FileBuffer> result;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          ready.wait(lock, [&]()
+                     { return !completed.empty(); });
+          result = std::move(completed.front());
+          completed.pop_front();
+          for (size_t depth : samples)
+            sampleDepth(depth);
+          samples.clear();
+        }
+        deliver(result.first, std::move(result.second), onRead);
+      }
+
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [&]()
+                 { return finished == taskCount; });
+    }
+
+#ifdef NSI_HAVE_LIBURING
+    // chunked reads so large files keep several requests in flight too
+    static constexpr size_t chunkBytes = size_t(1) << 20;
+
+    struct UringFile
+    {
+      FileBuffer buffer;
+      int fd = -1;
+      // bytes handed out as reads so far
+      size_t issued = 0;
+      // reads in flight, and short reads waiting to continue
+      size_t pending = 0;
+      size_t retries = 0;
+      bool failed = false;
+      bool delivered = false;
+    };
+
+    struct UringRead
+    {
+      size_t file;
+      size_t offset;
+      size_t length;
+    };
+
+    // false when the kernel refuses a ring (old kernel, seccomp), the threads take over
+    bool readUring(const std::vector<std::string> &paths, const Callback &onRead)
+    {
+      io_uring ring;
+      if (io_uring_queue_init(queueDepth, &ring, 0) < 0)
+      {
+        if (backend == FileReadBackend::IoUring)
+          std::cerr << "ERROR::FILE_READER::IO_URING_UNAVAILABLE" << std::endl;
+        return false;
+      }
+      stats.backend = "io_uring";
+
+      std::vector<UringFile> files(paths.size());
+      for (size_t i = 0; i < paths.size(); i++)
+      {
+        files[i].buffer.path = paths[i];
+      }
+      // slots for reads in flight, their index is the request's user data
+      std::vector<UringRead> slots(queueDepth);
+      std::vector<size_t> freeSlots;
+      for (size_t i = queueDepth; i-- > 0;)
+      {
+        freeSlots.push_back(i);
+      }
+      // the rest of short reads, continued before anything new
+      std::deque<UringRead> retries;
+
+      size_t nextFile = 0;
+      size_t delivered = 0;
+      size_t inFlight = 0;
+
+      auto finish = [&](size_t index)
+      {
+        UringFile &file = files[index];
+        if (file.delivered || file.pending > 0 || file.retries > 0 || (!file.failed && file.issued < file.buffer.bytes.size()))
+          return;
+        if (file.fd >= 0)
+          ::close(file.fd);
+        file.fd = -1;
+        file.buffer.ok = !file.failed;
+        file.delivered = true;
+        delivered++;
+        deliver(index, std::move(file.buffer), onRead);
+      };
+
+      // the next read to issue, false when everything has been
+      auto nextRead = [&](UringRead &read)
+      {
+        if (!retries.empty())
+        {
+          read = retries.front();
+          retries.pop_front();
+          files[read.file].retries--;
+          return true;
+        }
+        while (nextFile < files.size())
+        {
+          UringFile &file = files[nextFile];
+          if (file.fd < 0 && !file.failed && !file.delivered)
+          {
+            file.fd = openFile(file.buffer);
+            file.failed = file.fd < 0;
+          }
+          if (!file.failed && file.issued < file.buffer.bytes.size())
+          {
+            read = {nextFile, file.issued, std::min(chunkBytes, file.buffer.bytes.size() - file.issued)};
+            file.issued += read.length;
+            return true;
+          }
+          // empty, unreadable or fully issued
+          finish(nextFile++);
+        }
+        return false;
+      };
+
+      bool broken = false;
+      while (delivered < files.size() && !broken)
+      {
+        UringRead read;
+        size_t queued = 0;
+        while (!freeSlots.empty() && nextRead(read))
+        {
+          io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+          if (!sqe)
+          {
+            retries.push_front(read);
+            files[read.file].retries++;
+            break;
+          }
+          size_t slot = freeSlots.back();
+          freeSlots.pop_back();
+          slots[slot] = read;
+          UringFile &file = files[read.file];
+          file.pending++;
+          io_uring_prep_read(sqe, file.fd, file.buffer.bytes.data() + read.offset, unsigned(read.length), read.offset);
+          io_uring_sqe_set_data(sqe, reinterpret_cast<void *>(uintptr_t(slot)));
+          sampleDepth(++inFlight);
+          queued++;
+        }
+        if (queued > 0)
+          io_uring_submit(&ring);
+        if (inFlight == 0)
+          continue;
+
+        // one completion waited for, then whatever else is already there
+        io_uring_cqe *cqe = nullptr;
+        int waited = io_uring_wait_cqe(&ring, &cqe);
+        if (waited == -EINTR)
+          continue;
+        broken = waited < 0;
+        while (!broken && cqe)
+        {
+          size_t slot = size_t(uintptr_t(io_uring_cqe_get_data(cqe)));
+          int result = cqe->res;
+          io_uring_cqe_seen(&ring, cqe);
+          inFlight--;
+
+          UringRead done = slots[slot];
+          freeSlots.push_back(slot);
+          UringFile &file = files[done.file];
+          file.pending--;
+          if (result <= 0)
+            file.failed = true;
+          else if (size_t(result) < done.length)
+          {
+            retries.push_back({done.file, done.offset + size_t(result), done.length - size_t(result)});
+            file.retries++;
+          }
+          finish(done.file);
+
+          if (io_uring_peek_cqe(&ring, &cqe) < 0)
+            cqe = nullptr;
+        }
+      }
+
+      // waits out anything still in flight before the buffers go
+      io_uring_queue_exit(&ring);
+      if (broken)
+        std::cerr << "ERROR::FILE_READER::IO_URING_FAILED" << std::endl;
+      for (size_t i = 0; i < files.size(); i++)
+      {
+        UringFile &file = files[i];
+        if (file.delivered)
+          continue;
+        file.failed = true;
+        file.pending = file.retries = 0;
+        file.issued = file.buffer.bytes.size();
+        finish(i);
+      }
+      return true;
+    }
+#endif
+  };
+}
+
+#endif
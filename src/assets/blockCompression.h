@@ -0,0 +1,515 @@
+#ifndef ASSETS_BLOCK_COMPRESSION_H
+#define ASSETS_BLOCK_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "../jobs/jobSystem.h"
+#include "mipChain.h"
+
+namespace nsi
+{
+  // what a texture is sampled for, decides filtering and the block format
+  enum class TextureUsage : uint32_t
+  {
+    // sRGB colour, filtered in linear space
+    Color,
+    // tangent-space normals, only x and y are kept (BC5); shaders rebuild z
+    Normal,
+    // anything else sampled as stored
+    Data
+  };
+
+  // block formats the driver can sample; all false keeps textures uncompressed
+  struct TextureFormatSupport
+  {
+    // BC1, BC3
+    bool s3tc = false;
+    // BC4, BC5
+    bool rgtc = false;
+    // BC7
+    bool bptc = false;
+
+    uint32_t mask() const { return (s3tc ? 1u : 0u) | (rgtc ? 2u : 0u) | (bptc ? 4u : 0u); }
+  };
+
+  inline size_t blockBytes(TextureFormat format)
+  {
+    return format == TextureFormat::BC1 || format == TextureFormat::BC4 ? 8 : 16;
+  }
+
+  namespace bc
+  {
+    // 16 texels of a 4x4 block, row-major, always RGBA
+    struct Block
+    {
+      uint8_t texels[16][4];
+    };
+
+    // edge texels repeat for blocks hanging over the border of small levels. Missing
+    // channels read like GL samples RED/RG/RGB textures: 0 for colour, 255 for alpha
+    inline void fetchBlock(const unsigned char *pixels, int width, int height, int components, int blockX, int blockY, Block &block)
+    {
+      for (int y = 0; y < 4; y++)
+      {
+        int sy = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++)
+        {
+          int sx = std::min(blockX * 4 + x, width - 1);
+          const unsigned char *texel = pixels + (size_t(sy) * size_t(width) + size_t(sx)) * size_t(components);
+          uint8_t *out = block.texels[y * 4 + x];
+
+          for (int c = 0; c < 4; c++)
+            out[c] = c < components ? texel[c] : (c == 3 ? 255 : 0);
+        }
+      }
+    }
+
+    // endpoints along the principal axis of the first channels texels: power iteration on
+    // the covariance, then the extreme projections
+    inline void principalEndpoints(const Block &block, int channels, float low[4], float high[4])
+    {
+      float mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (const uint8_t *texel : block.texels)
+      {
+        for (int c = 0; c < channels; c++)
+          mean[c] += float(texel[c]);
+      }
+      for (int c = 0; c < channels; c++)
+        mean[c] /= 16.0f;
+
+      float covariance[4][4] = {};
+      float boxMin[4] = {255.0f, 255.0f, 255.0f, 255.0f};
+      float boxMax[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (const uint8_t *texel : block.texels)
+      {
+        for (int i = 0; i < channels; i++)
+        {
+          float di = float(texel[i]) - mean[i];
+          boxMin[i] = std::min(boxMin[i], float(texel[i]));
+          boxMax[i] = std::max(boxMax[i], float(texel[i]));
+          for (int j = 0; j < channels; j++)
+            covariance[i][j] += di * (float(texel[j]) - mean[j]);
+        }
+      }
+
+      // the box diagonal is a good start and the answer when the block is (nearly) flat
+      float axis[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (int c = 0; c < channels; c++)
+        axis[c] = boxMax[c] - boxMin[c];
+
+      for (int iteration = 0; iteration < 8; iteration++)
+      {
+        float next[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        float length = 0.0f;
+        for (int i = 0; i < channels; i++)
+        {
+          for (int j = 0; j < channels; j++)
+            next[i] += covariance[i][j] * axis[j];
+          length = std::max(length, std::abs(next[i]));
+        }
+        if (length <= 1e-6f)
+          break;
+        for (int c = 0; c < channels; c++)
+          axis[c] = next[c] / length;
+      }
+
+      float length = 0.0f;
+      for (int c = 0; c < channels; c++)
+        length += axis[c] * axis[c];
+
+      if (length <= 1e-12f)
+      {
+        // every texel is the same colour
+        for (int c = 0; c < channels; c++)
+          low[c] = high[c] = mean[c];
+        return;
+      }
+
+      float tMin = std::numeric_limits<float>::max();
+      float tMax = std::numeric_limits<float>::lowest();
+      for (const uint8_t *texel : block.texels)
+      {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++)
+          t += (float(texel[c]) - mean[c]) * axis[c];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+      }
+
+      for (int c = 0; c < channels; c++)
+      {
+        low[c] = std::clamp(mean[c] + tMin * axis[c] / length, 0.0f, 255.0f);
+        high[c] = std::clamp(mean[c] + tMax * axis[c] / length, 0.0f, 255.0f);
+      }
+    }
+
+    inline uint16_t pack565(const float rgb[3])
+    {
+      int r = int(rgb[0] * 31.0f / 255.0f + 0.5f);
+      int g = int(rgb[1] * 63.0f / 255.0f + 0.5f);
+      int b = int(rgb[2] * 31.0f / 255.0f + 0.5f);
+      return uint16_t((r << 11) | (g << 5) | b);
+    }
+
+    inline void unpack565(uint16_t color, int rgb[3])
+    {
+      int r = (color >> 11) & 31;
+      int g = (color >> 5) & 63;
+      int b = color & 31;
+      rgb[0] = (r << 3) | (r >> 2);
+      rgb[1] = (g << 2) | (g >> 4);
+      rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    inline void writeLittle(uint8_t *out, uint64_t value, int bytes)
+    {
+      for (int i = 0; i < bytes; i++)
+        out[i] = uint8_t(value >> (8 * i));
+    }
+
+    // four-colour BC1 block; also the colour half of BC3, which ignores endpoint order
+    inline void encodeBC1(const Block &block, uint8_t out[8])
+    {
+      float low[4], high[4];
+      principalEndpoints(block, 3, low, high);
+
+      uint16_t color0 = pack565(high);
+      uint16_t color1 = pack565(low);
+      // color0 > color1 selects four colours instead of three plus transparent black
+      if (color0 < color1)
+        std::swap(color0, color1);
+
+      uint32_t indices = 0;
+      if (color0 != color1)
+      {
+        int palette[4][3];
+        unpack565(color0, palette[0]);
+        unpack565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+          palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+          palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+          int best = 0;
+          int bestError = std::numeric_limits<int>::max();
+          for (int p = 0; p < 4; p++)
+          {
+            int error = 0;
+            for (int c = 0; c < 3; c++)
+            {
+              int d = int(block.texels[i][c]) - palette[p][c];
+              error += d * d;
+            }
+            if (error < bestError)
+            {
+              bestError = error;
+              best = p;
+            }
+          }
+          indices |= uint32_t(best) << (2 * i);
+        }
+      }
+
+      writeLittle(out, color0, 2);
+      writeLittle(out + 2, color1, 2);
+      writeLittle(out + 4, indices, 4);
+    }
+
+    // one channel of a block as a BC4 block, the alpha half of BC3 and each half of BC5
+    inline void encodeBC4(const Block &block, int channel, uint8_t out[8])
+    {
+      int low = 255;
+      int high = 0;
+      for (const uint8_t *texel : block.texels)
+      {
+        low = std::min(low, int(texel[channel]));
+        high = std::max(high, int(texel[channel]));
+      }
+
+      uint64_t indices = 0;
+      if (high != low)
+      {
+        // high > low selects eight interpolated values
+        int palette[8];
+        palette[0] = high;
+        palette[1] = low;
+        for (int i = 1; i < 7; i++)
+          palette[i + 1] = ((7 - i) * high + i * low) / 7;
+
+        for (int i = 0; i < 16; i++)
+        {
+          int value = block.texels[i][channel];
+          int best = 0;
+          int bestError = std::numeric_limits<int>::max();
+          for (int p = 0; p < 8; p++)
+          {
+            int error = std::abs(value - palette[p]);
+            if (error < bestError)
+            {
+              bestError = error;
+              best = p;
+            }
+          }
+          indices |= uint64_t(best) << (3 * i);
+        }
+      }
+
+      out[0] = uint8_t(high);
+      out[1] = uint8_t(low);
+      writeLittle(out + 2, indices, 6);
+    }
+
+    inline void encodeBC3(const Block &block, uint8_t out[16])
+    {
+      encodeBC4(block, 3, out);
+      encodeBC1(block, out + 8);
+    }
+
+    inline void encodeBC5(const Block &block, uint8_t out[16])
+    {
+      encodeBC4(block, 0, out);
+      encodeBC4(block, 1, out + 8);
+    }
+
+    // appends bits to a 128-bit block, least significant first
+    struct BitWriter
+    {
+      uint8_t *out;
+      int position = 0;
+
+      void write(uint32_t value, int bits)
+      {
+        for (int i = 0; i < bits; i++, position++)
+        {
+          if (value & (1u << i))
+            out[position >> 3] |= uint8_t(1u << (position & 7));
+        }
+      }
+    };
+
+    // BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a p-bit each, 4-bit indices.
+    // Endpoints from the principal axis, the four p-bit combinations are tried
+    inline void encodeBC7(const Block &block, uint8_t out[16])
+    {
+      static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+      float low[4], high[4];
+      principalEndpoints(block, 4, low, high);
+
+      int bestError = std::numeric_limits<int>::max();
+      int bestEndpoints[2][4] = {};
+      int bestPBits[2] = {0, 0};
+      int bestIndices[16] = {};
+
+      for (int pBits = 0; pBits < 4; pBits++)
+      {
+        int p[2] = {pBits & 1, pBits >> 1};
+        int endpoints[2][4];
+        int expanded[2][4];
+        for (int c = 0; c < 4; c++)
+        {
+          endpoints[0][c] = std::clamp(int(std::lround((low[c] - float(p[0])) / 2.0f)), 0, 127);
+          endpoints[1][c] = std::clamp(int(std::lround((high[c] - float(p[1])) / 2.0f)), 0, 127);
+          expanded[0][c] = (endpoints[0][c] << 1) | p[0];
+          expanded[1][c] = (endpoints[1][c] << 1) | p[1];
+        }
+
+        int palette[16][4];
+        for (int i = 0; i < 16; i++)
+        {
+          for (int c = 0; c < 4; c++)
+            palette[i][c] = ((64 - weights[i]) * expanded[0][c] + weights[i] * expanded[1][c] + 32) >> 6;
+        }
+
+        int error = 0;
+        int indices[16];
+        for (int i = 0; i < 16 && error < bestError; i++)
+        {
+          int best = 0;
+          int texelError = std::numeric_limits<int>::max();
+          for (int w = 0; w < 16; w++)
+          {
+            int e = 0;
+            for (int c = 0; c < 4; c++)
+            {
+              int d = int(block.texels[i][c]) - palette[w][c];
+              e += d * d;
+            }
+            if (e < texelError)
+            {
+              texelError = e;
+              best = w;
+            }
+          }
+          indices[i] = best;
+          error += texelError;
+        }
+
+        if (error < bestError)
+        {
+          bestError = error;
+          std::memcpy(bestEndpoints, endpoints, sizeof(endpoints));
+          bestPBits[0] = p[0];
+          bestPBits[1] = p[1];
+          std::memcpy(bestIndices, indices, sizeof(indices));
+        }
+      }
+
+      // the first index is stored without its top bit, so it has to be below 8
+      if (bestIndices[0] >= 8)
+      {
+        for (int c = 0; c < 4; c++)
+          std::swap(bestEndpoints[0][c], bestEndpoints[1][c]);
+        std::swap(bestPBits[0], bestPBits[1]);
+        for (int &index : bestIndices)
+          index = 15 - index;
+      }
+
+      std::memset(out, 0, 16);
+      BitWriter bits{out};
+      // mode 6 is six zero bits and a one
+      bits.write(1u << 6, 7);
+      for (int c = 0; c < 4; c++)
+      {
+        bits.write(uint32_t(bestEndpoints[0][c]), 7);
+        bits.write(uint32_t(bestEndpoints[1][c]), 7);
+      }
+      bits.write(uint32_t(bestPBits[0]), 1);
+      bits.write(uint32_t(bestPBits[1]), 1);
+      bits.write(uint32_t(bestIndices[0]), 3);
+      for (int i = 1; i < 16; i++)
+        bits.write(uint32_t(bestIndices[i]), 4);
+    }
+
+    inline void encodeBlock(TextureFormat format, const Block &block, uint8_t *out)
+    {
+      switch (format)
+      {
+      case TextureFormat::BC1:
+        encodeBC1(block, out);
+        break;
+      case TextureFormat::BC3:
+        encodeBC3(block, out);
+        break;
+      case TextureFormat::BC4:
+        encodeBC4(block, 0, out);
+        break;
+      case TextureFormat::BC5:
+        encodeBC5(block, out);
+        break;
+      case TextureFormat::BC7:
+        encodeBC7(block, out);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  // the block format for a chain, or its own plain format when the driver has nothing that
+  // fits. Colour with alpha prefers BC7 over BC3, opaque colour takes the smaller BC1
+  inline TextureFormat chooseFormat(const MipChain &chain, TextureUsage usage, const TextureFormatSupport &support)
+  {
+    if (chain.empty() || isCompressed(chain.format))
+      return chain.format;
+
+    bool alpha = false;
+    if (chain.components == 4)
+    {
+      const unsigned char *pixels = chain.levelData(0);
+      for (size_t i = 3; i < chain.levels[0].size && !alpha; i += 4)
+        alpha = pixels[i] != 255;
+    }
+
+    switch (usage)
+    {
+    case TextureUsage::Normal:
+      if (support.rgtc && chain.components >= 2)
+        return TextureFormat::BC5;
+      break;
+
+    case TextureUsage::Data:
+      if (support.rgtc && chain.components == 1)
+        return TextureFormat::BC4;
+      if (support.rgtc && chain.components == 2)
+        return TextureFormat::BC5;
+      [[fallthrough]];
+
+    case TextureUsage::Color:
+      if (alpha && support.bptc)
+        return TextureFormat::BC7;
+      if (alpha && support.s3tc)
+        return TextureFormat::BC3;
+      if (!alpha && support.s3tc)
+        return TextureFormat::BC1;
+      if (!alpha && support.bptc)
+        return TextureFormat::BC7;
+      break;
+    }
+
+    return chain.format;
+  }
+
+  // every level of a plain chain encoded to format, block rows split across the job system
+  inline MipChain compressMipChain(const MipChain &source, TextureFormat format, JobSystem *jobs = nullptr)
+  {
+    if (source.empty() || isCompressed(source.format) || !isCompressed(format))
+      return source;
+
+    MipChain chain;
+    chain.width = source.width;
+    chain.height = source.height;
+    chain.components = source.components;
+    chain.srgb = source.srgb;
+    chain.format = format;
+
+    size_t total = 0;
+    for (const MipLevel &level : source.levels)
+    {
+      size_t blocks = size_t((level.width + 3) / 4) * size_t((level.height + 3) / 4);
+      chain.levels.push_back({level.width, level.height, total, blocks * blockBytes(format)});
+      total += blocks * blockBytes(format);
+    }
+    chain.pixels.resize(total);
+
+    for (size_t level = 0; level < source.levels.size(); level++)
+    {
+      const MipLevel &plain = source.levels[level];
+      int blocksX = (plain.width + 3) / 4;
+      int blocksY = (plain.height + 3) / 4;
+      const unsigned char *pixels = source.levelData(level);
+      uint8_t *out = chain.pixels.data() + chain.levels[level].offset;
+
+      auto encodeRows = [&](size_t begin, size_t end)
+      {
+        bc::Block block;
+        for (size_t y = begin; y < end; y++)
+        {
+          for (int x = 0; x < blocksX; x++)
+          {
+            bc::fetchBlock(pixels, plain.width, plain.height, source.components, x, int(y), block);
+            bc::encodeBlock(format, block, out + (y * size_t(blocksX) + size_t(x)) * blockBytes(format));
+          }
+        }
+      };
+
+      // 16 block rows per job
+      if (jobs)
+        jobs->parallelFor(size_t(blocksY), 16, encodeRows);
+      else
+        encodeRows(0, size_t(blocksY));
+    }
+
+    return chain;
+  }
+}
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef ASSETS_FILE_WATCHER_H
+#define ASSETS_FILE_WATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace nsi
+{
+  // notices files changing on disk from a background thread: inotify on the files'
+  // directories on Linux (editors often save by writing a new file and renaming it over
+  // the old one, which a watch on the file itself would miss), modification times
+  // checked a few times a second elsewhere. Changes are collected until taken
+  class FileWatcher
+  {
+  public:
+    ~FileWatcher()
+    {
+      stop();
+    }
+
+    void start()
+    {
+      if (running)
+        return;
+#ifdef __linux__
+      fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (fd < 0)
+        std::cerr << "ERROR::FILE_WATCHER::INOTIFY_UNAVAILABLE, polling modification times" << std::endl;
+#endif
+      running = true;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &entry : files)
+          addDirectory(entry.first);
+      }
+      thread = std::thread(&FileWatcher::run, this);
+    }
+
+    void stop()
+    {
+      if (!running)
+        return;
+      running = false;
+      thread.join();
+#ifdef __linux__
+      if (fd >= 0)
+        ::close(fd);
+      fd = -1;
+      directories.clear();
+#endif
+    }
+
+    // any thread; paths as they will be reported back
+    void watch(const std::vector<std::string> &paths)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (const std::string &path : paths)
+      {
+        if (files.count(path))
+          continue;
+        files[path] = modified(path);
+        if (running)
+          addDirectory(path);
+      }
+    }
+
+    // the watched files that changed since the last call
+    std::vector<std::string> takeChanged()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::vector<std::string> taken(changed.begin(), changed.end());
+      changed.clear();
+      return taken;
+    }
+
+  private:
+    static constexpr auto interval = std::chrono::milliseconds(250);
+
+    std::atomic<bool> running{false};
+    std::thread thread;
+    std::mutex mutex;
+    // watched file, its last modification time
+    std::map<std::string, std::filesystem::file_time_type> files;
+    std::set<std::string> changed;
+
+#ifdef __linux__
+    int fd = -1;
+    // watch descriptor, directory as the watched paths spell it
+    std::map<int, std::string> directories;
+#endif
+
+    static std::filesystem::file_time_type modified(const std::string &path)
+    {
+      std::error_code error;
+      return std::filesystem::last_write_time(path, error);
+    }
+
+    static std::string directoryOf(const std::string &path)
+    {
+      std::string directory = std::filesystem::path(path).parent_path().generic_string();
+      return directory.empty() ? "." : directory;
+    }
+
+    // with the mutex held
+    void addDirectory(const std::string &path)
+    {
+#ifdef __linux__
+      if (fd < 0)
+        return;
+      std::string directory = directoryOf(path);
+      int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+      if (wd < 0)
+        std::cerr << "ERROR::FILE_WATCHER::CANNOT_WATCH " << directory << std::endl;
+      else
+        directories[wd] = directory;
+#endif
+    }
+
+    void run()
+    {
+      while (running)
+      {
+#ifdef __linux__
+        if (fd >= 0)
+        {
+          readEvents();
+          continue;
+        }
+#endif
+        std::this_thread::sleep_for(interval);
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &entry : files)
+        {
+          std::filesystem::file_time_type time = modified(entry.first);
+          if (time != entry.second)
+          {
+            entry.second = time;
+            changed.insert(entry.first);
+          }
+        }
+      }
+    }
+
+#ifdef __linux__
+    // waits up to one interval for events, so stop() is noticed
+    void readEvents()
+    {
+      pollfd waiting{fd, POLLIN, 0};
+      if (::poll(&waiting, 1, int(interval.count())) <= 0)
+        return;
+
+      alignas(inotify_event) char buffer[4096];
+      ssize_t length;
+      while ((length = ::read(fd, buffer, sizeof(buffer))) > 0)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (char *at = buffer; at < buffer + length;)
+        {
+          const inotify_event *event = reinterpret_cast<const inotify_event *>(at);
+          at += sizeof(inotify_event) + event->len;
+
+          auto directory = directories.find(event->wd);
+          if (directory == directories.end() || event->len == 0)
+            continue;
+          std::string path = directory->second == "." ? std::string(event->name) : directory->second + "/" + event->name;
+          if (files.count(path))
+            changed.insert(path);
+        }
+      }
+    }
+#endif
+  };
+}
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef ASSETS_MIP_CHAIN_H
+#define ASSETS_MIP_CHAIN_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "../jobs/jobSystem.h"
+#include "../terrain/noise.h"
+
+namespace nsi
+{
+  // how texel data is laid out; the first four are plain 8-bit, the rest 4x4 blocks
+  enum class TextureFormat : uint32_t
+  {
+    R8,
+    RG8,
+    RGB8,
+    RGBA8,
+    BC1,
+    BC3,
+    BC4,
+    BC5,
+    BC7
+  };
+
+  inline bool isCompressed(TextureFormat format)
+  {
+    return format >= TextureFormat::BC1;
+  }
+
+  inline TextureFormat uncompressedFormat(int components)
+  {
+    return TextureFormat(uint32_t(std::clamp(components, 1, 4) - 1));
+  }
+
+  struct MipLevel
+  {
+    int width = 0;
+    int height = 0;
+    // into MipChain::pixels
+    size_t offset = 0;
+    size_t size = 0;
+  };
+
+  // every level of a texture down to 1x1, level 0 first: tightly packed 8-bit texels with
+  // the source's component count, or 4x4 blocks once compressed. Array chains hold their
+  // layers one after another within each level, and may stop short of 1x1
+  struct MipChain
+  {
+    int width = 0;
+    int height = 0;
+    // of the source image
+    int components = 0;
+    int layers = 1;
+    bool srgb = false;
+    TextureFormat format = TextureFormat::RGBA8;
+    std::vector<MipLevel> levels;
+    std::vector<unsigned char> pixels;
+
+    bool empty() const { return levels.empty(); }
+
+    const unsigned char *levelData(size_t level) const { return pixels.data() + levels[level].offset; }
+
+    size_t getMemoryBytes() const { return pixels.size(); }
+  };
+
+  namespace mip
+  {
+    inline const std::array<float, 256> &srgbToLinearTable()
+    {
+      static const std::array<float, 256> table = []()
+      {
+        std::array<float, 256> values;
+        for (int i = 0; i < 256; i++)
+        {
+          float c = float(i) / 255.0f;
+          values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+      }();
+      return table;
+    }
+
+    // linear value halfway between consecutive sRGB codes, so encoding is a search that
+    // rounds exactly like the inverse transfer function would
+    inline const std::array<float, 255> &srgbThresholds()
+    {
+      static const std::array<float, 255> table = []()
+      {
+        std::array<float, 255> values;
+        for (int i = 0; i < 255; i++)
+        {
+          float c = (float(i) + 0.5f) / 255.0f;
+          values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+      }();
+      return table;
+    }
+
+    inline unsigned char encodeSrgb(float linear)
+    {
+      const std::array<float, 255> &thresholds = srgbThresholds();
+      return static_cast<unsigned char>(std::upper_bound(thresholds.begin(), thresholds.end(), linear) - thresholds.begin());
+    }
+
+    inline unsigned char encodeLinear(float value)
+    {
+      return static_cast<unsigned char>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+
+    // colour channels of RGB(A) images are sRGB when asked for; grey, grey-alpha and alpha
+    // always filter as stored
+    inline bool channelIsSrgb(int components, int channel, bool srgb)
+    {
+      return srgb && components >= 3 && channel < 3;
+    }
+
+#if NSI_NOISE_AVX2
+    // two output texels per iteration; returns how many were written
+    __attribute__((target("avx2"))) inline int downsampleRow8(const float *row0, const float *row1, float *out, int width)
+    {
+      const __m256 quarter = _mm256_set1_ps(0.25f);
+      int x = 0;
+      for (; x + 2 <= width; x += 2)
+      {
+        // four source texels, vertical sums first
+        __m256 a = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8), _mm256_loadu_ps(row1 + x * 8));
+        __m256 b = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8 + 8), _mm256_loadu_ps(row1 + x * 8 + 8));
+        // (texel 0, texel 2) + (texel 1, texel 3)
+        __m256 even = _mm256_permute2f128_ps(a, b, 0x20);
+        __m256 odd = _mm256_permute2f128_ps(a, b, 0x31);
+        _mm256_storeu_ps(out + x * 4, _mm256_mul_ps(_mm256_add_ps(even, odd), quarter));
+      }
+      return x;
+    }
+#endif
+
+    // 2x2 box filter of one output row from float RGBA rows; odd sizes clamp at the edge
+    inline void downsampleRow(const float *row0, const float *row1, int sourceWidth, float *out, int width)
+    {
+      int x = 0;
+#if NSI_NOISE_AVX2
+      if (cpuHasAvx2() && sourceWidth == width * 2)
+        x = downsampleRow8(row0, row1, out, width);
+#endif
+      for (; x < width; x++)
+      {
+        int x0 = std::min(2 * x, sourceWidth - 1);
+        int x1 = std::min(2 * x + 1, sourceWidth - 1);
+        for (int c = 0; c < 4; c++)
+        {
+          // summed in the same order as the AVX2 path, so both give identical bytes
+          out[x * 4 + c] = 0.25f * ((row0[x0 * 4 + c] + row1[x0 * 4 + c]) + (row0[x1 * 4 + c] + row1[x1 * 4 + c]));
+        }
+      }
+    }
+  }
+
+  // full mip chain of an 8-bit image. Filtering happens on linear values (sRGB colour
+  // channels are decoded first), rows of large levels are split across the job system
+  inline MipChain buildMipChain(const unsigned char *pixels, int width, int height, int components, bool srgb, JobSystem *jobs = nullptr)
+  {
+    MipChain chain;
+    if (!pixels || width <= 0 || height <= 0 || components < 1 || components > 4)
+      return chain;
+
+    chain.width = width;
+    chain.height = height;
+    chain.components = components;
+    chain.srgb = srgb;
+    chain.format = uncompressedFormat(components);
+
+    size_t total = 0;
+    for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2))
+    {
+      size_t size = size_t(w) * size_t(h) * size_t(components);
+      chain.levels.push_back({w, h, total, size});
+      total += size;
+      if (w == 1 && h == 1)
+        break;
+    }
+    chain.pixels.resize(total);
+    std::copy(pixels, pixels + chain.levels[0].size, chain.pixels.begin());
+
+    const std::array<float, 256> &toLinear = mip::srgbToLinearTable();
+    bool linearChannel[4];
+    for (int c = 0; c < 4; c++)
+    {
+      linearChannel[c] = !mip::channelIsSrgb(components, c, srgb);
+    }
+
+    auto forRows = [jobs](int rows, const std::function<void(size_t, size_t)> &fn)
+    {
+      // 64 rows per job
+      if (jobs)
+        jobs->parallelFor(size_t(rows), 64, fn);
+      else
+        fn(0, size_t(rows));
+    };
+
+    // level 0 widened to linear float RGBA
+    std::vector<float> current(size_t(width) * size_t(height) * 4, 1.0f);
+    forRows(height, [&](size_t begin, size_t end)
+            {
+              for (size_t i = begin * size_t(width); i < end * size_t(width); i++)
+              {
+                for (int c = 0; c < components; c++)
+                {
+                  unsigned char value = pixels[i * components + c];
+                  current[i * 4 + c] = linearChannel[c] ? float(value) / 255.0f : toLinear[value];
+                }
+              } });
+
+    std::vector<float> next;
+    for (size_t level = 1; level < chain.levels.size(); level++)
+    {
+      const MipLevel &source = chain.levels[level - 1];
+      const MipLevel &target = chain.levels[level];
+      next.resize(size_t(target.width) * size_t(target.height) * 4);
+      unsigned char *out = chain.pixels.data() + target.offset;
+
+      forRows(target.height, [&](size_t begin, size_t end)
+              {
+                for (size_t y = begin; y < end; y++)
+                {
+                  size_t y0 = std::min(2 * y, size_t(source.height - 1));
+                  size_t y1 = std::min(2 * y + 1, size_t(source.height - 1));
+                  float *row = next.data() + y * size_t(target.width) * 4;
+                  mip::downsampleRow(current.data() + y0 * size_t(source.width) * 4, current.data() + y1 * size_t(source.width) * 4,
+                                     source.width, row, target.width);
+
+                  unsigned char *texels = out + y * size_t(target.width) * components;
+                  for (int x = 0; x < target.width; x++)
+                  {
+                    for (int c = 0; c < components; c++)
+                    {
+                      float value = row[x * 4 + c];
+                      texels[x * components + c] = linearChannel[c] ? mip::encodeLinear(value) : mip::encodeSrgb(value);
+                    }
+                  }
+                } });
+
+      current.swap(next);
+    }
+
+    return chain;
+  }
+}
+
+#endif
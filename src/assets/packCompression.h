@@ -0,0 +1,168 @@
+#ifndef ASSETS_PACK_COMPRESSION_H
+#define ASSETS_PACK_COMPRESSION_H
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef NSI_HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#ifdef NSI_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace nsi
+{
+  // how a packed file's blocks are stored; the values are part of the pack format
+  enum class PackCompression : uint32_t
+  {
+    None = 0,
+    // decodes at several GB/s, for what is on the startup path
+    LZ4 = 1,
+    // noticeably smaller, slower to decode
+    Zstd = 2,
+    // build only: picked per file, see choosePackCompression
+    Auto = 3
+  };
+
+  namespace packCodec
+  {
+    // uncompressed bytes per block; every block decodes on its own
+    constexpr size_t blockSize = size_t(256) << 10;
+    // packing is offline, so both spend their time on ratio, decoding speed is unaffected
+    constexpr int lz4Level = 9;
+    constexpr int zstdLevel = 12;
+
+    // whether this build links the library for it
+    inline bool available(PackCompression compression)
+    {
+      switch (compression)
+      {
+      case PackCompression::None:
+        return true;
+      case PackCompression::LZ4:
+#ifdef NSI_HAVE_LZ4
+        return true;
+#else
+        return false;
+#endif
+      case PackCompression::Zstd:
+#ifdef NSI_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+      default:
+        return false;
+      }
+    }
+
+    inline const char *name(PackCompression compression)
+    {
+      switch (compression)
+      {
+      case PackCompression::None:
+        return "raw";
+      case PackCompression::LZ4:
+        return "lz4";
+      case PackCompression::Zstd:
+        return "zstd";
+      default:
+        return "auto";
+      }
+    }
+
+    // false for an unknown name
+    inline bool parse(const std::string &text, PackCompression &compression)
+    {
+      for (PackCompression candidate : {PackCompression::None, PackCompression::LZ4, PackCompression::Zstd, PackCompression::Auto})
+      {
+        if (text == name(candidate))
+        {
+          compression = candidate;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // the compressed block in out; false when the codec is missing or the block would not
+    // shrink, it is then stored as is
+    inline bool compress(PackCompression compression, const unsigned char *data, size_t size, std::vector<unsigned char> &out)
+    {
+      switch (compression)
+      {
+#ifdef NSI_HAVE_LZ4
+      case PackCompression::LZ4:
+      {
+        out.resize(size_t(LZ4_compressBound(int(size))));
+        int written = LZ4_compress_HC(reinterpret_cast<const char *>(data), reinterpret_cast<char *>(out.data()), int(size), int(out.size()), lz4Level);
+        out.resize(written > 0 ? size_t(written) : 0);
+        break;
+      }
+#endif
+#ifdef NSI_HAVE_ZSTD
+      case PackCompression::Zstd:
+      {
+        out.resize(ZSTD_compressBound(size));
+        size_t written = ZSTD_compress(out.data(), out.size(), data, size, zstdLevel);
+        out.resize(ZSTD_isError(written) ? 0 : written);
+        break;
+      }
+#endif
+      default:
+        out.clear();
+        break;
+      }
+      return !out.empty() && out.size() < size;
+    }
+
+    // exactly size bytes into out, false on corrupt data or a missing codec
+    inline bool decompress(PackCompression compression, const unsigned char *data, size_t storedSize, unsigned char *out, size_t size)
+    {
+      switch (compression)
+      {
+#ifdef NSI_HAVE_LZ4
+      case PackCompression::LZ4:
+        return LZ4_decompress_safe(reinterpret_cast<const char *>(data), reinterpret_cast<char *>(out), int(storedSize), int(size)) == int(size);
+#endif
+#ifdef NSI_HAVE_ZSTD
+      case PackCompression::Zstd:
+        return ZSTD_decompress(out, size, data, storedSize) == size;
+#endif
+      default:
+        return false;
+      }
+    }
+  }
+
+  // Auto's choice for a file: images are compressed already, large files (the meshes)
+  // are read at startup and want LZ4's speed, the many small ones zstd's ratio. Falls
+  // back to storing raw where the codec is not built in
+  inline PackCompression choosePackCompression(PackCompression requested, const std::string &path, uint64_t size)
+  {
+    PackCompression chosen = requested;
+    if (requested == PackCompression::Auto)
+    {
+      std::string extension = path.substr(path.find_last_of('.') + 1);
+      for (char &c : extension)
+        c = char(std::tolower((unsigned char)c));
+
+      if (extension == "png" || extension == "jpg" || extension == "jpeg")
+        chosen = PackCompression::None;
+      else if (size >= (uint64_t(1) << 20))
+        chosen = PackCompression::LZ4;
+      else
+        chosen = PackCompression::Zstd;
+    }
+    return packCodec::available(chosen) ? chosen : PackCompression::None;
+  }
+}
+
+#endif
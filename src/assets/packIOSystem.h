@@ -0,0 +1,96 @@
+#ifndef ASSETS_PACK_IO_SYSTEM_H
+#define ASSETS_PACK_IO_SYSTEM_H
+
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/Importer.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "assetPack.h"
+
+namespace nsi
+{
+  // a packed file as Assimp reads it, out of the mapping or its decoded blocks
+  class PackIOStream : public Assimp::IOStream
+  {
+  public:
+    explicit PackIOStream(PackFile file) : file(std::move(file)) {}
+
+    size_t Read(void *buffer, size_t size, size_t count) override
+    {
+      if (size == 0)
+        return 0;
+      count = std::min(count, (file.size - position) / size);
+      std::memcpy(buffer, file.data + position, size * count);
+      position += size * count;
+      return count;
+    }
+
+    size_t Write(const void *, size_t, size_t) override { return 0; }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+      size_t target = origin == aiOrigin_SET ? offset : origin == aiOrigin_CUR ? position + offset : file.size + offset;
+      if (target > file.size)
+        return aiReturn_FAILURE;
+      position = target;
+      return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override { return position; }
+    size_t FileSize() const override { return file.size; }
+    void Flush() override {}
+
+  private:
+    PackFile file;
+    size_t position = 0;
+  };
+
+  // Assimp's file access with packed files served from the pack, meshes and the material
+  // files they reference alike; anything else opens from disk as usual
+  class PackIOSystem : public Assimp::DefaultIOSystem
+  {
+  public:
+    // jobs (optional) decode compressed files' blocks in parallel
+    explicit PackIOSystem(JobSystem *jobs = nullptr) : jobs(jobs) {}
+
+    bool Exists(const char *file) const override
+    {
+      return AssetPack::get().contains(file) || Assimp::DefaultIOSystem::Exists(file);
+    }
+
+    Assimp::IOStream *Open(const char *file, const char *mode = "rb") override
+    {
+      PackFile packed;
+      if (std::strchr(mode, 'w') == nullptr && AssetPack::get().read(file, packed, jobs))
+        return new PackIOStream(std::move(packed));
+      return Assimp::DefaultIOSystem::Open(file, mode);
+    }
+
+    void Close(Assimp::IOStream *stream) override
+    {
+      if (dynamic_cast<PackIOStream *>(stream))
+        delete stream;
+      else
+        Assimp::DefaultIOSystem::Close(stream);
+    }
+
+  private:
+    JobSystem *jobs;
+  };
+
+  // an importer reads through the pack while one is open; the importer owns the handler
+  inline void usePack(Assimp::Importer &importer, JobSystem *jobs = nullptr)
+  {
+    if (AssetPack::get().isOpen())
+      importer.SetIOHandler(new PackIOSystem(jobs));
+  }
+}
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef ASSETS_TEXTURE_ASSET_H
+#define ASSETS_TEXTURE_ASSET_H
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "blockCompression.h"
+#include "mipChain.h"
+
+namespace nsi
+{
+  // needs a current context. RGTC is core since 3.0, S3TC and BPTC are extensions (BPTC is
+  // missing on macOS, so BC7 is only chosen where the driver lists it)
+  inline TextureFormatSupport detectTextureFormatSupport()
+  {
+    TextureFormatSupport support;
+    support.s3tc = GLEW_EXT_texture_compression_s3tc;
+    support.rgtc = GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc;
+    support.bptc = GLEW_ARB_texture_compression_bptc;
+    return support;
+  }
+
+  // one GL texture shared through the asset registry; the last handle deletes it, which
+  // needs a context sharing with the one it was created on. The CPU chain stays around so
+  // the texture streamer can move its finest resident level up and down, until nothing
+  // will move them again and it is released. Chains with
+  // layers become GL_TEXTURE_2D_ARRAYs, every layer of a level moves together
+  struct TextureAsset
+  {
+    GLuint id = 0;
+    GLenum target = GL_TEXTURE_2D;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    int layers = 1;
+
+    // render thread, kept by the texture streamer: the level this frame's requests asked
+    // for and the frame of the last request
+    int wantedLevel = 0;
+    uint64_t requestFrame = 0;
+
+    // levels from firstLevel to the last are uploaded, finer ones are left to the streamer
+    TextureAsset(MipChain source, int firstLevel = 0, GLenum target = GL_TEXTURE_2D)
+        : target(target), width(source.width), height(source.height), components(source.components), layers(source.layers), chain(std::move(source))
+    {
+      glGenTextures(1, &id);
+      if (chain.empty())
+        return;
+
+      glBindTexture(target, id);
+      int last = int(chain.levels.size()) - 1;
+      int first = std::clamp(firstLevel, 0, last);
+      for (int level = last; level >= first; level--)
+      {
+        specifyLevel(level, chain.levelData(size_t(level)));
+      }
+      residentLevel = first;
+      wantedLevel = first;
+
+      glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, first);
+      glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, last);
+      glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glBindTexture(target, 0);
+    }
+
+    TextureAsset(const TextureAsset &) = delete;
+    TextureAsset &operator=(const TextureAsset &) = delete;
+
+    // deleting the texture also releases its bindless handle
+    ~TextureAsset()
+    {
+      if (id)
+        glDeleteTextures(1, &id);
+    }
+
+    int getLevelCount() const { return int(chain.levels.size()); }
+    // finest level in video memory
+    int getResidentLevel() const { return residentLevel.load(); }
+    size_t getLevelBytes(int level) const { return chain.levels[size_t(level)].size; }
+
+    // video memory held by the resident levels and one being uploaded
+    size_t getMemoryBytes() const
+    {
+      int first = residentLevel.load();
+      if (uploadingLevel.load() >= 0)
+        first = std::min(first, uploadingLevel.load());
+      size_t bytes = 0;
+      for (size_t level = size_t(std::max(first, 0)); level < chain.levels.size(); level++)
+      {
+        bytes += chain.levels[level].size;
+      }
+      return bytes;
+    }
+
+    // render thread: a resident ARB_bindless_texture handle. Texture state is immutable
+    // once a handle exists, so every level is uploaded first and the streamer leaves the
+    // texture alone from then on
+    GLuint64 getBindlessHandle()
+    {
+      if (!bindlessHandle && id)
+      {
+        while (raiseResidency())
+        {
+        }
+        bindlessHandle = glGetTextureHandleARB(id);
+        glMakeTextureHandleResidentARB(bindlessHandle);
+        releaseChain();
+      }
+      return bindlessHandle;
+    }
+
+    // once the levels can no longer move (no streaming, or bindless): frees the CPU copy of
+    // the texels, the level sizes stay for the memory stats
+    void releaseChain()
+    {
+      std::vector<unsigned char>().swap(chain.pixels);
+    }
+
+    bool isBindless() const { return bindlessHandle != 0; }
+
+    // render thread: uploads the next finer level and lets sampling use it
+    bool raiseResidency()
+    {
+      int level = residentLevel.load() - 1;
+      if (level < 0 || chain.pixels.empty())
+        return false;
+
+      glBindTexture(target, id);
+      specifyLevel(level, chain.levelData(size_t(level)));
+      glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, level);
+      glBindTexture(target, 0);
+      residentLevel = level;
+      return true;
+    }
+
+    // render thread: the next finer level, to go to uploadLevel on the upload thread and
+    // finishRaise once its fence has passed; -1 when there is none or one is on its way
+    int beginRaise()
+    {
+      int level = residentLevel.load() - 1;
+      if (level < 0 || chain.pixels.empty() || isUploading())
+        return -1;
+      uploadingLevel = level;
+      return level;
+    }
+
+    // upload thread: specifies the level below the base, which sampling does not reach yet
+    void uploadLevel(int level)
+    {
+      glBindTexture(target, id);
+      specifyLevel(level, chain.levelData(size_t(level)));
+      glBindTexture(target, 0);
+    }
+
+    // render thread, after the upload's fence: binding here makes the upload context's
+    // writes visible to this one before sampling starts on the new level
+    void finishRaise(int level)
+    {
+      glBindTexture(target, id);
+      glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, level);
+      glBindTexture(target, 0);
+      residentLevel = level;
+      uploadingLevel = -1;
+    }
+
+    bool isUploading() const { return uploadingLevel.load() >= 0; }
+
+    // render thread: stops sampling the finest level and respecifies it as 0x0, which
+    // releases its storage; the last level is never dropped, nor one that could not come
+    // back, nor anything while an upload is on its way
+    bool lowerResidency()
+    {
+      int level = residentLevel.load();
+      if (level >= getLevelCount() - 1 || chain.pixels.empty() || isUploading())
+        return false;
+
+      glBindTexture(target, id);
+      glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, level + 1);
+      specifyLevel(level, nullptr, true);
+      glBindTexture(target, 0);
+      residentLevel = level + 1;
+      return true;
+    }
+
+  private:
+    MipChain chain;
+    std::atomic<int> residentLevel{0};
+    std::atomic<int> uploadingLevel{-1};
+    GLuint64 bindlessHandle = 0;
+
+    // texture bound; empty leaves a 0x0 level behind
+    void specifyLevel(int level, const unsigned char *data, bool empty = false)
+    {
+      const MipLevel &mip = chain.levels[size_t(level)];
+      GLsizei width = empty ? 0 : mip.width;
+      GLsizei height = empty ? 0 : mip.height;
+
+      if (isCompressed(chain.format))
+      {
+        const GLenum compressedFormats[] = {GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_RED_RGTC1,
+                                            GL_COMPRESSED_RG_RGTC2, GL_COMPRESSED_RGBA_BPTC_UNORM};
+        GLenum format = compressedFormats[uint32_t(chain.format) - uint32_t(TextureFormat::BC1)];
+        GLsizei size = empty ? 0 : GLsizei(mip.size);
+        if (target == GL_TEXTURE_2D_ARRAY)
+          glCompressedTexImage3D(target, level, format, width, height, empty ? 0 : layers, 0, size, data);
+        else
+          glCompressedTexImage2D(target, level, format, width, height, 0, size, data);
+        return;
+      }
+
+      const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+      GLenum format = formats[uint32_t(chain.format)];
+
+      // rows of RGB and odd-sized levels are not 4-byte aligned
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      if (target == GL_TEXTURE_2D_ARRAY)
+        glTexImage3D(target, level, format, width, height, empty ? 0 : layers, 0, format, GL_UNSIGNED_BYTE, data);
+      else
+        glTexImage2D(target, level, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+  };
+}
+
+#endif
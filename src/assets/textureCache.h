@@ -0,0 +1,340 @@
+#ifndef ASSETS_TEXTURE_CACHE_H
+#define ASSETS_TEXTURE_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../assimpModel/utils.h"
+#include "../jobs/jobSystem.h"
+#include "assetPack.h"
+#include "asyncFileReader.h"
+#include "assetRegistry.h"
+#include "blockCompression.h"
+#include "mipChain.h"
+
+namespace nsi
+{
+  struct TextureCacheStats
+  {
+    size_t hits = 0;
+    size_t misses = 0;
+    // reading cache files, and decoding, mip generation and block encoding for misses
+    double readSeconds = 0.0;
+    double buildSeconds = 0.0;
+  };
+
+  // GPU-ready mip chains of decoded images on disk, block compressed where the driver
+  // supports it. One file per source image, usage and set of supported formats, in a
+  // KTX2-like layout: identifier, header, level index, level data. A file is used while
+  // the source keeps the size and modification time it was built from, otherwise it is
+  // rebuilt. Safe to call from several workers at once
+  class TextureCache
+  {
+  public:
+    static TextureCache &get()
+    {
+      static TextureCache cache;
+      return cache;
+    }
+
+    // empty disables the disk, chains are then built on every load
+    void setDirectory(const std::string &directory) { this->directory = directory; }
+    const std::string &getDirectory() const { return directory; }
+
+    // block formats to encode to, from the render context before anything is loaded;
+    // none by default, which keeps textures as plain 8-bit
+    void setFormatSupport(const TextureFormatSupport &support) { this->support = support; }
+    const TextureFormatSupport &getFormatSupport() const { return support; }
+
+    // the file load will read for this source, to be fetched ahead of it: the cache file
+    // when there is one, otherwise the source; empty for a source the asset pack serves
+    std::string prefetchPath(const std::string &sourcePath, TextureUsage usage) const
+    {
+      std::error_code error;
+      if (!directory.empty())
+      {
+        std::string cachePath = cacheFile(sourcePath, usage);
+        if (std::filesystem::exists(cachePath, error))
+          return cachePath;
+      }
+      return AssetPack::get().contains(sourcePath) ? "" : sourcePath;
+    }
+
+    // the source's mip chain, from disk when current, otherwise decoded, filtered, encoded
+    // and written back. Empty when the source cannot be read. prefetched, when given, holds
+    // the file prefetchPath named, already read
+    MipChain load(const std::string &sourcePath, TextureUsage usage, JobSystem *jobs = nullptr, const FileBuffer *prefetched = nullptr)
+    {
+      auto start = std::chrono::steady_clock::now();
+
+      std::error_code error;
+      uint64_t sourceSize = 0;
+      int64_t sourceTime = 0;
+      // a packed source is validated against what the pack recorded, without touching the file
+      PackView packed;
+      if (AssetPack::get().find(sourcePath, packed))
+      {
+        sourceSize = packed.size;
+        sourceTime = packed.sourceTime;
+      }
+      else
+      {
+        sourceSize = std::filesystem::file_size(sourcePath, error);
+        sourceTime = error ? 0 : int64_t(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+      }
+      std::string cachePath = directory.empty() || error ? "" : cacheFile(sourcePath, usage);
+
+      auto isPrefetched = [prefetched](const std::string &path)
+      { return prefetched && prefetched->ok && !path.empty() && prefetched->path == path; };
+
+      MipChain chain;
+      if (!cachePath.empty() && (isPrefetched(cachePath) ? parse(prefetched->bytes, sourceSize, sourceTime, chain) : read(cachePath, sourceSize, sourceTime, chain)))
+      {
+        hits++;
+        addSeconds(readMicros, start);
+        return chain;
+      }
+
+      ImageData image = isPrefetched(sourcePath) ? decodeImageMemory(prefetched->bytes.data(), prefetched->bytes.size(), sourcePath)
+                                                 : decodeImageFile(sourcePath, jobs);
+      chain = buildMipChain(image.pixels, image.width, image.height, image.components, usage == TextureUsage::Color, jobs);
+      chain = compressMipChain(chain, chooseFormat(chain, usage, support), jobs);
+      misses++;
+
+      if (!cachePath.empty() && !chain.empty())
+        write(cachePath, sourceSize, sourceTime, chain);
+
+      addSeconds(buildMicros, start);
+      return chain;
+    }
+
+    TextureCacheStats getStats() const
+    {
+      TextureCacheStats stats;
+      stats.hits = hits.load();
+      stats.misses = misses.load();
+      stats.readSeconds = double(readMicros.load()) * 1e-6;
+      stats.buildSeconds = double(buildMicros.load()) * 1e-6;
+      return stats;
+    }
+
+  private:
+    // like KTX2's, with its own name so neither is mistaken for the other
+    static constexpr uint8_t identifier[12] = {0xab, 'N', 'S', 'I', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+    static constexpr uint32_t version = 2;
+    // larger than any texture GL takes, so level sizes cannot overflow
+    static constexpr uint32_t maxExtent = 1u << 16;
+
+    struct Header
+    {
+      uint8_t identifier[12];
+      uint32_t version;
+      uint32_t format;
+      uint32_t width;
+      uint32_t height;
+      uint32_t components;
+      uint32_t srgb;
+      uint32_t levelCount;
+      uint64_t sourceSize;
+      int64_t sourceTime;
+      uint64_t dataBytes;
+    };
+
+    struct LevelIndex
+    {
+      uint64_t byteOffset;
+      uint64_t byteLength;
+      uint32_t width;
+      uint32_t height;
+    };
+
+    std::string directory = "cache/textures";
+    TextureFormatSupport support;
+
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+    std::atomic<uint64_t> readMicros{0};
+    std::atomic<uint64_t> buildMicros{0};
+
+    TextureCache() = default;
+
+    void addSeconds(std::atomic<uint64_t> &micros, std::chrono::steady_clock::time_point start)
+    {
+      micros += uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    static uint64_t levelBytes(TextureFormat format, uint32_t width, uint32_t height)
+    {
+      if (isCompressed(format))
+        return uint64_t((width + 3) / 4) * uint64_t((height + 3) / 4) * blockBytes(format);
+      // the plain formats are 1 to 4 components in order
+      return uint64_t(width) * uint64_t(height) * (uint64_t(format) + 1);
+    }
+
+    std::string cacheFile(const std::string &sourcePath, TextureUsage usage) const
+    {
+      std::string normalized = AssetRegistry::normalizePath(sourcePath);
+      // FNV-1a, stable across runs unlike std::hash
+      uint64_t hash = 0xcbf29ce484222325ull;
+      for (char c : normalized)
+      {
+        hash = (hash ^ uint8_t(c)) * 0x100000001b3ull;
+      }
+
+      std::ostringstream name;
+      // a driver with other formats gets files of its own
+      name << std::hex << hash << "_" << uint32_t(usage) << "_" << support.mask() << ".ktx";
+      return (std::filesystem::path(directory) / name.str()).string();
+    }
+
+    bool read(const std::string &path, uint64_t sourceSize, int64_t sourceTime, MipChain &chain) const
+    {
+      std::ifstream file(path, std::ios::binary);
+      if (!file)
+        return false;
+
+      return readChain([&](void *out, size_t bytes)
+                       { return bool(file.read(static_cast<char *>(out), std::streamsize(bytes))); },
+                       sourceSize, sourceTime, chain);
+    }
+
+    // a cache file already in memory
+    bool parse(const std::vector<unsigned char> &bytes, uint64_t sourceSize, int64_t sourceTime, MipChain &chain) const
+    {
+      size_t position = 0;
+      return readChain([&](void *out, size_t count)
+                       {
+                         if (count > bytes.size() - position)
+                           return false;
+                         std::memcpy(out, bytes.data() + position, count);
+                         position += count;
+                         return true; },
+                       sourceSize, sourceTime, chain);
+    }
+
+    // the cache file format, from next(out, bytes) which fills out with the following bytes
+    template <typename Next>
+    bool readChain(Next &&next, uint64_t sourceSize, int64_t sourceTime, MipChain &chain) const
+    {
+      Header header;
+      if (!next(&header, sizeof(header)))
+        return false;
+
+      // stale or from another build; it is simply rebuilt
+      if (!std::equal(std::begin(identifier), std::end(identifier), header.identifier) || header.version != version ||
+          header.sourceSize != sourceSize || header.sourceTime != sourceTime || header.format > uint32_t(TextureFormat::BC7) ||
+          header.levelCount == 0 || header.levelCount > 32 || header.width == 0 || header.height == 0 ||
+          header.width > maxExtent || header.height > maxExtent)
+        return false;
+
+      std::vector<LevelIndex> index(header.levelCount);
+      if (!next(index.data(), index.size() * sizeof(LevelIndex)))
+        return false;
+
+      chain.width = int(header.width);
+      chain.height = int(header.height);
+      chain.components = int(header.components);
+      chain.srgb = header.srgb != 0;
+      chain.format = TextureFormat(header.format);
+
+      // damaged or truncated: every level must halve the last and be packed right after
+      // it at exactly the size its format takes, so the data never outgrows the image
+      uint64_t total = 0;
+      uint32_t width = header.width;
+      uint32_t height = header.height;
+      for (const LevelIndex &level : index)
+      {
+        if (level.width != width || level.height != height || level.byteOffset != total ||
+            level.byteLength != levelBytes(chain.format, width, height))
+        {
+          chain = MipChain();
+          return false;
+        }
+        chain.levels.push_back({int(level.width), int(level.height), size_t(level.byteOffset), size_t(level.byteLength)});
+        total += level.byteLength;
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+      }
+
+      if (total != header.dataBytes)
+      {
+        chain = MipChain();
+        return false;
+      }
+
+      chain.pixels.resize(header.dataBytes);
+      if (!next(chain.pixels.data(), size_t(header.dataBytes)))
+      {
+        chain = MipChain();
+        return false;
+      }
+
+      return true;
+    }
+
+    void write(const std::string &path, uint64_t sourceSize, int64_t sourceTime, const MipChain &chain) const
+    {
+      std::error_code error;
+      std::filesystem::create_directories(directory, error);
+
+      // written under a private name and renamed, so readers never see half a file
+      std::ostringstream temporary;
+      temporary << path << "." << std::this_thread::get_id() << ".tmp";
+
+      {
+        std::ofstream file(temporary.str(), std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+          std::cerr << "ERROR::TEXTURE_CACHE::CANNOT_WRITE " << temporary.str() << std::endl;
+          return;
+        }
+
+        Header header{};
+        std::copy(std::begin(identifier), std::end(identifier), header.identifier);
+        header.version = version;
+        header.format = uint32_t(chain.format);
+        header.width = uint32_t(chain.width);
+        header.height = uint32_t(chain.height);
+        header.components = uint32_t(chain.components);
+        header.srgb = chain.srgb ? 1 : 0;
+        header.levelCount = uint32_t(chain.levels.size());
+        header.sourceSize = sourceSize;
+        header.sourceTime = sourceTime;
+        header.dataBytes = uint64_t(chain.pixels.size());
+
+        std::vector<LevelIndex> index;
+        for (const MipLevel &level : chain.levels)
+        {
+          index.push_back({uint64_t(level.offset), uint64_t(level.size), uint32_t(level.width), uint32_t(level.height)});
+        }
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(index.data()), std::streamsize(index.size() * sizeof(LevelIndex)));
+        file.write(reinterpret_cast<const char *>(chain.pixels.data()), std::streamsize(chain.pixels.size()));
+        if (!file)
+        {
+          std::cerr << "ERROR::TEXTURE_CACHE::CANNOT_WRITE " << temporary.str() << std::endl;
+          file.close();
+          std::filesystem::remove(temporary.str(), error);
+          return;
+        }
+      }
+
+      std::filesystem::rename(temporary.str(), path, error);
+      if (error)
+        std::filesystem::remove(temporary.str(), error);
+    }
+  };
+}
+
+#endif
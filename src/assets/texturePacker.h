@@ -0,0 +1,289 @@
+#ifndef ASSETS_TEXTURE_PACKER_H
+#define ASSETS_TEXTURE_PACKER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "blockCompression.h"
+#include "mipChain.h"
+
+namespace nsi
+{
+  struct TexturePackSettings
+  {
+    // textures up to this size that share their size with no other go to atlas pages
+    int atlasMaxSize = 256;
+    int atlasPageSize = 1024;
+    // GL guarantees 256 layers per array
+    int maxLayers = 256;
+  };
+
+  // where a source texture ended up
+  struct TextureLayer
+  {
+    static constexpr size_t none = size_t(-1);
+
+    // into TexturePack::arrays, none for a texture that failed to load
+    size_t array = none;
+    int layer = 0;
+    // scale (xy) and offset (zw) from the texture's wrapped uv to its place in the layer
+    glm::vec4 rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+  };
+
+  struct TexturePack
+  {
+    // array chains, each uploaded as one GL_TEXTURE_2D_ARRAY
+    std::vector<MipChain> arrays;
+    // source textures of each array, atlas pages list every texture on them
+    std::vector<std::vector<size_t>> members;
+    // one per source texture
+    std::vector<TextureLayer> layers;
+    size_t atlasTextures = 0;
+  };
+
+  namespace pack
+  {
+    // atlas cells sit on this grid with a gutter as wide around them, so the first
+    // atlasLevels levels still start on whole 4x4 blocks
+    constexpr int atlasAlign = 16;
+    constexpr size_t atlasLevels = 3;
+
+    // texels per block side
+    inline int blockSize(TextureFormat format)
+    {
+      return isCompressed(format) ? 4 : 1;
+    }
+
+    inline size_t bytesPerBlock(TextureFormat format)
+    {
+      return isCompressed(format) ? blockBytes(format) : size_t(uint32_t(format) + 1);
+    }
+
+    // zeroed chain of layers like the given one, levels from width x height down
+    inline MipChain arrayChain(const MipChain &like, int width, int height, int layers, size_t levels)
+    {
+      MipChain chain;
+      chain.width = width;
+      chain.height = height;
+      chain.components = like.components;
+      chain.layers = layers;
+      chain.srgb = like.srgb;
+      chain.format = like.format;
+
+      int block = blockSize(like.format);
+      size_t total = 0;
+      for (size_t level = 0; level < levels; level++)
+      {
+        int w = std::max(1, width >> level);
+        int h = std::max(1, height >> level);
+        size_t size = size_t((w + block - 1) / block) * size_t((h + block - 1) / block) * bytesPerBlock(like.format) * size_t(layers);
+        chain.levels.push_back({w, h, total, size});
+        total += size;
+      }
+      chain.pixels.resize(total);
+      return chain;
+    }
+
+    // blocksX x blocksY source blocks written at (x, y) of a layer dstBlocksX blocks wide,
+    // with gutter blocks of wrapped texels on every side so filtering across the edge of
+    // the cell sees what GL_REPEAT would
+    inline void copyWrapped(const unsigned char *src, int blocksX, int blocksY, unsigned char *dst, int dstBlocksX, int x, int y, int gutter, size_t bytes)
+    {
+      for (int by = -gutter; by < blocksY + gutter; by++)
+      {
+        int sy = (by % blocksY + blocksY) % blocksY;
+        for (int bx = -gutter; bx < blocksX + gutter; bx++)
+        {
+          int sx = (bx % blocksX + blocksX) % blocksX;
+          std::memcpy(dst + (size_t(y + by) * size_t(dstBlocksX) + size_t(x + bx)) * bytes,
+                      src + (size_t(sy) * size_t(blocksX) + size_t(sx)) * bytes, bytes);
+        }
+      }
+    }
+
+    struct Placement
+    {
+      int page = 0;
+      int x = 0;
+      int y = 0;
+    };
+
+    // shelves of cells (sorted tallest first) on square pages of the given size; returns
+    // the page count, 0 when a cell is larger than a page
+    inline int shelfPack(const std::vector<glm::ivec2> &cells, int pageSize, std::vector<Placement> &placements)
+    {
+      placements.assign(cells.size(), Placement());
+      int page = 0, x = 0, y = 0, shelf = 0;
+      for (size_t i = 0; i < cells.size(); i++)
+      {
+        if (cells[i].x > pageSize || cells[i].y > pageSize)
+          return 0;
+        if (x + cells[i].x > pageSize)
+        {
+          x = 0;
+          y += shelf;
+          shelf = 0;
+        }
+        if (y + cells[i].y > pageSize)
+        {
+          page++;
+          x = y = shelf = 0;
+        }
+        placements[i] = {page, x, y};
+        x += cells[i].x;
+        shelf = std::max(shelf, cells[i].y);
+      }
+      return page + 1;
+    }
+  }
+
+  // groups decoded textures so a model binds a few texture arrays instead of one texture
+  // per material slot. Textures with the same size, format and level count become layers
+  // of one array. Small ones without a partner go to atlas pages: block-aligned cells with
+  // wrapped gutters, sampled through TextureLayer::rect, with only the first atlasLevels
+  // levels since the gutter runs out below that. Source chains are released as they are
+  // copied
+  inline TexturePack packTextures(std::vector<MipChain> chains, const TexturePackSettings &settings = TexturePackSettings())
+  {
+    TexturePack result;
+    result.layers.resize(chains.size());
+
+    // same size and format, in first-use order
+    using Signature = std::tuple<uint32_t, bool, int, int, size_t>;
+    std::map<Signature, size_t> groupIndex;
+    std::vector<std::vector<size_t>> groups;
+    for (size_t i = 0; i < chains.size(); i++)
+    {
+      const MipChain &chain = chains[i];
+      if (chain.empty())
+        continue;
+      Signature signature{uint32_t(chain.format), chain.srgb, chain.width, chain.height, chain.levels.size()};
+      auto [found, inserted] = groupIndex.try_emplace(signature, groups.size());
+      if (inserted)
+        groups.emplace_back();
+      groups[found->second].push_back(i);
+    }
+
+    auto atlasCandidate = [&](const std::vector<size_t> &group)
+    {
+      const MipChain &chain = chains[group[0]];
+      return group.size() == 1 && std::max(chain.width, chain.height) <= settings.atlasMaxSize && chain.width % pack::atlasAlign == 0 &&
+             chain.height % pack::atlasAlign == 0 && chain.levels.size() >= pack::atlasLevels;
+    };
+
+    // atlas candidates by format
+    std::map<std::pair<uint32_t, bool>, std::vector<size_t>> atlases;
+    std::vector<std::vector<size_t>> arrays;
+    for (std::vector<size_t> &group : groups)
+    {
+      if (atlasCandidate(group))
+      {
+        atlases[{uint32_t(chains[group[0]].format), chains[group[0]].srgb}].push_back(group[0]);
+        continue;
+      }
+      for (size_t first = 0; first < group.size(); first += size_t(settings.maxLayers))
+      {
+        arrays.emplace_back(group.begin() + first, group.begin() + std::min(group.size(), first + size_t(settings.maxLayers)));
+      }
+    }
+
+    for (std::vector<size_t> &members : arrays)
+    {
+      const MipChain &like = chains[members[0]];
+      MipChain array = pack::arrayChain(like, like.width, like.height, int(members.size()), like.levels.size());
+      for (size_t layer = 0; layer < members.size(); layer++)
+      {
+        MipChain &source = chains[members[layer]];
+        for (size_t level = 0; level < source.levels.size(); level++)
+        {
+          size_t layerBytes = source.levels[level].size;
+          std::memcpy(array.pixels.data() + array.levels[level].offset + layer * layerBytes, source.levelData(level), layerBytes);
+        }
+        source = MipChain();
+        result.layers[members[layer]] = {result.arrays.size(), int(layer), glm::vec4(1.0f, 1.0f, 0.0f, 0.0f)};
+      }
+      result.arrays.push_back(std::move(array));
+      result.members.push_back(std::move(members));
+    }
+
+    for (auto &[format, members] : atlases)
+    {
+      // a page for one texture would only add a gutter
+      if (members.size() == 1)
+      {
+        size_t i = members[0];
+        result.layers[i] = {result.arrays.size(), 0, glm::vec4(1.0f, 1.0f, 0.0f, 0.0f)};
+        result.arrays.push_back(std::move(chains[i]));
+        result.members.push_back({i});
+        continue;
+      }
+
+      std::sort(members.begin(), members.end(), [&](size_t a, size_t b)
+                { return chains[a].height > chains[b].height; });
+
+      const int gutter = pack::atlasAlign;
+      std::vector<glm::ivec2> cells;
+      for (size_t i : members)
+      {
+        cells.push_back(glm::ivec2(chains[i].width + 2 * gutter, chains[i].height + 2 * gutter));
+      }
+
+      // the smallest page that holds them all, otherwise as many full-size pages as needed
+      std::vector<pack::Placement> placements;
+      int pageSize = 128;
+      int pages = 0;
+      for (; pageSize < settings.atlasPageSize; pageSize *= 2)
+      {
+        pages = pack::shelfPack(cells, pageSize, placements);
+        if (pages == 1)
+          break;
+      }
+      if (pages != 1)
+      {
+        pageSize = settings.atlasPageSize;
+        pages = pack::shelfPack(cells, pageSize, placements);
+      }
+
+      const MipChain &like = chains[members[0]];
+      MipChain atlas = pack::arrayChain(like, pageSize, pageSize, pages, pack::atlasLevels);
+      int block = pack::blockSize(atlas.format);
+      size_t bytes = pack::bytesPerBlock(atlas.format);
+      for (size_t m = 0; m < members.size(); m++)
+      {
+        MipChain &source = chains[members[m]];
+        const pack::Placement &place = placements[m];
+        for (size_t level = 0; level < pack::atlasLevels; level++)
+        {
+          const MipLevel &from = source.levels[level];
+          const MipLevel &to = atlas.levels[level];
+          size_t layerBytes = to.size / size_t(pages);
+          int dstBlocksX = (to.width + block - 1) / block;
+          pack::copyWrapped(source.levelData(level), from.width / block, from.height / block,
+                            atlas.pixels.data() + to.offset + size_t(place.page) * layerBytes, dstBlocksX,
+                            ((place.x + gutter) >> level) / block, ((place.y + gutter) >> level) / block, (gutter >> level) / block, bytes);
+        }
+
+        float size = float(pageSize);
+        result.layers[members[m]] = {result.arrays.size(), place.page,
+                                     glm::vec4(float(source.width) / size, float(source.height) / size, float(place.x + gutter) / size, float(place.y + gutter) / size)};
+        source = MipChain();
+      }
+
+      result.atlasTextures += members.size();
+      result.arrays.push_back(std::move(atlas));
+      result.members.push_back(std::move(members));
+    }
+
+    return result;
+  }
+}
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef ASSETS_TEXTURE_STREAMER_H
+#define ASSETS_TEXTURE_STREAMER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../render/uploadThread.h"
+#include "mipChain.h"
+#include "textureAsset.h"
+
+namespace nsi
+{
+  struct TextureStreamerSettings
+  {
+    // off uploads every level at load, as before
+    bool enabled = false;
+    // video memory for all streamed textures together
+    size_t budgetBytes = size_t(512) << 20;
+    // textures start with their levels up to this size, coarser ones cost next to nothing
+    int initialMaxSize = 64;
+    // limits the hitch of raising many textures in one frame
+    size_t uploadBytesPerFrame = size_t(8) << 20;
+    // positive values pick coarser levels
+    float lodBias = 0.0f;
+    // a texture requested within this many frames keeps its levels unless the budget
+    // needs them
+    uint64_t keepFrames = 120;
+  };
+
+  struct TextureStreamerStats
+  {
+    size_t textures = 0;
+    size_t residentBytes = 0;
+    // with every level resident
+    size_t fullBytes = 0;
+    // textures short of the level this frame's requests asked for
+    size_t waiting = 0;
+    // during the last update
+    size_t raisedLevels = 0;
+    size_t droppedLevels = 0;
+    size_t uploadedBytes = 0;
+  };
+
+  // mip residency of textures under a video memory budget. Textures load with only their
+  // coarse levels; every frame drawables request the level their on-screen size needs,
+  // then update uploads the finest missing levels of the textures furthest from it and
+  // drops levels nothing asked for lately. Residency moves through GL_TEXTURE_BASE_LEVEL,
+  // dropped levels are respecified empty so the driver can release them. With an upload
+  // thread raised levels are uploaded there and sampled once their fence has passed.
+  // Tracking may happen on any thread, requests and updates on the render thread only
+  class TextureStreamer
+  {
+  public:
+    static TextureStreamer &get()
+    {
+      static TextureStreamer streamer;
+      return streamer;
+    }
+
+    // before anything is loaded
+    void setSettings(const TextureStreamerSettings &settings) { this->settings = settings; }
+    const TextureStreamerSettings &getSettings() const { return settings; }
+
+    bool isEnabled() const { return settings.enabled; }
+
+    // a started upload thread; without one levels are uploaded on the render thread
+    void setUploader(UploadThread *uploader) { this->uploader = uploader; }
+
+    // finest level a new texture starts with
+    int initialLevel(const MipChain &chain) const
+    {
+      if (!settings.enabled)
+        return 0;
+
+      for (size_t level = 0; level < chain.levels.size(); level++)
+      {
+        if (std::max(chain.levels[level].width, chain.levels[level].height) <= settings.initialMaxSize)
+          return int(level);
+      }
+      return std::max(int(chain.levels.size()) - 1, 0);
+    }
+
+    // from the upload thread as textures are created; picked up by the next update
+    void track(const std::shared_ptr<TextureAsset> &texture)
+    {
+      if (!settings.enabled || !texture)
+        return;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.push_back(texture);
+    }
+
+    // render thread, before this frame's requests
+    void beginFrame(uint64_t frame, const glm::mat4 &projection, int viewportHeight)
+    {
+      this->frame = frame;
+      // pixels per unit of size at unit distance
+      pixelScale = projection[1][1] * 0.5f * float(viewportHeight);
+    }
+
+    // render thread: the texture covers an object of this world-space radius at this
+    // distance from the camera; coverage is the part of a layer the object samples (atlas
+    // cells are a fraction of one). The finest level any request asks for wins
+    void request(TextureAsset &texture, float distance, float radius, float coverage = 1.0f)
+    {
+      if (!settings.enabled || texture.getLevelCount() == 0)
+        return;
+
+      float pixels = 2.0f * radius * pixelScale / std::max(distance, radius);
+      float texels = float(std::max(texture.width, texture.height)) * coverage;
+      int last = texture.getLevelCount() - 1;
+      // one texel per pixel; the texture is assumed to span the object once
+      int level = pixels > 0.0f ? int(std::floor(std::log2(texels / pixels) + settings.lodBias)) : last;
+      level = std::clamp(level, 0, last);
+
+      if (texture.requestFrame != frame)
+        texture.wantedLevel = level;
+      else
+        texture.wantedLevel = std::min(texture.wantedLevel, level);
+      texture.requestFrame = frame;
+    }
+
+    // render thread, after this frame's requests and before drawing
+    void update()
+    {
+      if (!settings.enabled)
+        return;
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::weak_ptr<TextureAsset> &texture : pending)
+        {
+          tracked.push_back(std::move(texture));
+        }
+        pending.clear();
+      }
+
+      // handles held for this update only, textures released elsewhere drop out
+      std::vector<std::shared_ptr<TextureAsset>> textures;
+      textures.reserve(tracked.size());
+      size_t alive = 0;
+      for (size_t i = 0; i < tracked.size(); i++)
+      {
+        if (std::shared_ptr<TextureAsset> texture = tracked[i].lock())
+        {
+          textures.push_back(std::move(texture));
+          if (alive != i)
+            tracked[alive] = std::move(tracked[i]);
+          alive++;
+        }
+      }
+      tracked.resize(alive);
+
+      stats = TextureStreamerStats();
+      stats.textures = textures.size();
+
+      size_t resident = 0;
+      std::vector<std::shared_ptr<TextureAsset>> raise;
+      std::vector<TextureAsset *> surplus;
+      for (const std::shared_ptr<TextureAsset> &texture : textures)
+      {
+        resident += texture->getMemoryBytes();
+        // bindless textures are fully resident and immutable, uploading ones wait for it
+        if (texture->isBindless() || texture->isUploading())
+          continue;
+        if (missingLevels(*texture) > 0)
+          raise.push_back(texture);
+        else if (texture->getResidentLevel() < releaseLevel(*texture))
+          surplus.push_back(texture.get());
+      }
+
+      // longest unrequested first, those go first when memory runs short
+      std::sort(surplus.begin(), surplus.end(), [](const TextureAsset *a, const TextureAsset *b)
+                { return a->requestFrame < b->requestFrame; });
+
+      // stale textures fall back to their coarse levels right away, the rest only for the budget
+      size_t next = 0;
+      for (; next < surplus.size() && isStale(*surplus[next]); next++)
+      {
+        resident -= dropTo(*surplus[next], releaseLevel(*surplus[next]));
+      }
+      for (; next < surplus.size() && resident > settings.budgetBytes; next++)
+      {
+        resident -= dropTo(*surplus[next], releaseLevel(*surplus[next]));
+      }
+
+      // furthest from the wanted level first, one level per texture per frame
+      std::sort(raise.begin(), raise.end(), [this](const std::shared_ptr<TextureAsset> &a, const std::shared_ptr<TextureAsset> &b)
+                { return missingLevels(*a) > missingLevels(*b); });
+
+      for (const std::shared_ptr<TextureAsset> &texture : raise)
+      {
+        size_t bytes = texture->getLevelBytes(texture->getResidentLevel() - 1);
+        if (stats.uploadedBytes + bytes > settings.uploadBytesPerFrame && stats.uploadedBytes > 0)
+          break;
+
+        for (; next < surplus.size() && resident + bytes > settings.budgetBytes; next++)
+        {
+          resident -= dropTo(*surplus[next], releaseLevel(*surplus[next]));
+        }
+        if (resident + bytes > settings.budgetBytes)
+          break;
+
+        if (uploader)
+        {
+          // the tasks hold the texture, it outlives the upload
+          int level = texture->beginRaise();
+          if (level < 0)
+            continue;
+          uploader->submit([texture, level]()
+                           { texture->uploadLevel(level); },
+                           [texture, level]()
+                           { texture->finishRaise(level); });
+        }
+        else
+          texture->raiseResidency();
+        resident += bytes;
+        stats.raisedLevels++;
+        stats.uploadedBytes += bytes;
+      }
+
+      for (const std::shared_ptr<TextureAsset> &texture : textures)
+      {
+        stats.fullBytes += fullBytes(*texture);
+        stats.waiting += missingLevels(*texture) > 0 ? 1 : 0;
+      }
+      stats.residentBytes = resident;
+    }
+
+    const TextureStreamerStats &getStats() const { return stats; }
+
+  private:
+    TextureStreamerSettings settings;
+
+    std::mutex mutex;
+    std::vector<std::weak_ptr<TextureAsset>> pending;
+
+    // render thread
+    std::vector<std::weak_ptr<TextureAsset>> tracked;
+    UploadThread *uploader = nullptr;
+    uint64_t frame = 0;
+    float pixelScale = 0.0f;
+    TextureStreamerStats stats;
+
+    TextureStreamer() = default;
+
+    bool isStale(const TextureAsset &texture) const
+    {
+      return frame - texture.requestFrame > settings.keepFrames;
+    }
+
+    // levels needed now; only what this frame asked for is uploaded
+    int missingLevels(const TextureAsset &texture) const
+    {
+      if (texture.requestFrame != frame)
+        return 0;
+      return std::max(texture.getResidentLevel() - texture.wantedLevel, 0);
+    }
+
+    // the finest level a texture may be cut back to when memory is short: what this frame
+    // asked for, otherwise its initial levels
+    int releaseLevel(const TextureAsset &texture) const
+    {
+      if (texture.requestFrame == frame)
+        return texture.wantedLevel;
+      return std::max(texture.wantedLevel, coarseLevel(texture));
+    }
+
+    int coarseLevel(const TextureAsset &texture) const
+    {
+      int level = 0;
+      int size = std::max(texture.width, texture.height);
+      while (size > settings.initialMaxSize && level < texture.getLevelCount() - 1)
+      {
+        size = std::max(size / 2, 1);
+        level++;
+      }
+      return level;
+    }
+
+    // returns the bytes released
+    size_t dropTo(TextureAsset &texture, int level)
+    {
+      size_t before = texture.getMemoryBytes();
+      while (texture.getResidentLevel() < level && texture.lowerResidency())
+      {
+        stats.droppedLevels++;
+      }
+      return before - texture.getMemoryBytes();
+    }
+
+    static size_t fullBytes(const TextureAsset &texture)
+    {
+      size_t bytes = 0;
+      for (int level = 0; level < texture.getLevelCount(); level++)
+      {
+        bytes += texture.getLevelBytes(level);
+      }
+      return bytes;
+    }
+  };
+}
+
+#endif
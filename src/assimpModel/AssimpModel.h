@@ -5,80 +5,570 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "../model/model.h"
+#include "../assets/assetRegistry.h"
+#include "../assets/asyncFileReader.h"
+#include "../assets/packIOSystem.h"
+#include "../assets/textureAsset.h"
+#include "../assets/textureCache.h"
+#include "../assets/texturePacker.h"
+#include "../assets/textureStreamer.h"
+#include "../jobs/jobSystem.h"
 #include "../mesh/mesh.h"
+#include "../render/bindlessMaterials.h"
+#include "../render/uploadThread.h"
 #include "utils.h"
 
 namespace nsi
 {
+  // geometry and textures of one imported file, shared by every AssimpModel of that file
+  struct ModelAsset
+  {
+    // render thread only; empty until an upload has been published
+    std::vector<Mesh> meshes;
+    // buffers uploaded, vertex arrays still to be made on the render thread
+    std::vector<Mesh> uploadedMeshes;
+    // per drawable mesh, indices into layers and a model-space bounding sphere; the
+    // uploaded ones move along with their meshes
+    std::vector<std::vector<size_t>> meshTextures;
+    std::vector<std::vector<size_t>> uploadedMeshTextures;
+    std::vector<glm::vec4> meshBounds;
+    // where each texture of the model was packed
+    std::vector<TextureLayer> layers;
+    // registry handles of the texture arrays, keep what the meshes point at alive
+    std::vector<std::shared_ptr<TextureAsset>> textures;
+    // render thread; the meshes' textures as bindless handles, when those are on
+    std::unique_ptr<MaterialBlock> materials;
+    // vertex and index bytes, counted once at upload
+    std::atomic<size_t> geometryBytes{0};
+
+    // textures are registry entries of their own and reported there
+    size_t getMemoryBytes() const { return geometryBytes.load(); }
+  };
+
   class AssimpModel : public Model
   {
   public:
-    AssimpModel(const std::string &filePath, glm::vec3 position = glm::vec3(0.0f), glm::vec3 rotation = glm::vec3(0.0f), glm::vec3 scale = glm::vec3(1.0f)) : Model(filePath, position, rotation, scale)
+    // import options, part of the registry key
+    static constexpr unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // with a job system mesh conversion and texture decoding run on its workers. With an
+    // upload thread buffers and textures are created there and the model shows up once its
+    // fence has passed, otherwise everything is created on the calling thread.
+    // Only the first model of a file imports it, the others share its meshes and textures
+    AssimpModel(const std::string &filePath, glm::vec3 position = glm::vec3(0.0f), glm::vec3 rotation = glm::vec3(0.0f), glm::vec3 scale = glm::vec3(1.0f), JobSystem *jobs = nullptr, UploadThread *uploader = nullptr) : Model(filePath, position, rotation, scale)
     {
-      loadModel(filePath);
+      asset = AssetRegistry::get().acquire<ModelAsset>("model", filePath, importFlags, [&]()
+                                                       { return importModel(filePath, jobs, uploader); });
+
+      // a failed import is not cached, this model just stays empty
+      if (!asset)
+        asset = std::make_shared<ModelAsset>();
     };
 
     ~AssimpModel() override = default;
 
     void draw(Shader &shader) override
     {
-      for (Mesh &mesh : meshes)
+      // meshes sharing a texture array bind it once, or select a bindless material
+      TextureBindings bindings;
+      bindMaterials(shader, bindings);
+      for (Mesh &mesh : asset->meshes)
       {
-        mesh.draw(shader);
+        mesh.draw(shader, &bindings);
       }
     }
 
+    void draw(ShaderVariants &variants) override
+    {
+      drawMeshes(variants, [](Mesh &mesh, Shader &shader, TextureBindings &bindings)
+                 { mesh.draw(shader, &bindings); });
+    }
+
+    // render thread: the meshes grouped by the maps their material has, every group drawn
+    // with the variant built for exactly those, so no shader samples or branches on a map
+    // that is not there. Models whose materials did not make it into a bindless block
+    // get the variants that bind textures
+    template <typename DrawMesh>
+    void drawMeshes(ShaderVariants &variants, DrawMesh &&drawMesh)
+    {
+      std::vector<Mesh> &meshes = asset->meshes;
+      unsigned bindless = asset->materials ? MATERIAL_BINDLESS : 0u;
+      // one bit per feature set already drawn
+      uint32_t drawn = 0;
+      for (size_t first = 0; first < meshes.size(); first++)
+      {
+        unsigned features = meshes[first].getFeatures() | bindless;
+        if (drawn & (1u << features))
+          continue;
+        drawn |= 1u << features;
+
+        // sampler uniforms belong to the program, so bindings start over with each variant;
+        // a variant that failed to build draws nothing
+        Shader *variant = variants.use(features);
+        if (!variant)
+          continue;
+        Shader &shader = *variant;
+        TextureBindings bindings;
+        bindMaterials(shader, bindings);
+        for (size_t i = first; i < meshes.size(); i++)
+        {
+          if ((meshes[i].getFeatures() | bindless) == features)
+            drawMesh(meshes[i], shader, bindings);
+        }
+      }
+    }
+
+    void prepare(const glm::mat4 &transform, const glm::vec3 &cameraPosition, const glm::vec3 &cameraFront, const glm::mat4 &viewProjection) override
+    {
+      requestTextures(transform, cameraPosition);
+    }
+
+    // render thread: asks the texture streamer for the levels each mesh needs when drawn
+    // with this model matrix, judged by its bounds and distance to the camera
+    void requestTextures(const glm::mat4 &transform, const glm::vec3 &cameraPosition)
+    {
+      TextureStreamer &streamer = TextureStreamer::get();
+      if (!streamer.isEnabled())
+        return;
+
+      // the largest axis scale bounds any rotation and non-uniform scale
+      float scale = std::sqrt(std::max({glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                                        glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                                        glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))}));
+      for (size_t i = 0; i < asset->meshes.size(); i++)
+      {
+        const glm::vec4 &sphere = asset->meshBounds[i];
+        glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+        float distance = glm::length(center - cameraPosition);
+        for (size_t texture : asset->meshTextures[i])
+        {
+          const TextureLayer &layer = asset->layers[texture];
+          if (layer.array != TextureLayer::none)
+            streamer.request(*asset->textures[layer.array], distance, sphere.w * scale, std::max(layer.rect.x, layer.rect.y));
+        }
+      }
+    }
+
+    // render thread: makes the bindless material block current for shader when the model
+    // has one and the shader reads it
+    bool bindMaterials(Shader &shader, TextureBindings &bindings)
+    {
+      return asset->materials && asset->materials->bind(shader, bindings);
+    }
+
+    // drawable meshes, render thread only; empty until an upload has been published
+    std::vector<Mesh> &getMeshes() { return asset->meshes; }
+
   private:
-    std::vector<Mesh> meshes;
-    std::map<std::string, Texture> loadedTextures;
-    std::string directory;
+    // a texture slot of a material, resolved to a GL texture after decoding
+    struct TextureRef
+    {
+      std::string filePath;
+      std::string type;
+      // aiTextureType; a file used in two slots is two textures
+      unsigned int slot = 0;
+      // into DecodedModel::textureKeys
+      size_t index = 0;
+    };
+
+    // everything processMesh extracts, before any GL object exists
+    struct MeshData
+    {
+      std::vector<Vertex> vertices;
+      std::vector<unsigned int> indices;
+      std::vector<TextureRef> textures;
+    };
+
+    // decoded model handed to whichever thread does the GL work
+    struct DecodedModel
+    {
+      std::string directory;
+      // every texture the model uses once, registry keys in first-use order
+      std::vector<AssetKey> textureKeys;
+      // the textures' mip chains packed into arrays, and a registry key per array
+      TexturePack pack;
+      std::vector<AssetKey> arrayKeys;
+      // arrays of other models holding some of the textures already, their layers point
+      // past the packed arrays
+      std::vector<std::shared_ptr<TextureAsset>> reusedArrays;
+      std::vector<MeshData> meshData;
+    };
+
+    // where a texture already sits on the GPU, to reuse it from any array it was packed into
+    struct ResidentTexture
+    {
+      std::weak_ptr<TextureAsset> array;
+      int layer = 0;
+      glm::vec4 rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+    };
+
+    struct ResidentTextures
+    {
+      std::mutex mutex;
+      std::unordered_map<AssetKey, ResidentTexture, AssetKeyHash> textures;
+    };
+
+    static ResidentTextures &residentTextures()
+    {
+      static ResidentTextures resident;
+      return resident;
+    }
+
+    std::shared_ptr<ModelAsset> asset;
 
     // for sRGB monitors
     // bool gammaCorrection;
 
-    void loadModel(const std::string &path)
+    static std::shared_ptr<ModelAsset> importModel(const std::string &path, JobSystem *jobs, UploadThread *uploader)
     {
       Assimp::Importer importer;
-      const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+      usePack(importer, jobs);
+      const aiScene *scene = importer.ReadFile(path, importFlags);
 
       if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
       {
         std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-        return;
+        return nullptr;
       }
 
-      directory = path.substr(0, path.find_last_of('/'));
+      auto decoded = std::make_shared<DecodedModel>();
+      decoded->directory = path.substr(0, path.find_last_of('/'));
 
       // process ASSIMP's root node recursively
-      processNode(scene->mRootNode, scene);
+      std::vector<const aiMesh *> sceneMeshes;
+      processNode(scene->mRootNode, scene, sceneMeshes);
+
+      std::vector<MeshData> meshData(sceneMeshes.size());
+      for (size_t i = 0; i < sceneMeshes.size(); i++)
+      {
+        meshData[i].textures = materialTextures(scene->mMaterials[sceneMeshes[i]->mMaterialIndex]);
+      }
+
+      // every texture once, in first-use order; materials repeat the same few files a lot
+      std::vector<AssetKey> &textureKeys = decoded->textureKeys;
+      std::unordered_map<AssetKey, size_t, AssetKeyHash> textureIndex;
+      size_t references = 0;
+      for (MeshData &data : meshData)
+      {
+        for (TextureRef &ref : data.textures)
+        {
+          AssetKey key = AssetRegistry::makeKey("texture", decoded->directory + '/' + ref.filePath, ref.slot);
+          auto [found, inserted] = textureIndex.try_emplace(std::move(key), textureKeys.size());
+          if (inserted)
+            textureKeys.push_back(found->first);
+          ref.index = found->second;
+          references++;
+        }
+      }
+
+      // textures resident in another model's array are not decoded again
+      std::vector<ResidentTexture> reused(textureKeys.size());
+      std::vector<std::shared_ptr<TextureAsset>> reusedArrays(textureKeys.size());
+      {
+        ResidentTextures &resident = residentTextures();
+        std::lock_guard<std::mutex> lock(resident.mutex);
+        for (size_t i = 0; i < textureKeys.size(); i++)
+        {
+          auto found = resident.textures.find(textureKeys[i]);
+          if (found == resident.textures.end())
+            continue;
+          reusedArrays[i] = found->second.array.lock();
+          if (reusedArrays[i])
+            reused[i] = found->second;
+          else
+            resident.textures.erase(found);
+        }
+      }
+
+      // CPU work: vertex conversion and image decoding, independent of each other
+      TextureCacheStats cacheBefore = TextureCache::get().getStats();
+      auto decodeStart = std::chrono::steady_clock::now();
+      std::vector<MipChain> chains(textureKeys.size());
+      auto convertMesh = [&](size_t i)
+      { processMesh(sceneMeshes[i], meshData[i]); };
+      auto decodeTexture = [&](size_t i, const FileBuffer *file)
+      { chains[i] = TextureCache::get().load(textureKeys[i].path, textureUsage(textureKeys[i].options), jobs, file); };
+
+      FileReadStats readStats;
+      if (jobs)
+      {
+        JobCounter counter;
+        for (size_t i = 0; i < sceneMeshes.size(); i++)
+        {
+          jobs->submit([&convertMesh, i]()
+                       { convertMesh(i); },
+                       counter);
+        }
+
+        // texture files are read in one batch; each decodes as soon as it arrives, while
+        // the rest are still being read
+        std::vector<std::string> files;
+        std::vector<size_t> fileTextures;
+        for (size_t i = 0; i < textureKeys.size(); i++)
+        {
+          if (reusedArrays[i])
+            continue;
+          std::string file = TextureCache::get().prefetchPath(textureKeys[i].path, textureUsage(textureKeys[i].options));
+          if (!file.empty())
+          {
+            files.push_back(std::move(file));
+            fileTextures.push_back(i);
+            continue;
+          }
+          jobs->submit([&decodeTexture, i]()
+                       { decodeTexture(i, nullptr); },
+                       counter);
+        }
+
+        AsyncFileReader reader;
+        readStats = reader.readAll(files, [&](size_t f, FileBuffer &&file)
+                                   {
+                                     auto buffer = std::make_shared<FileBuffer>(std::move(file));
+                                     jobs->submit([&decodeTexture, i = fileTextures[f], buffer]()
+                                                  { decodeTexture(i, buffer.get()); },
+                                                  counter); });
+        jobs->wait(counter);
+      }
+      else
+      {
+        for (size_t i = 0; i < textureKeys.size(); i++)
+        {
+          if (!reusedArrays[i])
+            decodeTexture(i, nullptr);
+        }
+        for (size_t i = 0; i < sceneMeshes.size(); i++)
+          convertMesh(i);
+      }
+
+      // same-size textures become layers of one array, small odd ones share atlas pages
+      decoded->pack = packTextures(std::move(chains));
+      size_t shared = 0;
+      for (const std::vector<size_t> &members : decoded->pack.members)
+      {
+        decoded->arrayKeys.push_back(arrayKey(textureKeys, members));
+        shared += AssetRegistry::get().find<TextureAsset>(decoded->arrayKeys.back()) ? 1 : 0;
+      }
+
+      // reused textures were left out of the pack, point them at the arrays they live in
+      size_t reusedTextures = 0;
+      for (size_t i = 0; i < textureKeys.size(); i++)
+      {
+        if (!reusedArrays[i])
+          continue;
+        auto found = std::find(decoded->reusedArrays.begin(), decoded->reusedArrays.end(), reusedArrays[i]);
+        if (found == decoded->reusedArrays.end())
+          found = decoded->reusedArrays.insert(found, reusedArrays[i]);
+        size_t array = decoded->pack.arrays.size() + size_t(found - decoded->reusedArrays.begin());
+        decoded->pack.layers[i] = TextureLayer{array, reused[i].layer, reused[i].rect};
+        reusedTextures++;
+      }
+
+      double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count();
+      TextureCacheStats cacheAfter = TextureCache::get().getStats();
+      std::cout << "ASSIMP::" << path << ": " << references << " texture references, " << textureKeys.size() << " unique, "
+                << cacheAfter.hits - cacheBefore.hits << " from the texture cache, " << cacheAfter.misses - cacheBefore.misses
+                << " decoded, " << reusedTextures << " reused from " << decoded->reusedArrays.size() << " resident arrays; "
+                << decoded->pack.arrays.size() << " texture arrays (" << shared << " already loaded), "
+                << decoded->pack.atlasTextures << " textures on atlas pages; " << decodeSeconds * 1000.0 << " ms" << std::endl;
+      if (readStats.files > 0)
+        std::cout << "ASSIMP::" << path << ": " << readStats.files << " texture files read through " << readStats.backend << ", "
+                  << readStats.megabytesPerSecond() << " MB/s, queue depth " << readStats.averageQueueDepth << " (max "
+                  << readStats.maxQueueDepth << ")" << std::endl;
+
+      decoded->meshData = std::move(meshData);
+
+      // the tasks hold the asset, so it lives until its upload is done even when every
+      // model using it is gone by then
+      auto asset = std::make_shared<ModelAsset>();
+      auto upload = [asset, decoded]()
+      { uploadModel(*asset, *decoded); };
+      auto ready = [asset]()
+      { publishMeshes(*asset); };
+
+      if (uploader)
+      {
+        uploader->submit(upload, ready);
+      }
+      else
+      {
+        upload();
+        ready();
+      }
+
+      return asset;
     };
 
-    void processNode(aiNode *node, const aiScene *scene)
+    // textures and buffers, on any context that shares objects with the renderer
+    static void uploadModel(ModelAsset &asset, DecodedModel &decoded)
+    {
+      for (size_t i = 0; i < decoded.pack.arrays.size(); i++)
+      {
+        MipChain &chain = decoded.pack.arrays[i];
+        asset.textures.push_back(AssetRegistry::get().acquire<TextureAsset>(decoded.arrayKeys[i], [&]()
+                                                                              {
+                                                                                TextureStreamer &streamer = TextureStreamer::get();
+                                                                                int firstLevel = streamer.initialLevel(chain);
+                                                                                auto texture = std::make_shared<TextureAsset>(std::move(chain), firstLevel, GL_TEXTURE_2D_ARRAY);
+                                                                                // every level is up already and stays
+                                                                                if (streamer.isEnabled())
+                                                                                  streamer.track(texture);
+                                                                                else
+                                                                                  texture->releaseChain();
+                                                                                return texture; }));
+      }
+
+      // later models find these textures in place
+      {
+        ResidentTextures &resident = residentTextures();
+        std::lock_guard<std::mutex> lock(resident.mutex);
+        for (size_t i = 0; i < decoded.pack.members.size(); i++)
+        {
+          for (size_t member : decoded.pack.members[i])
+          {
+            const TextureLayer &layer = decoded.pack.layers[member];
+            resident.textures[decoded.textureKeys[member]] = ResidentTexture{asset.textures[i], layer.layer, layer.rect};
+          }
+        }
+      }
+
+      asset.textures.insert(asset.textures.end(), decoded.reusedArrays.begin(), decoded.reusedArrays.end());
+      decoded.reusedArrays.clear();
+      decoded.pack.arrays.clear();
+      asset.layers = decoded.pack.layers;
+
+      size_t bytes = 0;
+      asset.uploadedMeshes.reserve(decoded.meshData.size());
+      for (MeshData &data : decoded.meshData)
+      {
+        std::vector<Texture> textures;
+        std::vector<size_t> indices;
+        for (const TextureRef &ref : data.textures)
+        {
+          const TextureLayer &layer = asset.layers[ref.index];
+          GLuint id = layer.array != TextureLayer::none ? asset.textures[layer.array]->id : 0;
+          textures.push_back({id, ref.type, ref.filePath, GL_TEXTURE_2D_ARRAY, layer.layer, layer.rect});
+          indices.push_back(ref.index);
+        }
+        asset.uploadedMeshTextures.push_back(std::move(indices));
+
+        bytes += data.vertices.size() * sizeof(Vertex) + data.indices.size() * sizeof(unsigned int);
+        asset.uploadedMeshes.emplace_back(std::move(data.vertices), std::move(data.indices), std::move(textures), true);
+        asset.uploadedMeshes.back().uploadBuffers();
+      }
+      asset.geometryBytes = bytes;
+    }
+
+    // render thread, after the upload is visible to it
+    static void publishMeshes(ModelAsset &asset)
+    {
+      asset.meshes.reserve(asset.meshes.size() + asset.uploadedMeshes.size());
+      for (size_t i = 0; i < asset.uploadedMeshes.size(); i++)
+      {
+        Mesh &mesh = asset.uploadedMeshes[i];
+        mesh.createVertexArray();
+        asset.meshBounds.push_back(mesh.boundingSphere());
+        asset.meshTextures.push_back(std::move(asset.uploadedMeshTextures[i]));
+        asset.meshes.push_back(std::move(mesh));
+      }
+      asset.uploadedMeshes.clear();
+      asset.uploadedMeshTextures.clear();
+
+      if (BindlessTextures::get().isEnabled())
+        buildMaterials(asset);
+    }
+
+    // render thread: every mesh's textures as bindless handles, first texture of each type
+    static void buildMaterials(ModelAsset &asset)
+    {
+      const char *slotTypes[Material::SLOTS] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+      std::vector<Material> meshMaterials(asset.meshes.size());
+      for (size_t i = 0; i < asset.meshes.size(); i++)
+      {
+        const std::vector<Texture> &textures = asset.meshes[i].textures;
+        for (size_t t = 0; t < textures.size(); t++)
+        {
+          const TextureLayer &layer = asset.layers[asset.meshTextures[i][t]];
+          for (int slot = 0; slot < Material::SLOTS; slot++)
+          {
+            MaterialTexture &entry = meshMaterials[i].textures[slot];
+            if (textures[t].type != slotTypes[slot] || entry.handle || layer.array == TextureLayer::none)
+              continue;
+            entry.handle = asset.textures[layer.array]->getBindlessHandle();
+            entry.layer = float(layer.layer);
+            entry.rect = layer.rect;
+          }
+        }
+      }
+
+      if (!asset.materials)
+        asset.materials = std::make_unique<MaterialBlock>();
+      std::vector<int> indices;
+      if (!asset.materials->build(meshMaterials, indices))
+      {
+        std::cerr << "ERROR::ASSIMP::TOO_MANY_MATERIALS_FOR_BINDLESS " << meshMaterials.size() << std::endl;
+        asset.materials.reset();
+      }
+      for (size_t i = 0; i < asset.meshes.size(); i++)
+      {
+        asset.meshes[i].material = indices[i];
+      }
+    }
+
+    // an array is shared by models whose textures packed into it the same way: keyed by
+    // its members' keys in layer order, written out in full so no two arrays collide
+    static AssetKey arrayKey(const std::vector<AssetKey> &textureKeys, const std::vector<size_t> &members)
+    {
+      std::string path;
+      for (size_t member : members)
+      {
+        path += textureKeys[member].path + "#" + std::to_string(textureKeys[member].options) + ";";
+      }
+      return AssetKey{"textureArray", path, 0};
+    }
+
+    // decides filtering and block format in the texture cache
+    static TextureUsage textureUsage(unsigned int slot)
+    {
+      if (slot == aiTextureType_DIFFUSE)
+        return TextureUsage::Color;
+      if (slot == aiTextureType_NORMALS)
+        return TextureUsage::Normal;
+      return TextureUsage::Data;
+    }
+
+    static void processNode(aiNode *node, const aiScene *scene, std::vector<const aiMesh *> &sceneMeshes)
     {
       // check parent node
       for (uint i = 0; i < node->mNumMeshes; i++)
       {
-        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
       }
 
       // process each of the node's children
       for (uint i = 0; i < node->mNumChildren; i++)
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, sceneMeshes);
     };
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // pure CPU, safe to run for several meshes at once
+    static void processMesh(const aiMesh *mesh, MeshData &data)
     {
-      std::vector<Vertex> vertices;
-      std::vector<unsigned int> indices;
-      std::vector<Texture> textures;
+      std::vector<Vertex> &vertices = data.vertices;
+      std::vector<unsigned int> &indices = data.indices;
 
       Vertex vertex;
+      vertices.reserve(mesh->mNumVertices);
+      indices.reserve(size_t(mesh->mNumFaces) * 3);
 
       for (unsigned int i = 0; i < mesh->mNumVertices; i++)
       {
@@ -137,65 +627,33 @@ namespace nsi
           indices.push_back(face.mIndices[j]);
         }
       }
+    };
 
-      // process materials
-      aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+    // texture slots of a material, in the order the shader samplers are numbered
+    static std::vector<TextureRef> materialTextures(const aiMaterial *material)
+    {
+      std::vector<TextureRef> textures;
 
       // 1. diffuse maps
-      std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-      textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
+      loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
       // 2. specular maps
-      std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-      textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
+      loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
       // 3. normal maps
-      std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
-      textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-
+      loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal", textures);
       // 4. height maps
-      std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_height");
-      textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+      loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_height", textures);
 
-      // return a mesh object created from the extracted mesh data
-      return Mesh(vertices, indices, textures);
-    };
+      return textures;
+    }
 
-    std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, const std::string typeName)
+    static void loadMaterialTextures(const aiMaterial *mat, aiTextureType type, const std::string typeName, std::vector<TextureRef> &textures)
     {
-      std::vector<Texture> textures;
-
       for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
       {
         aiString str;
         mat->GetTexture(type, i, &str);
-
-        bool check = false;
-
-        for (auto &texture : loadedTextures)
-        {
-          if (texture.second.filePath == str.C_Str())
-          {
-            textures.push_back(texture.second);
-            check = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-            break;
-          }
-        }
-
-        // check if it's a new texture
-        if (!check)
-        {
-          Texture texture;
-          texture.id = textureFromFile(str.C_Str(), this->directory);
-          texture.type = typeName;
-          texture.filePath = str.C_Str();
-          textures.push_back(texture);
-          loadedTextures.insert({str.C_Str(), texture}); // store it as texture loaded
-          // in the textures map
-        }
+        textures.push_back({str.C_Str(), typeName, unsigned(type)});
       }
-
-      return textures;
     }
   };
 };
@@ -7,58 +7,124 @@
 
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
-unsigned int textureFromFile(const char *path, const std::string &directory)
+#include "../assets/assetPack.h"
+
+// pixels decoded on the CPU, ready for upload; decoding touches no GL so it can run on workers
+struct ImageData
 {
+  int width = 0;
+  int height = 0;
+  int components = 0;
+  unsigned char *pixels = nullptr;
 
-  std::string filename = std::string(path);
-  filename = directory + '/' + filename;
+  ImageData() = default;
+  ImageData(const ImageData &) = delete;
+  ImageData &operator=(const ImageData &) = delete;
 
-  unsigned int textureId;
-  glGenTextures(1, &textureId);
+  ImageData(ImageData &&other) noexcept
+      : width(other.width), height(other.height), components(other.components), pixels(std::exchange(other.pixels, nullptr)) {}
 
-  int width, height, nrComponents;
+  ImageData &operator=(ImageData &&other) noexcept
+  {
+    if (this != &other)
+    {
+      stbi_image_free(pixels);
+      width = other.width;
+      height = other.height;
+      components = other.components;
+      pixels = std::exchange(other.pixels, nullptr);
+    }
+    return *this;
+  }
 
-  unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+  ~ImageData()
+  {
+    stbi_image_free(pixels);
+  }
+};
 
-  if (data)
+// jobs (optional) decode a compressed packed file's blocks in parallel
+ImageData decodeImageFile(const std::string &filename, nsi::JobSystem *jobs = nullptr)
+{
+  ImageData image;
+  // packed images decode straight out of the mapping
+  nsi::PackFile packed;
+  if (nsi::AssetPack::get().read(filename, packed, jobs))
+    image.pixels = stbi_load_from_memory(packed.data, int(packed.size), &image.width, &image.height, &image.components, 0);
+  else
+    image.pixels = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+
+  if (!image.pixels)
+  {
+    std::cout << "Texture failed to load at path: " << filename << std::endl;
+  }
+
+  return image;
+}
+
+// an image file already in memory; name is for the error message
+ImageData decodeImageMemory(const unsigned char *bytes, size_t size, const std::string &name)
+{
+  ImageData image;
+  image.pixels = stbi_load_from_memory(bytes, int(size), &image.width, &image.height, &image.components, 0);
+
+  if (!image.pixels)
+  {
+    std::cout << "Texture failed to load at path: " << name << std::endl;
+  }
+
+  return image;
+}
+
+ImageData decodeImage(const char *path, const std::string &directory)
+{
+  return decodeImageFile(directory + '/' + std::string(path));
+}
+
+// needs the GL context; an image that failed to decode still gets a (empty) texture name
+unsigned int uploadTexture(const ImageData &image)
+{
+  unsigned int textureId;
+  glGenTextures(1, &textureId);
+
+  if (image.pixels)
   {
     GLenum format;
-    if (nrComponents == 1)
+    if (image.components == 1)
     {
       format = GL_RED;
     }
-    else if (nrComponents == 3)
+    else if (image.components == 3)
     {
       format = GL_RGB;
     }
-    else if (nrComponents == 4)
+    else if (image.components == 4)
     {
       format = GL_RGBA;
     }
 
     glBindTexture(GL_TEXTURE_2D, textureId);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
     glGenerateMipmap(GL_TEXTURE_2D);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
-  }
-  else
-  {
-    std::cout << "Texture failed to load at path: " << path << std::endl;
-    stbi_image_free(data);
   }
 
   return textureId;
+}
+
+unsigned int textureFromFile(const char *path, const std::string &directory)
+{
+  return uploadTexture(decodeImage(path, directory));
 };
 
 #endif
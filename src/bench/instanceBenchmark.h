@@ -0,0 +1,65 @@
+#ifndef BENCH_INSTANCE_BENCHMARK_H
+#define BENCH_INSTANCE_BENCHMARK_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../camera/frustum.h"
+#include "../jobs/jobSystem.h"
+#include "../models/instanced/instanceSet.h"
+
+namespace nsi
+{
+  // per-frame cost of culling and compacting scattered instances, one thread vs the pool
+  inline void runInstanceBenchmark(int frames = 60)
+  {
+    JobSystem jobs;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> spread(-4000.0f, 4000.0f);
+    std::uniform_real_distribution<float> turn(0.0f, 6.2831853f);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1200.0f / 768.0f, 0.5f, 20000.0f);
+
+    std::cout << "instance benchmark: " << frames << " frames, " << jobs.concurrency() << " threads" << std::endl;
+
+    for (size_t count : {size_t(100000), size_t(1000000)})
+    {
+      InstanceSet instances;
+      instances.reserve(count);
+      instances.setLocalBounds(glm::vec4(0.0f, 2.0f, 0.0f, 3.0f));
+      for (size_t i = 0; i < count; i++)
+      {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(spread(rng), 0.0f, spread(rng)));
+        instances.add(glm::rotate(transform, turn(rng), glm::vec3(0.0f, 1.0f, 0.0f)));
+      }
+
+      std::vector<glm::mat4> out(count);
+
+      for (JobSystem *pool : {(JobSystem *)nullptr, &jobs})
+      {
+        size_t visible = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+          // the camera turns so the visible set changes every frame
+          float angle = 6.2831853f * float(frame) / float(frames);
+          glm::vec3 front(std::cos(angle), -0.1f, std::sin(angle));
+          glm::vec3 eye(0.0f, 20.0f, 0.0f);
+          glm::mat4 view = glm::lookAt(eye, eye + front, glm::vec3(0.0f, 1.0f, 0.0f));
+          visible += instances.cull(Frustum(projection * view), eye, out.data(), out.size(), pool);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "  " << count << " instances, " << (pool ? "pool    " : "1 thread") << ": "
+                  << seconds * 1000.0 / frames << " ms/frame, " << visible / size_t(frames) << " visible" << std::endl;
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef BENCH_IO_BENCHMARK_H
+#define BENCH_IO_BENCHMARK_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../assets/asyncFileReader.h"
+#include "../jobs/jobSystem.h"
+#include "pageCache.h"
+
+namespace nsi
+{
+  // batched reads of every asset file through each backend and several queue depths,
+  // with the page cache cold (Linux only) and warm. Each file is summed on a job as it
+  // arrives, standing in for decoding
+  inline void runIOBenchmark(const std::string &root = "ext/models")
+  {
+    std::vector<std::string> files;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(root, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+      if (it->is_regular_file())
+        files.push_back(it->path().string());
+    }
+    if (files.empty())
+    {
+      std::cerr << "ERROR::BENCH::NO_FILES " << root << std::endl;
+      return;
+    }
+
+    JobSystem jobs;
+    std::cout << "io benchmark: " << files.size() << " files under " << root << ", " << jobs.concurrency() << " threads" << std::endl;
+
+    auto run = [&](AsyncFileReader &reader, uint64_t &checksum)
+    {
+      std::atomic<uint64_t> sum{0};
+      JobCounter counter;
+      FileReadStats stats = reader.readAll(files, [&](size_t, FileBuffer &&file)
+                                           {
+                                             auto buffer = std::make_shared<FileBuffer>(std::move(file));
+                                             jobs.submit([&sum, buffer]()
+                                                         {
+                                                           uint64_t local = 0;
+                                                           for (unsigned char byte : buffer->bytes)
+                                                             local += byte;
+                                                           sum += local; },
+                                                         counter); });
+      jobs.wait(counter);
+      checksum = sum;
+      return stats;
+    };
+
+    for (FileReadBackend backend : {FileReadBackend::IoUring, FileReadBackend::Threads})
+    {
+      if (backend == FileReadBackend::IoUring && !AsyncFileReader::hasIoUring())
+      {
+        std::cout << "  io_uring: not built in" << std::endl;
+        continue;
+      }
+
+      for (unsigned depth : {1u, 4u, 16u, 64u})
+      {
+        AsyncFileReader reader(depth, backend);
+
+        bool evicted = true;
+        for (const std::string &file : files)
+        {
+          evicted = bench::evictPageCache(file) && evicted;
+        }
+        uint64_t checksum = 0;
+        FileReadStats cold = run(reader, checksum);
+        FileReadStats warm = run(reader, checksum);
+
+        // a kernel that refuses io_uring makes that pass fall back to threads, which is shown
+        std::cout << "  " << warm.backend << ", depth " << depth << ": " << double(warm.bytes) / (1024.0 * 1024.0) << " MB, cold ";
+        if (evicted)
+          std::cout << cold.megabytesPerSecond() << " MB/s";
+        else
+          std::cout << "n/a";
+        std::cout << ", warm " << warm.megabytesPerSecond() << " MB/s, queue depth " << warm.averageQueueDepth << " (max "
+                  << warm.maxQueueDepth << "), " << warm.failed << " failed, checksum " << checksum << std::endl;
+      }
+    }
+  }
+}
+
+#endif
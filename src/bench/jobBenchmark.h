@@ -0,0 +1,124 @@
+#ifndef BENCH_JOB_BENCHMARK_H
+#define BENCH_JOB_BENCHMARK_H
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "../jobs/jobSystem.h"
+#include "threadSweep.h"
+
+namespace nsi
+{
+  // scaling of the job system from 1 to N threads on a parallel-for and on a two-stage
+  // dependency graph; NSI_WORKERS caps N
+  inline void runJobBenchmark(size_t count = size_t(1) << 24, size_t grain = 16384)
+  {
+    int maxThreads = JobSystem::defaultWorkerCount() + 1;
+
+    std::vector<float> input(count);
+    for (size_t i = 0; i < count; i++)
+    {
+      input[i] = float(i % 4096) * 0.001f;
+    }
+    std::vector<float> output(count);
+
+    auto kernel = [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; i++)
+      {
+        float x = input[i];
+        output[i] = std::sin(x) * std::cos(x * 0.5f) + std::sqrt(x + 1.0f);
+      }
+    };
+
+    // partial sums per chunk, then one job that adds them up once all chunks are done
+    size_t chunks = (count + grain - 1) / grain;
+    std::vector<double> partial(chunks);
+    double total = 0.0;
+
+    auto partialSum = [&](size_t c)
+    {
+      size_t begin = c * grain;
+      size_t end = std::min(count, begin + grain);
+      double sum = 0.0;
+      for (size_t i = begin; i < end; i++)
+      {
+        sum += double(std::sqrt(input[i] * input[i] + 1.0f));
+      }
+      partial[c] = sum;
+    };
+
+    auto reduce = [&]()
+    {
+      total = 0.0;
+      for (double sum : partial)
+      {
+        total += sum;
+      }
+    };
+
+    std::cout << "job benchmark: " << count << " items, grain " << grain << ", up to " << maxThreads
+              << " threads" << std::endl;
+
+    double forBaseline = 0.0;
+    double graphBaseline = 0.0;
+    double reference = 0.0;
+    bool consistent = true;
+
+    bench::sweepThreads(maxThreads, [&](int threads, JobSystem *jobs)
+    {
+      double forSeconds = 0.0;
+      double graphSeconds = 0.0;
+
+      if (!jobs)
+      {
+        auto start = std::chrono::steady_clock::now();
+        kernel(0, count);
+        forSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (size_t c = 0; c < chunks; c++)
+        {
+          partialSum(c);
+        }
+        reduce();
+        graphSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        forBaseline = forSeconds;
+        graphBaseline = graphSeconds;
+        reference = total;
+      }
+      else
+      {
+        auto start = std::chrono::steady_clock::now();
+        jobs->parallelFor(count, grain, kernel);
+        forSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        JobCounter sums;
+        JobCounter done;
+        for (size_t c = 0; c < chunks; c++)
+        {
+          jobs->submit([&partialSum, c]()
+                       { partialSum(c); },
+                       sums);
+        }
+        jobs->submitAfter(sums, reduce, &done);
+        jobs->wait(done);
+        graphSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        consistent = consistent && total == reference;
+      }
+
+      std::cout << "  " << (threads < 10 ? " " : "") << threads << " thread" << (threads > 1 ? "s" : " ")
+                << ": parallelFor " << forSeconds * 1000.0 << " ms (x" << forBaseline / forSeconds << ")"
+                << ", graph " << graphSeconds * 1000.0 << " ms (x" << graphBaseline / graphSeconds << ")"
+                << std::endl; });
+
+    std::cout << "  deterministic: " << (consistent ? "yes" : "NO") << std::endl;
+  }
+}
+
+#endif
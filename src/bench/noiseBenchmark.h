@@ -0,0 +1,88 @@
+#ifndef BENCH_NOISE_BENCHMARK_H
+#define BENCH_NOISE_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "../jobs/jobSystem.h"
+#include "../terrain/noiseHeightSource.h"
+#include "threadSweep.h"
+
+namespace nsi
+{
+  inline uint64_t hashHeights(const std::vector<float> &heights)
+  {
+    // FNV-1a over the raw bits, any difference between runs shows up
+    uint64_t hash = 1469598103934665603ull;
+    for (float h : heights)
+    {
+      uint32_t bits;
+      std::memcpy(&bits, &h, sizeof(bits));
+      hash = (hash ^ bits) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  // heightmap throughput for the scalar path and for 1..N threads with SIMD, checking that
+  // every configuration produces the same bits
+  inline void runNoiseBenchmark(int maxThreads = 0, int size = 2048)
+  {
+    if (maxThreads <= 0)
+      maxThreads = JobSystem::defaultWorkerCount() + 1;
+
+    NoiseHeightSource source;
+    glm::vec2 origin(-8192.0f, -8192.0f);
+    float spacing = 16384.0f / float(size);
+    double samples = double(size) * double(size);
+
+    std::cout << "noise benchmark: " << size << "x" << size << " samples, " << source.getSettings().octaves
+              << " octaves, avx2 " << (cpuHasAvx2() ? "yes" : "no") << std::endl;
+
+    // inline without a job system
+    auto run = [&](JobSystem *jobs, bool simd, uint64_t &hash)
+    {
+      source.setSimdEnabled(simd);
+      if (!jobs)
+      {
+        auto start = std::chrono::steady_clock::now();
+        Heightfield field(size, size, origin, spacing);
+        for (int row = 0; row < size; row++)
+        {
+          source.sampleRow(origin.x, spacing, 0, size, origin.y + float(row) * spacing, &field.at(0, row));
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        hash = hashHeights(field.heights);
+        return seconds;
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      Heightfield field = generateHeightfield(source, origin, spacing, size, size, *jobs);
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      hash = hashHeights(field.heights);
+      return seconds;
+    };
+
+    uint64_t reference = 0;
+    double scalarSeconds = run(nullptr, false, reference);
+    std::cout << "  scalar   1 thread : " << samples / scalarSeconds / 1e6 << " Msamples/s" << std::endl;
+
+    bool deterministic = true;
+    bench::sweepThreads(maxThreads, [&](int threads, JobSystem *jobs)
+    {
+      uint64_t hash = 0;
+      double seconds = run(jobs, true, hash);
+      deterministic = deterministic && hash == reference;
+
+      std::cout << "  simd " << (threads < 10 ? "   " : "  ") << threads << " thread" << (threads > 1 ? "s" : " ")
+                << ": " << samples / seconds / 1e6 << " Msamples/s"
+                << (hash == reference ? "" : "  (MISMATCH)") << std::endl; });
+
+    source.setSimdEnabled(true);
+    std::cout << "  deterministic: " << (deterministic ? "yes" : "NO") << std::endl;
+  }
+}
+
+#endif
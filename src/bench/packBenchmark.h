@@ -0,0 +1,97 @@
+#ifndef BENCH_PACK_BENCHMARK_H
+#define BENCH_PACK_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../assets/assetPack.h"
+#include "../jobs/jobSystem.h"
+#include "pageCache.h"
+
+namespace nsi
+{
+  namespace bench
+  {
+    // maps the pack and brings every file into memory as a loader would; returns seconds.
+    // The bytes are summed so raw files, read in place, are touched as well
+    inline double loadPack(const std::string &path, JobSystem &jobs, size_t &bytes, uint64_t &checksum)
+    {
+      auto start = std::chrono::steady_clock::now();
+      AssetPack &pack = AssetPack::get();
+      if (!pack.open(path))
+        return -1.0;
+
+      bytes = 0;
+      checksum = 0;
+      PackFile file;
+      for (const std::string &name : pack.getFileNames())
+      {
+        if (!pack.read(name, file, &jobs))
+          continue;
+        for (size_t i = 0; i < file.size; i++)
+        {
+          checksum += file.data[i];
+        }
+        bytes += file.size;
+      }
+      pack.close();
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+  }
+
+  // load time of the terrain models from a raw, an LZ4 and a zstd pack, with the page
+  // cache cold (dropped before the run) and warm (best of a few runs right after)
+  inline void runPackBenchmark(const std::string &root = "ext/models/mountain1", int warmRuns = 3)
+  {
+    std::error_code error;
+    if (!std::filesystem::is_directory(root, error))
+    {
+      std::cerr << "ERROR::BENCH::NO_MODELS " << root << std::endl;
+      return;
+    }
+
+    JobSystem jobs;
+    std::filesystem::create_directories("cache/bench", error);
+    std::cout << "pack benchmark: " << root << ", " << jobs.concurrency() << " threads" << std::endl;
+
+    for (PackCompression compression : {PackCompression::None, PackCompression::LZ4, PackCompression::Zstd})
+    {
+      const char *name = packCodec::name(compression);
+      if (!packCodec::available(compression))
+      {
+        std::cout << "  " << name << ": not built in" << std::endl;
+        continue;
+      }
+
+      std::string path = std::string("cache/bench/terrain-") + name + ".pack";
+      if (!AssetPack::build(path, {root}, compression))
+        continue;
+
+      size_t bytes = 0;
+      uint64_t checksum = 0;
+      double cold = bench::evictPageCache(path) ? bench::loadPack(path, jobs, bytes, checksum) : -1.0;
+      double warm = -1.0;
+      for (int run = 0; run < warmRuns; run++)
+      {
+        double seconds = bench::loadPack(path, jobs, bytes, checksum);
+        if (seconds >= 0.0 && (warm < 0.0 || seconds < warm))
+          warm = seconds;
+      }
+
+      double packMB = double(std::filesystem::file_size(path, error)) / (1024.0 * 1024.0);
+      double loadedMB = double(bytes) / (1024.0 * 1024.0);
+      std::cout << "  " << name << ": " << packMB << " MB pack, " << loadedMB << " MB loaded, cold ";
+      if (cold >= 0.0)
+        std::cout << cold * 1000.0 << " ms";
+      else
+        std::cout << "n/a";
+      std::cout << ", warm " << warm * 1000.0 << " ms (" << loadedMB / warm << " MB/s), checksum " << checksum << std::endl;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef BENCH_PAGE_CACHE_H
+#define BENCH_PAGE_CACHE_H
+
+#include <string>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace nsi
+{
+  namespace bench
+  {
+    // drops a file's pages so the next read comes from the disk; only Linux offers that
+    // without root
+    inline bool evictPageCache(const std::string &path)
+    {
+#ifdef __linux__
+      int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+        return false;
+      // dirty pages would stay cached
+      fdatasync(fd);
+      bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+      close(fd);
+      return evicted;
+#else
+      (void)path;
+      return false;
+#endif
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef BENCH_PHYSICS_BENCHMARK_H
+#define BENCH_PHYSICS_BENCHMARK_H
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../physics/characterPhysics.h"
+#include "../physics/terrainCollider.h"
+#include "../terrain/noiseHeightSource.h"
+
+namespace nsi
+{
+  // batched ground queries and full character steps against a noise tile, scalar vs SIMD
+  inline void runPhysicsBenchmark(int bodyCount = 10000, int steps = 240)
+  {
+    NoiseHeightSource source;
+    // a spacing other than 1 so the paths also have to agree on the division
+    TerrainCollider collider(source, 1024.0f, 0.75f);
+    collider.focus(0.0f, 0.0f);
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> spread(-400.0f, 400.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+    std::vector<CharacterBody> start(bodyCount);
+    std::vector<glm::vec2> directions(bodyCount);
+    for (int i = 0; i < bodyCount; i++)
+    {
+      start[i].position = glm::vec3(spread(rng), 0.0f, spread(rng));
+      start[i].position.y = collider.height(start[i].position.x, start[i].position.z);
+      float a = angle(rng);
+      directions[i] = glm::vec2(std::cos(a), std::sin(a));
+    }
+
+    std::cout << "physics benchmark: " << bodyCount << " bodies, " << steps << " steps, avx2 "
+              << (cpuHasAvx2() ? "yes" : "no") << std::endl;
+
+    std::vector<float> xs(bodyCount), zs(bodyCount), out(bodyCount), scalarOut;
+    for (int i = 0; i < bodyCount; i++)
+    {
+      xs[i] = start[i].position.x;
+      zs[i] = start[i].position.z;
+    }
+
+    double reference = 0.0;
+    for (bool simd : {false, true})
+    {
+      collider.setSimdEnabled(simd);
+
+      auto begin = std::chrono::steady_clock::now();
+      for (int s = 0; s < steps; s++)
+      {
+        collider.heights(xs.data(), zs.data(), out.data(), bodyCount);
+      }
+      double querySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+      if (!simd)
+        scalarOut = out;
+
+      CharacterPhysics physics;
+      std::vector<CharacterBody> bodies = start;
+      float h = 1.0f / 120.0f;
+
+      begin = std::chrono::steady_clock::now();
+      for (int s = 0; s < steps; s++)
+      {
+        for (int i = 0; i < bodyCount; i++)
+        {
+          bodies[i].move = glm::vec3(directions[i].x, 0.0f, directions[i].y) * (4.0f * h);
+        }
+        physics.stepBodies(bodies, collider, h);
+      }
+      double stepSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+      // both paths walk the bodies to the same place
+      double checksum = 0.0;
+      for (const CharacterBody &body : bodies)
+      {
+        checksum += double(body.position.y);
+      }
+      if (!simd)
+        reference = checksum;
+
+      double queries = double(bodyCount) * double(steps);
+      std::cout << "  " << (simd ? "simd  " : "scalar") << ": " << queries / querySeconds / 1e3 << " queries/ms, "
+                << queries / stepSeconds / 1e3 << " body steps/ms"
+                << (simd && (checksum != reference || out != scalarOut) ? "  (MISMATCH)" : "") << std::endl;
+    }
+
+    collider.setSimdEnabled(true);
+  }
+}
+
+#endif
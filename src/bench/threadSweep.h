@@ -0,0 +1,36 @@
+#ifndef BENCH_THREAD_SWEEP_H
+#define BENCH_THREAD_SWEEP_H
+
+#include <algorithm>
+
+#include "../jobs/jobSystem.h"
+
+namespace nsi
+{
+  namespace bench
+  {
+    // calls run(threads, jobs) for 1, 2, 4, ... threads, always ending on maxThreads even
+    // when it is not a power of two. jobs is a pool of threads - 1 workers (the caller
+    // works too), null for 1 thread since a pool of zero workers would pick the default
+    // size: run inline then
+    template <typename Run>
+    inline void sweepThreads(int maxThreads, Run &&run)
+    {
+      for (int threads = 1;; threads = std::min(threads * 2, maxThreads))
+      {
+        if (threads == 1)
+          run(threads, static_cast<JobSystem *>(nullptr));
+        else
+        {
+          JobSystem jobs(threads - 1);
+          run(threads, &jobs);
+        }
+
+        if (threads >= maxThreads)
+          break;
+      }
+    }
+  }
+}
+
+#endif
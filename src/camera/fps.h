@@ -4,6 +4,11 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+
+#include "../physics/characterPhysics.h"
+#include "../physics/terrainCollider.h"
+
 // TODO: split camera's -> Orbit Camera & FPS Camera & TPS Camera
 
 enum CameraMovement
@@ -20,6 +25,8 @@ public:
   // Basic Camera Attributes
   // where you are
   glm::vec3 position;
+  // position after the previous fixed step, rendering blends between the two
+  glm::vec3 previousPosition;
   // where you're looking
   glm::vec3 front;
   // what is considered 'up'
@@ -51,6 +58,7 @@ public:
   FPSCamera(glm::vec3 startPosition, glm::vec3 upDirection, glm::vec3 velocity, float startYaw, float startPitch)
   {
     position = startPosition;
+    previousPosition = startPosition;
     worldUp = upDirection;
     yaw = startYaw;
     pitch = startPitch;
@@ -58,18 +66,40 @@ public:
     speed = 10.0f;
     sensitivity = 0.1f;
 
-    velocity = velocity;
+    this->velocity = velocity;
     isGrounded = true;
     isFlying = false;
 
+    nsi::CharacterSettings settings;
+    settings.gravity = gravity;
+    physics = nsi::CharacterPhysics(settings);
+
     updateCameraVectors();
   }
 
+  // ground to walk on; without one the camera stands on the y = 0 plane
+  void setTerrain(nsi::TerrainCollider *collider)
+  {
+    terrain = collider;
+  }
+
   glm::mat4 getViewMatrix()
   {
     return glm::lookAt(position, position + front, up);
   }
 
+  // eye between the last two fixed steps; orientation follows the mouse directly
+  glm::vec3 getRenderPosition(float alpha) const
+  {
+    return glm::mix(previousPosition, position, alpha);
+  }
+
+  glm::mat4 getViewMatrix(float alpha) const
+  {
+    glm::vec3 eye = getRenderPosition(alpha);
+    return glm::lookAt(eye, eye + front, up);
+  }
+
   void jump()
   {
     if (isGrounded && !isFlying)
@@ -89,20 +119,30 @@ public:
     }
   }
 
-  void updatePhysics(float deltaTime)
+  // one fixed simulation step of the feet, the eye sits standHeight above; stepsLeft (this
+  // one included) shares the frame's input movement evenly between the frame's steps
+  void fixedUpdate(float stepSeconds, int stepsLeft = 1)
   {
-    if (!isFlying)
-    {
-      velocity.y += gravity * deltaTime;
-      position.y += velocity.y * deltaTime;
-
-      if (position.y <= standHeight)
-      {
-        position.y = standHeight;
-        velocity.y = 0.0f;
-        isGrounded = true;
-      }
-    }
+    previousPosition = position;
+
+    if (terrain)
+      terrain->focus(position.x, position.z);
+
+    glm::vec3 move = pendingMove / float(std::max(stepsLeft, 1));
+    pendingMove -= move;
+
+    nsi::CharacterBody body;
+    body.position = position - glm::vec3(0.0f, standHeight, 0.0f);
+    body.velocity = velocity;
+    body.move = move;
+    body.grounded = isGrounded;
+    body.flying = isFlying;
+
+    physics.step(body, terrain, stepSeconds);
+
+    position = body.position + glm::vec3(0.0f, standHeight, 0.0f);
+    velocity = body.velocity;
+    isGrounded = body.grounded;
   }
 
   void processMouseMovement(float xoffset, float yoffset)
@@ -136,13 +176,15 @@ public:
     if (strcmp(direction, "RIGHT") == 0)
       move += right;
 
-    position += glm::normalize(move) * velocity;
-
-    // Lock to ground plane
-    // position.y = standHeight;
+    // applied by the next physics step so terrain collision sees it
+    pendingMove += glm::normalize(move) * velocity;
   }
 
 private:
+  nsi::CharacterPhysics physics;
+  nsi::TerrainCollider *terrain = nullptr;
+  glm::vec3 pendingMove = glm::vec3(0.0f);
+
   void updateCameraVectors()
   {
     glm::vec3 direction;
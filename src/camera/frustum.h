@@ -0,0 +1,88 @@
+#ifndef CAMERA_FRUSTUM_H
+#define CAMERA_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../jobs/jobSystem.h"
+
+// view frustum planes extracted from a projection * view matrix (Gribb/Hartmann)
+class Frustum
+{
+public:
+  // left, right, bottom, top, near, far -> (normal.xyz, distance)
+  glm::vec4 planes[6];
+
+  Frustum() {}
+
+  Frustum(const glm::mat4 &viewProjection)
+  {
+    glm::vec4 rowX(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 rowY(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 rowZ(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 rowW(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+    planes[0] = rowW + rowX;
+    planes[1] = rowW - rowX;
+    planes[2] = rowW + rowY;
+    planes[3] = rowW - rowY;
+    planes[4] = rowW + rowZ;
+    planes[5] = rowW - rowZ;
+
+    for (glm::vec4 &plane : planes)
+    {
+      plane = plane / glm::length(glm::vec3(plane));
+    }
+  }
+
+  // conservative box test: false only when the box is fully outside one plane
+  bool intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+  {
+    for (const glm::vec4 &plane : planes)
+    {
+      // corner furthest along the plane normal
+      glm::vec3 positive(
+          plane.x >= 0.0f ? boxMax.x : boxMin.x,
+          plane.y >= 0.0f ? boxMax.y : boxMin.y,
+          plane.z >= 0.0f ? boxMax.z : boxMin.z);
+
+      if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+        return false;
+    }
+
+    return true;
+  }
+
+  bool intersects(const glm::vec3 &center, float radius) const
+  {
+    for (const glm::vec4 &plane : planes)
+    {
+      if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+        return false;
+    }
+
+    return true;
+  }
+};
+
+// visible[i] = 1 when sphere i (center.xyz, radius) touches the frustum; with a job system
+// the spheres are split in chunks of grain across its threads
+inline void cullSpheres(const Frustum &frustum, const glm::vec4 *spheres, size_t count, uint8_t *visible, nsi::JobSystem *jobs = nullptr, size_t grain = 1024)
+{
+  auto cull = [&](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; i++)
+    {
+      visible[i] = frustum.intersects(glm::vec3(spheres[i]), spheres[i].w) ? 1 : 0;
+    }
+  };
+
+  if (jobs)
+    jobs->parallelFor(count, grain, cull);
+  else
+    cull(0, count);
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef CORE_SIMULATION_SCHEDULER_H
+#define CORE_SIMULATION_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+
+namespace nsi
+{
+  struct SchedulerSettings
+  {
+    // fixed updates per second
+    double stepRate = 120.0;
+    // most fixed steps run in one frame, the rest is caught up on later frames
+    int maxStepsPerFrame = 4;
+    // wall time one frame may spend on fixed steps (0 = no limit)
+    double stepBudgetSeconds = 0.008;
+    // simulation time we are willing to owe; anything beyond is dropped
+    double maxBacklogSeconds = 0.25;
+  };
+
+  struct SchedulerStats
+  {
+    double frameSeconds = 0.0;
+    int steps = 0;
+    // steps left in the accumulator at the end of the frame
+    int deferredSteps = 0;
+    double droppedSeconds = 0.0;
+    // wall time of the last frame's steps and a smoothed per-step cost
+    double stepSeconds = 0.0;
+    double averageStepSeconds = 0.0;
+  };
+
+  // fixed-rate simulation clock: frames feed real time into an accumulator, which is
+  // drained in fixed steps, and rendering blends the last two states by alpha
+  class SimulationScheduler
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    SimulationScheduler(const SchedulerSettings &settings = SchedulerSettings()) : settings(settings)
+    {
+      start = lastFrame = Clock::now();
+    }
+
+    // samples the clock and banks the elapsed time, returns the frame time in seconds
+    double beginFrame()
+    {
+      Clock::time_point now = Clock::now();
+      double frameSeconds = std::chrono::duration<double>(now - lastFrame).count();
+      lastFrame = now;
+
+      accumulator += frameSeconds;
+      stats.frameSeconds = frameSeconds;
+      stats.droppedSeconds = 0.0;
+
+      // after a stall (window drag, breakpoint) jump ahead rather than fast-forward
+      if (accumulator > settings.maxBacklogSeconds)
+      {
+        stats.droppedSeconds = accumulator - settings.maxBacklogSeconds;
+        accumulator = settings.maxBacklogSeconds;
+      }
+
+      return frameSeconds;
+    }
+
+    // runs the fixed steps owed this frame as step(stepSeconds, stepsLeft); stepsLeft counts
+    // the current step so work queued per frame can be divided among them
+    template <typename Step>
+    int run(Step &&step)
+    {
+      double h = getStepSeconds();
+      int steps = std::min(int(accumulator / h), settings.maxStepsPerFrame);
+
+      Clock::time_point begin = Clock::now();
+      int taken = 0;
+      while (taken < steps)
+      {
+        step(float(h), steps - taken);
+        accumulator -= h;
+        taken++;
+
+        // under load stop early, the remainder stays banked for the next frames
+        if (settings.stepBudgetSeconds > 0.0 &&
+            std::chrono::duration<double>(Clock::now() - begin).count() > settings.stepBudgetSeconds)
+          break;
+      }
+
+      stats.steps = taken;
+      stats.deferredSteps = int(accumulator / h);
+      stats.stepSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+      if (taken > 0)
+      {
+        double perStep = stats.stepSeconds / double(taken);
+        stats.averageStepSeconds = stats.averageStepSeconds == 0.0 ? perStep : 0.9 * stats.averageStepSeconds + 0.1 * perStep;
+      }
+      simulatedSeconds += double(taken) * h;
+
+      return taken;
+    }
+
+    // how far rendering is between the previous and the current fixed state
+    float getAlpha() const
+    {
+      return float(std::clamp(accumulator / getStepSeconds(), 0.0, 1.0));
+    }
+
+    double getStepSeconds() const { return 1.0 / settings.stepRate; }
+    // seconds since construction on the high resolution clock
+    double getTime() const { return std::chrono::duration<double>(Clock::now() - start).count(); }
+    double getSimulatedSeconds() const { return simulatedSeconds; }
+    const SchedulerStats &getStats() const { return stats; }
+    const SchedulerSettings &getSettings() const { return settings; }
+
+  private:
+    SchedulerSettings settings;
+    SchedulerStats stats;
+
+    Clock::time_point start;
+    Clock::time_point lastFrame;
+    double accumulator = 0.0;
+    double simulatedSeconds = 0.0;
+  };
+}
+
+#endif
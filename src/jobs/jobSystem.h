@@ -0,0 +1,324 @@
+#ifndef JOBS_JOB_SYSTEM_H
+#define JOBS_JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace nsi
+{
+  class JobSystem;
+
+  // counts unfinished jobs of a group; jobs queued after it start once it reaches zero.
+  // It must outlive its jobs, wait on it before it goes out of scope
+  class JobCounter
+  {
+  public:
+    JobCounter() = default;
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    bool done() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return count == 0;
+    }
+
+  private:
+    friend class JobSystem;
+
+    mutable std::mutex mutex;
+    size_t count = 0;
+    // with the counter that counts each, if any
+    std::vector<std::pair<std::function<void()>, JobCounter *>> continuations;
+  };
+
+  // fixed pool of workers, each with its own deque: owners push/pop at the back,
+  // idle workers steal from the front of someone else's
+  class JobSystem
+  {
+  public:
+    using Job = std::function<void()>;
+
+    // 0 workers means defaultWorkerCount()
+    explicit JobSystem(int workerCount = 0)
+    {
+      if (workerCount <= 0)
+        workerCount = defaultWorkerCount();
+
+      for (int i = 0; i <= workerCount; i++)
+      {
+        queues.push_back(std::make_unique<WorkQueue>());
+      }
+
+      for (int i = 0; i < workerCount; i++)
+      {
+        threads.emplace_back([this, i]()
+                             { workerLoop(i + 1); });
+      }
+    }
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    ~JobSystem()
+    {
+      {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+      }
+      sleepCondition.notify_all();
+
+      for (std::thread &thread : threads)
+      {
+        thread.join();
+      }
+    }
+
+    // one per hardware thread, minus the caller which helps out while waiting; NSI_WORKERS
+    // pins it (total threads, caller included) for reproducible runs
+    static int defaultWorkerCount()
+    {
+      if (const char *pinned = std::getenv("NSI_WORKERS"))
+      {
+        int threads = std::atoi(pinned);
+        if (threads > 0)
+          return std::max(1, threads - 1);
+      }
+      return std::max(1, int(std::thread::hardware_concurrency()) - 1);
+    }
+
+    int workerCount() const { return int(threads.size()); }
+
+    // threads that execute jobs, including a waiting caller
+    int concurrency() const { return int(threads.size()) + 1; }
+
+    void submit(Job job)
+    {
+      push(std::move(job), nullptr);
+    }
+
+    // submits a job counted by counter
+    void submit(Job job, JobCounter &counter)
+    {
+      {
+        std::lock_guard<std::mutex> lock(counter.mutex);
+        counter.count++;
+      }
+      push(counted(std::move(job), &counter), &counter);
+    }
+
+    // runs job once dependency has drained; counter (optional) counts it from now on
+    void submitAfter(JobCounter &dependency, Job job, JobCounter *counter = nullptr)
+    {
+      if (counter)
+      {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        counter->count++;
+      }
+
+      Job wrapped = counted(std::move(job), counter);
+      {
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (dependency.count > 0)
+        {
+          dependency.continuations.push_back({std::move(wrapped), counter});
+          return;
+        }
+      }
+      push(std::move(wrapped), counter);
+    }
+
+    // helps out until every job counted by counter has finished. Only that counter's jobs
+    // are run here, so waiting never picks up some other group's long job
+    void wait(const JobCounter &counter)
+    {
+      while (!counter.done())
+      {
+        if (!runOne(currentQueue(), &counter))
+          std::this_thread::yield();
+      }
+    }
+
+    // calls fn(begin, end) over [0, count) in chunks of at most grain items and
+    // returns once every chunk has run; the calling thread works too
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn)
+    {
+      if (count == 0)
+        return;
+
+      grain = std::max<size_t>(1, grain);
+      size_t chunks = (count + grain - 1) / grain;
+      if (chunks == 1)
+      {
+        fn(0, count);
+        return;
+      }
+
+      JobCounter counter;
+      for (size_t c = 0; c < chunks; c++)
+      {
+        size_t begin = c * grain;
+        size_t end = std::min(count, begin + grain);
+        submit([&fn, begin, end]()
+               { fn(begin, end); },
+               counter);
+      }
+
+      wait(counter);
+    }
+
+  private:
+    struct Task
+    {
+      Job job;
+      // the counter that counts it, null for a job of its own
+      const JobCounter *group = nullptr;
+    };
+
+    struct WorkQueue
+    {
+      std::mutex mutex;
+      std::deque<Task> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::atomic<size_t> pending{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    bool stopping = false;
+
+    // queue 0 belongs to whichever outside thread submits
+    static int &threadQueueIndex()
+    {
+      static thread_local int index = 0;
+      return index;
+    }
+
+    size_t currentQueue() const
+    {
+      return size_t(threadQueueIndex()) < queues.size() ? size_t(threadQueueIndex()) : 0;
+    }
+
+    void push(Job job, const JobCounter *group)
+    {
+      WorkQueue &queue = *queues[currentQueue()];
+      {
+        // counted under the sleep lock so a worker about to block cannot miss it
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pending++;
+      }
+      {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({std::move(job), group});
+      }
+      sleepCondition.notify_one();
+    }
+
+    // the newest job, or with group the newest of that group
+    bool popLocal(size_t index, Job &job, const JobCounter *group)
+    {
+      WorkQueue &queue = *queues[index];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      for (auto it = queue.jobs.rbegin(); it != queue.jobs.rend(); ++it)
+      {
+        if (group && it->group != group)
+          continue;
+        job = std::move(it->job);
+        queue.jobs.erase(std::next(it).base());
+        return true;
+      }
+      return false;
+    }
+
+    // the oldest job of another queue, or with group the oldest of that group
+    bool steal(size_t thief, Job &job, const JobCounter *group)
+    {
+      for (size_t offset = 1; offset < queues.size(); offset++)
+      {
+        WorkQueue &queue = *queues[(thief + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (auto it = queue.jobs.begin(); it != queue.jobs.end(); ++it)
+        {
+          if (group && it->group != group)
+            continue;
+          job = std::move(it->job);
+          queue.jobs.erase(it);
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    Job counted(Job job, JobCounter *counter)
+    {
+      if (!counter)
+        return job;
+
+      return [this, job = std::move(job), counter]()
+      {
+        job();
+        finish(*counter);
+      };
+    }
+
+    // the last job of a group releases its continuations
+    void finish(JobCounter &counter)
+    {
+      std::vector<std::pair<Job, JobCounter *>> ready;
+      {
+        std::lock_guard<std::mutex> lock(counter.mutex);
+        if (--counter.count == 0)
+          ready.swap(counter.continuations);
+      }
+
+      for (auto &continuation : ready)
+      {
+        push(std::move(continuation.first), continuation.second);
+      }
+    }
+
+    // group limits it to the jobs one counter counts
+    bool runOne(size_t index, const JobCounter *group = nullptr)
+    {
+      Job job;
+      if (!popLocal(index, job, group) && !steal(index, job, group))
+        return false;
+
+      pending--;
+      job();
+      return true;
+    }
+
+    void workerLoop(int index)
+    {
+      threadQueueIndex() = index;
+
+      while (true)
+      {
+        if (runOne(size_t(index)))
+          continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCondition.wait(lock, [this]()
+                            { return stopping || pending.load() > 0; });
+        if (stopping)
+          return;
+      }
+    }
+  };
+}
+
+#endif
@@ -3,8 +3,10 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <vector>
 #include <string>
+#include <utility>
 
 struct Vertex
 {
@@ -20,90 +22,137 @@ struct Texture
   uint id;
   std::string type;
   std::string filePath;
+  // array textures are sampled at one layer, through rect: scale (xy) and offset (zw) of
+  // the texture inside that layer
+  uint target = GL_TEXTURE_2D;
+  int layer = 0;
+  glm::vec4 rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
 };
 
 namespace nsi
 {
+  // the maps a mesh's material has, one bit each; model shaders are built for exactly
+  // the set a mesh needs instead of branching on what is missing
+  enum MaterialFeature : unsigned
+  {
+    MATERIAL_DIFFUSE = 1u << 0,
+    MATERIAL_SPECULAR = 1u << 1,
+    MATERIAL_NORMAL = 1u << 2,
+    // not a map: the model's textures come from its bindless material block
+    MATERIAL_BINDLESS = 1u << 3,
+  };
+
+  // the define each MaterialFeature bit turns on, in bit order
+  inline std::vector<std::string> materialFeatureDefines()
+  {
+    return {"HAS_DIFFUSE_MAP", "HAS_SPECULAR_MAP", "HAS_NORMAL_MAP", "BINDLESS_MATERIALS"};
+  }
+
+  // texture names bound per unit over the meshes of one draw, so meshes sharing a texture
+  // array do not bind it again
+  struct TextureBindings
+  {
+    std::vector<uint> ids;
+    // set when a bindless material block is bound: meshes then only select their material
+    GLint materialLocation = -1;
+
+    // false when id is already on unit, otherwise records it
+    bool needsBind(uint unit, uint id)
+    {
+      if (ids.size() <= unit)
+        ids.resize(unit + 1, 0);
+      if (ids[unit] == id)
+        return false;
+      ids[unit] = id;
+      return true;
+    }
+  };
+
   class Mesh
   {
   public:
     std::vector<Vertex> vertices;
     std::vector<uint> indices;
     std::vector<Texture> textures;
+    // into the model's bindless material block, -1 without one
+    int material = -1;
 
     Mesh(const std::vector<Vertex> &vertices, const std::vector<uint> &indices, const std::vector<Texture> &textures) : vertices(vertices), indices(indices), textures(textures)
     {
+      features = materialFeatures(this->textures);
       setupMesh();
     }
 
-    ~Mesh()
+    // deferred meshes own no GL objects yet: uploadBuffers() may then run on any context
+    // sharing with the renderer, createVertexArray() on the render thread
+    Mesh(std::vector<Vertex> &&vertices, std::vector<uint> &&indices, std::vector<Texture> &&textures, bool deferred = false)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
     {
-      glDeleteVertexArrays(1, &VAO);
-      glDeleteBuffers(1, &VBO);
-      glDeleteBuffers(1, &EBO);
+      features = materialFeatures(this->textures);
+      if (!deferred)
+        setupMesh();
     }
 
-    void draw(Shader &shader)
-    {
-      uint diffuseNr = 1;
-      uint specularNr = 1;
-      uint normalNr = 1;
-      uint heightNr = 1;
+    // owns GL objects, so moves hand them over and copies are not allowed
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
 
-      for (uint i = 0; i < textures.size(); i++)
+    Mesh(Mesh &&other) noexcept
+        : vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures)), material(other.material),
+          features(other.features), VAO(std::exchange(other.VAO, 0)), VBO(std::exchange(other.VBO, 0)), EBO(std::exchange(other.EBO, 0)) {}
+
+    Mesh &operator=(Mesh &&other) noexcept
+    {
+      if (this != &other)
       {
-        glActiveTexture(GL_TEXTURE0 + i);
+        release();
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        textures = std::move(other.textures);
+        material = other.material;
+        features = other.features;
+        VAO = std::exchange(other.VAO, 0);
+        VBO = std::exchange(other.VBO, 0);
+        EBO = std::exchange(other.EBO, 0);
+      }
+      return *this;
+    }
 
-        std::string number;
-        std::string name = textures[i].type;
+    ~Mesh()
+    {
+      release();
+    }
 
-        if (name == "texture_diffuse")
-        {
-          number = std::to_string(diffuseNr++);
-        }
-        else if (name == "texture_specular")
-        {
-          number = std::to_string(specularNr++);
-        }
-        else if (name == "texture_normal")
-        {
-          number = std::to_string(normalNr++);
-        }
-        else if (name == "texture_height")
-        {
-          number = std::to_string(heightNr++);
-        }
+    // buffers uploaded and bound to a vertex array on the render context
+    bool isReady() const { return VAO != 0; }
 
-        std::string uniformName = name + number;
-        glUniform1i(glGetUniformLocation(shader.ID, uniformName.c_str()), i);
+    // MaterialFeature bits of the textures that loaded
+    unsigned getFeatures() const { return features; }
 
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
-      }
+    void uploadBuffers()
+    {
+      glGenBuffers(1, &VBO);
+      glGenBuffers(1, &EBO);
 
-      glBindVertexArray(VAO);
-      glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-      // reset to default
-      glActiveTexture(GL_TEXTURE0);
+      // the element binding is vertex array state, bind it through GL_COPY_WRITE_BUFFER so
+      // no vertex array of this context is touched
+      glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+      glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(uint), indices.data(), GL_STATIC_DRAW);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
     }
 
-  private:
-    uint VAO, VBO, EBO;
-
-    void setupMesh()
+    // vertex arrays are not shared between contexts, so this runs where the mesh is drawn
+    void createVertexArray()
     {
       glGenVertexArrays(1, &VAO);
-      glGenBuffers(1, &VBO);
-      glGenBuffers(1, &EBO);
-
       glBindVertexArray(VAO);
 
       glBindBuffer(GL_ARRAY_BUFFER, VBO);
-      glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint), &indices[0], GL_STATIC_DRAW);
 
       // position attribute
       glEnableVertexAttribArray(0);
@@ -127,6 +176,172 @@ namespace nsi
 
       glBindVertexArray(0);
     }
+
+    void draw(Shader &shader, TextureBindings *bindings = nullptr)
+    {
+      if (!isReady())
+        return;
+
+      bool bound = useTextures(shader, bindings);
+
+      glBindVertexArray(VAO);
+      glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+      glBindVertexArray(0);
+
+      // reset to default
+      if (bound)
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // one draw for count copies, each with its own matrix from the instance attributes
+    void drawInstanced(Shader &shader, GLsizei count, TextureBindings *bindings = nullptr)
+    {
+      if (!isReady() || count == 0)
+        return;
+
+      bool bound = useTextures(shader, bindings);
+
+      glBindVertexArray(VAO);
+      glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0, count);
+      glBindVertexArray(0);
+
+      if (bound)
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // per-instance mat4 at attributes 5..8, read from buffer starting at offset
+    void bindInstanceAttributes(GLuint buffer, size_t offset)
+    {
+      glBindVertexArray(VAO);
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+      for (int column = 0; column < 4; column++)
+      {
+        glEnableVertexAttribArray(5 + column);
+        glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(5 + column, 1);
+      }
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // sphere (center, radius) around the vertices, in mesh space
+    glm::vec4 boundingSphere() const
+    {
+      if (vertices.empty())
+        return glm::vec4(0.0f);
+
+      glm::vec3 boundsMin = vertices[0].position;
+      glm::vec3 boundsMax = vertices[0].position;
+      for (const Vertex &vertex : vertices)
+      {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+      }
+
+      glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+      float radius = 0.0f;
+      for (const Vertex &vertex : vertices)
+      {
+        radius = std::max(radius, glm::length(vertex.position - center));
+      }
+      return glm::vec4(center, radius);
+    }
+
+  private:
+    unsigned features = 0;
+    uint VAO = 0, VBO = 0, EBO = 0;
+
+    static unsigned materialFeatures(const std::vector<Texture> &textures)
+    {
+      unsigned features = 0;
+      for (const Texture &texture : textures)
+      {
+        if (texture.id == 0)
+          continue;
+        if (texture.type == "texture_diffuse")
+          features |= MATERIAL_DIFFUSE;
+        else if (texture.type == "texture_specular")
+          features |= MATERIAL_SPECULAR;
+        else if (texture.type == "texture_normal")
+          features |= MATERIAL_NORMAL;
+      }
+      return features;
+    }
+
+    void release()
+    {
+      if (VAO)
+        glDeleteVertexArrays(1, &VAO);
+      if (VBO)
+        glDeleteBuffers(1, &VBO);
+      if (EBO)
+        glDeleteBuffers(1, &EBO);
+      VAO = VBO = EBO = 0;
+    }
+
+    // false when the bindless material was selected and no texture unit was touched
+    bool useTextures(Shader &shader, TextureBindings *bindings)
+    {
+      if (bindings && bindings->materialLocation >= 0 && material >= 0)
+      {
+        glUniform1i(bindings->materialLocation, material);
+        return false;
+      }
+      bindTextures(shader, bindings);
+      return true;
+    }
+
+    void bindTextures(Shader &shader, TextureBindings *bindings)
+    {
+      uint diffuseNr = 1;
+      uint specularNr = 1;
+      uint normalNr = 1;
+      uint heightNr = 1;
+
+      for (uint i = 0; i < textures.size(); i++)
+      {
+        std::string number;
+        std::string name = textures[i].type;
+
+        if (name == "texture_diffuse")
+        {
+          number = std::to_string(diffuseNr++);
+        }
+        else if (name == "texture_specular")
+        {
+          number = std::to_string(specularNr++);
+        }
+        else if (name == "texture_normal")
+        {
+          number = std::to_string(normalNr++);
+        }
+        else if (name == "texture_height")
+        {
+          number = std::to_string(heightNr++);
+        }
+
+        std::string uniformName = name + number;
+        const Texture &texture = textures[i];
+        if (!bindings || bindings->needsBind(i, texture.id))
+        {
+          glActiveTexture(GL_TEXTURE0 + i);
+          glUniform1i(glGetUniformLocation(shader.ID, uniformName.c_str()), i);
+          glBindTexture(texture.target, texture.id);
+        }
+
+        if (texture.target == GL_TEXTURE_2D_ARRAY)
+        {
+          glUniform1f(glGetUniformLocation(shader.ID, (uniformName + "_layer").c_str()), float(texture.layer));
+          glUniform4f(glGetUniformLocation(shader.ID, (uniformName + "_rect").c_str()), texture.rect.x, texture.rect.y, texture.rect.z, texture.rect.w);
+        }
+      }
+    }
+
+    void setupMesh()
+    {
+      uploadBuffers();
+      createVertexArray();
+    }
   };
 }
 
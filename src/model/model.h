@@ -4,6 +4,8 @@
 #include <glm/glm.hpp>
 #include <string>
 
+#include "../render/shaderManager.h"
+
 namespace nsi
 {
   class Model
@@ -24,6 +26,16 @@ namespace nsi
 
     virtual ~Model() = default;
     virtual void draw(Shader &shader) = 0;
+    // with a shader built per material; models without materials take the variant
+    // without features
+    virtual void draw(ShaderVariants &variants)
+    {
+      if (Shader *shader = variants.use(0))
+        draw(*shader);
+    }
+    // per-frame work on the render thread before draw (culling, uploads); camera and
+    // matrices are in world space, transform is the model matrix captured for the frame
+    virtual void prepare(const glm::mat4 &transform, const glm::vec3 &cameraPosition, const glm::vec3 &cameraFront, const glm::mat4 &viewProjection) {}
     // virtual void update(float deltaTime) = 0;
 
     // getters
@@ -0,0 +1,180 @@
+#ifndef INSTANCE_SET_H
+#define INSTANCE_SET_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../../camera/frustum.h"
+#include "../../jobs/jobSystem.h"
+
+namespace nsi
+{
+  struct InstanceStats
+  {
+    size_t instances = 0;
+    size_t visible = 0;
+    // visible instances that did not fit the output
+    size_t overflow = 0;
+  };
+
+  // transforms of many copies of one model with a bounding sphere each; every frame the
+  // visible ones are compacted, in their original order, into a flat matrix array
+  class InstanceSet
+  {
+  public:
+    void add(const glm::mat4 &transform)
+    {
+      transforms.push_back(transform);
+      spheres.push_back(boundingSphere(transform));
+    }
+
+    void clear()
+    {
+      transforms.clear();
+      spheres.clear();
+    }
+
+    void reserve(size_t count)
+    {
+      transforms.reserve(count);
+      spheres.reserve(count);
+    }
+
+    size_t size() const { return transforms.size(); }
+    const std::vector<glm::mat4> &getTransforms() const { return transforms; }
+
+    // model-space sphere around the mesh; recomputes every instance's bounds
+    void setLocalBounds(const glm::vec4 &sphere)
+    {
+      localBounds = sphere;
+      for (size_t i = 0; i < transforms.size(); i++)
+      {
+        spheres[i] = boundingSphere(transforms[i]);
+      }
+    }
+
+    // writes the matrices of instances touching the frustum to out (at most capacity) and
+    // returns how many were written. Culling and compaction are split over the job system
+    // in chunks of grain: count per chunk, prefix sum, then each chunk copies to its offset.
+    // Each chunk also finds its visible instance nearest to viewer, see nearestVisible
+    size_t cull(const Frustum &frustum, const glm::vec3 &viewer, glm::mat4 *out, size_t capacity, JobSystem *jobs = nullptr, size_t grain = 4096)
+    {
+      size_t count = transforms.size();
+      size_t chunks = (count + grain - 1) / grain;
+      visible.resize(count);
+      chunkOffsets.assign(chunks + 1, 0);
+      chunkNearest.assign(chunks, count);
+      chunkNearestDistance.resize(chunks);
+
+      auto test = [&](size_t begin, size_t end)
+      {
+        for (size_t c = begin; c < end; c++)
+        {
+          size_t first = c * grain;
+          size_t last = std::min(count, first + grain);
+          size_t hits = 0;
+          size_t nearest = count;
+          float nearestDistance = 0.0f;
+          for (size_t i = first; i < last; i++)
+          {
+            bool inside = frustum.intersects(glm::vec3(spheres[i]), spheres[i].w);
+            visible[i] = inside ? 1 : 0;
+            if (!inside)
+              continue;
+            hits++;
+
+            float distance = glm::length(glm::vec3(spheres[i]) - viewer) - spheres[i].w;
+            if (nearest == count || distance < nearestDistance)
+            {
+              nearest = i;
+              nearestDistance = distance;
+            }
+          }
+          chunkOffsets[c + 1] = hits;
+          chunkNearest[c] = nearest;
+          chunkNearestDistance[c] = nearestDistance;
+        }
+      };
+
+      auto compact = [&](size_t begin, size_t end)
+      {
+        for (size_t c = begin; c < end; c++)
+        {
+          size_t first = c * grain;
+          size_t last = std::min(count, first + grain);
+          size_t offset = chunkOffsets[c];
+          for (size_t i = first; i < last && offset < capacity; i++)
+          {
+            if (visible[i])
+              out[offset++] = transforms[i];
+          }
+        }
+      };
+
+      if (jobs)
+        jobs->parallelFor(chunks, 1, test);
+      else
+        test(0, chunks);
+
+      // chunks are few, their results are reduced here
+      nearest = count;
+      float nearestDistance = 0.0f;
+      for (size_t c = 0; c < chunks; c++)
+      {
+        chunkOffsets[c + 1] += chunkOffsets[c];
+        if (chunkNearest[c] < count && (nearest == count || chunkNearestDistance[c] < nearestDistance))
+        {
+          nearest = chunkNearest[c];
+          nearestDistance = chunkNearestDistance[c];
+        }
+      }
+
+      if (jobs)
+        jobs->parallelFor(chunks, 1, compact);
+      else
+        compact(0, chunks);
+
+      size_t total = chunkOffsets[chunks];
+      stats.instances = count;
+      stats.visible = std::min(total, capacity);
+      stats.overflow = total - stats.visible;
+      return stats.visible;
+    }
+
+    // index of the instance the last cull found visible whose bounds come closest to its
+    // viewer, size() when none was
+    size_t nearestVisible() const { return nearest; }
+
+    const InstanceStats &getStats() const { return stats; }
+
+  private:
+    std::vector<glm::mat4> transforms;
+    // world-space (center, radius) per instance
+    std::vector<glm::vec4> spheres;
+    glm::vec4 localBounds = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    std::vector<uint8_t> visible;
+    std::vector<size_t> chunkOffsets;
+    std::vector<size_t> chunkNearest;
+    std::vector<float> chunkNearestDistance;
+    size_t nearest = 0;
+    InstanceStats stats;
+
+    glm::vec4 boundingSphere(const glm::mat4 &transform) const
+    {
+      glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(localBounds), 1.0f));
+      // the largest axis scale bounds any rotation and non-uniform scale
+      float scale = std::sqrt(std::max({glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                                        glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                                        glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))}));
+      return glm::vec4(center, localBounds.w * scale);
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef INSTANCED_MODEL_H
+#define INSTANCED_MODEL_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../../assimpModel/AssimpModel.h"
+#include "../../camera/frustum.h"
+#include "../../render/drawData.h"
+#include "../../render/streamBuffer.h"
+#include "instanceSet.h"
+
+namespace nsi
+{
+  // one imported model drawn many times: every frame the instances in view are culled and
+  // compacted straight into a streamed instance buffer, then each mesh is one
+  // glDrawElementsInstanced. Shaders take the instance matrix at attributes 5..8 and the
+  // model matrix from the frame's draw record
+  class InstancedModel : public Model
+  {
+  public:
+    InstancedModel(const std::string &filePath, JobSystem *jobs = nullptr, UploadThread *uploader = nullptr, size_t maxVisible = 131072)
+        : Model(filePath), source(filePath, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f), jobs, uploader), jobs(jobs), maxVisible(maxVisible) {}
+
+    ~InstancedModel() override = default;
+
+    // fill before the model is first rendered, the render thread reads it afterwards
+    InstanceSet &getInstances() { return instances; }
+
+    // shared per-frame records, begun and committed around prepare by their owner. Without
+    // them the shaders get the model matrix as a uniform
+    void setDrawData(DrawDataBuffer *buffer) { drawData = buffer; }
+
+    void prepare(const glm::mat4 &transform, const glm::vec3 &cameraPosition, const glm::vec3 &cameraFront, const glm::mat4 &viewProjection) override
+    {
+      if (instanceBuffer.getBuffer() == 0)
+        instanceBuffer.init(GL_ARRAY_BUFFER, maxVisible * sizeof(glm::mat4));
+
+      updateBounds();
+
+      // instances are in model space, so are the frustum and the camera
+      Frustum frustum(viewProjection * transform);
+      glm::vec3 localCamera = glm::vec3(glm::inverse(transform) * glm::vec4(cameraPosition, 1.0f));
+      glm::mat4 *out = reinterpret_cast<glm::mat4 *>(instanceBuffer.beginFrame());
+      visibleCount = instances.cull(frustum, localCamera, out, maxVisible, jobs);
+      instanceBuffer.commit(visibleCount * sizeof(glm::mat4));
+
+      drawId = -1;
+      if (drawData)
+      {
+        DrawRecord record;
+        record.model = transform;
+        drawId = drawData->push(record);
+      }
+
+      // the closest copy decides how much texture detail all of them get
+      if (visibleCount > 0 && TextureStreamer::get().isEnabled())
+      {
+        size_t nearest = instances.nearestVisible();
+        if (nearest < instances.size())
+          source.requestTextures(transform * instances.getTransforms()[nearest], cameraPosition);
+      }
+      prepared = true;
+    }
+
+    void draw(Shader &shader) override
+    {
+      if (!prepared)
+        return;
+
+      bindDrawRecord(shader);
+      TextureBindings bindings;
+      source.bindMaterials(shader, bindings);
+      for (Mesh &mesh : source.getMeshes())
+      {
+        mesh.bindInstanceAttributes(instanceBuffer.getBuffer(), instanceBuffer.getFrameOffset());
+        mesh.drawInstanced(shader, GLsizei(visibleCount), &bindings);
+      }
+
+      instanceBuffer.endFrame();
+      prepared = false;
+    }
+
+    void draw(ShaderVariants &variants) override
+    {
+      if (!prepared)
+        return;
+
+      Shader *bound = nullptr;
+      source.drawMeshes(variants, [&](Mesh &mesh, Shader &shader, TextureBindings &bindings)
+                        {
+                          if (&shader != bound)
+                          {
+                            bindDrawRecord(shader);
+                            bound = &shader;
+                          }
+                          mesh.bindInstanceAttributes(instanceBuffer.getBuffer(), instanceBuffer.getFrameOffset());
+                          mesh.drawInstanced(shader, GLsizei(visibleCount), &bindings); });
+
+      instanceBuffer.endFrame();
+      prepared = false;
+    }
+
+    const InstanceStats &getStats() const { return instances.getStats(); }
+
+  private:
+    AssimpModel source;
+    InstanceSet instances;
+    StreamBuffer instanceBuffer;
+    JobSystem *jobs = nullptr;
+    size_t maxVisible = 0;
+
+    // above the material units
+    static constexpr int DRAW_DATA_UNIT = 15;
+    DrawDataBuffer *drawData = nullptr;
+    int drawId = -1;
+
+    size_t visibleCount = 0;
+    size_t boundedMeshes = 0;
+    bool prepared = false;
+
+    // -1 sends the shader to the model uniform
+    void bindDrawRecord(Shader &shader)
+    {
+      if (drawId >= 0)
+        drawData->bind(shader, DRAW_DATA_UNIT);
+      shader.setInt("drawId", drawId);
+    }
+
+    // meshes show up once uploaded, the instance bounds follow them
+    void updateBounds()
+    {
+      std::vector<Mesh> &meshes = source.getMeshes();
+      if (meshes.size() == boundedMeshes)
+        return;
+      boundedMeshes = meshes.size();
+
+      glm::vec3 boundsMin(std::numeric_limits<float>::max());
+      glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+      std::vector<glm::vec4> spheres;
+      for (const Mesh &mesh : meshes)
+      {
+        glm::vec4 sphere = mesh.boundingSphere();
+        spheres.push_back(sphere);
+        boundsMin = glm::min(boundsMin, glm::vec3(sphere) - sphere.w);
+        boundsMax = glm::max(boundsMax, glm::vec3(sphere) + sphere.w);
+      }
+
+      glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+      float radius = 0.0f;
+      for (const glm::vec4 &sphere : spheres)
+      {
+        radius = std::max(radius, glm::length(glm::vec3(sphere) - center) + sphere.w);
+      }
+      instances.setLocalBounds(glm::vec4(center, radius));
+    }
+  };
+}
+
+#endif
@@ -3,23 +3,213 @@
 
 #include <glm/glm.hpp>
 
-#include "../../assimpModel/AssimpModel.h"
+#include <bit>
+#include <memory>
+#include <vector>
+
+#include "../../model/model.h"
+#include "../../camera/frustum.h"
+#include "../../render/drawData.h"
+#include "../../terrain/heightSource.h"
+#include "../../terrain/cdlodQuadtree.h"
+#include "../../terrain/chunkStreamer.h"
+#include "../../terrain/clipmap.h"
+#include "../../terrain/patchMesh.h"
 
 namespace nsi
 {
-  class World : public AssimpModel
+  enum class TerrainMode
+  {
+    // quadtree of streamed chunks
+    CDLOD,
+    // nested rings around the camera
+    CLIPMAP
+  };
+
+  struct TerrainStats
+  {
+    size_t selectedNodes = 0;
+    size_t triangles = 0;
+    size_t drawCalls = 0;
+    StreamingStats streaming;
+    ClipmapStats clipmap;
+  };
+
+  // chunked heightfield terrain: a quadtree of fixed-size patches drawn with CDLOD, or
+  // geometry clipmaps as a fixed-cost alternative
+  class World : public Model
   {
   public:
-    World(const std::string &filePath) : AssimpModel(filePath) {};
-    World(const std::string &filePath, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale) : AssimpModel(filePath, position, rotation, scale) {};
+    World(const std::string &filePath, TerrainSettings settings = TerrainSettings())
+        : World(filePath, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f), settings) {};
+
+    World(const std::string &filePath, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, TerrainSettings settings = TerrainSettings())
+        : World(std::make_unique<MeshHeightSource>(filePath), position, rotation, scale, settings)
+    {
+      this->filePath = filePath;
+    };
+
+    // chunks are built as jobs on jobs when given
+    World(std::unique_ptr<HeightSource> source, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, TerrainSettings settings = TerrainSettings(), JobSystem *jobs = nullptr)
+        : Model("", position, rotation, scale), settings(settings), heightSource(std::move(source)), quadtree(settings)
+    {
+      chunks = std::make_unique<ChunkStreamer>(*heightSource, quadtree, settings, jobs);
+      chunks->load(quadtree.rootKey(), 0);
+      patch.init(settings.gridSize);
+    };
+
     ~World() override = default;
+
+    // the clipmap is only built the first time it is switched on
+    void setMode(TerrainMode mode)
+    {
+      if (mode == TerrainMode::CLIPMAP && !clipmapReady)
+      {
+        clipmap.init(*heightSource, clipmapSettings);
+        clipmapReady = true;
+      }
+      this->mode = mode;
+    }
+
+    TerrainMode getMode() const { return mode; }
+
+    // takes effect if set before the clipmap is first used
+    void setClipmapSettings(const ClipmapSettings &settings) { clipmapSettings = settings; }
+
+    // shared per-frame records; whoever owns them begins, commits and ends the frame around
+    // prepare/draw. Without one the world keeps its own
+    void setDrawData(DrawDataBuffer *buffer) { sharedDrawData = buffer; }
+
+    // picks the patches to draw for this frame and drives streaming
+    void prepare(const glm::mat4 &transform, const glm::vec3 &cameraPosition, const glm::vec3 &cameraFront, const glm::mat4 &viewProjection) override
+    {
+      frame++;
+
+      glm::mat4 model = transform;
+      glm::mat4 toLocal = glm::inverse(model);
+      localCamera = glm::vec3(toLocal * glm::vec4(cameraPosition, 1.0f));
+
+      // node placement and morph ranges (levels for the clipmap) go to the draw records
+      // instead of uniforms
+      DrawDataBuffer &records = drawData();
+      if (!sharedDrawData)
+        records.beginFrame();
+
+      if (mode == TerrainMode::CLIPMAP)
+      {
+        clipmap.update(localCamera);
+        clipmap.pushRecords(model, records);
+        if (!sharedDrawData)
+          records.commit();
+        return;
+      }
+
+      glm::vec3 localFront = glm::vec3(toLocal * glm::vec4(cameraFront, 0.0f));
+
+      chunks->beginFrame(localCamera, localFront, frame);
+
+      Frustum frustum(viewProjection * model);
+      quadtree.select(localCamera, frustum, *chunks, selection);
+
+      chunks->update(frame);
+
+      nodeDrawIds.clear();
+      for (const SelectedNode &node : selection)
+      {
+        DrawRecord record;
+        record.model = model;
+        record.params[0] = glm::vec4(node.origin, node.size, 0.0f);
+        record.params[1] = glm::vec4(node.morphRange, 0.0f, 0.0f);
+        nodeDrawIds.push_back(records.push(record));
+      }
+
+      if (!sharedDrawData)
+        records.commit();
+    }
+
     void draw(Shader &shader) override
     {
+      stats = TerrainStats();
+
+      if (mode == TerrainMode::CLIPMAP)
+      {
+        clipmap.draw(shader, drawData());
+        if (!sharedDrawData)
+          drawData().endFrame();
+        stats.clipmap = clipmap.getStats();
+        stats.drawCalls = stats.clipmap.drawCalls;
+        stats.triangles = stats.clipmap.triangles;
+        return;
+      }
+
+      stats.selectedNodes = selection.size();
+      shader.setVec3("cameraPosition", localCamera);
+      shader.setFloat("gridSize", float(settings.gridSize));
+      shader.setInt("heightNormalMap", 0);
+
+      DrawDataBuffer &records = drawData();
+      records.bind(shader, 1);
+      // looked up once, it changes for every node
+      GLint drawIdLocation = glGetUniformLocation(shader.ID, "drawId");
+
+      glActiveTexture(GL_TEXTURE0);
+      for (size_t i = 0; i < selection.size(); i++)
+      {
+        const SelectedNode &node = selection[i];
+        const TerrainChunk *chunk = chunks->find(node.key);
+        if (!chunk || i >= nodeDrawIds.size() || nodeDrawIds[i] < 0)
+          continue;
+
+        glUniform1i(drawIdLocation, nodeDrawIds[i]);
+        glBindTexture(GL_TEXTURE_2D, chunk->texture);
+
+        stats.drawCalls += patch.drawQuadrants(node.quadrantMask);
+        stats.triangles += size_t(patch.trianglesPerQuadrant()) * std::popcount(node.quadrantMask);
+      }
+      glBindTexture(GL_TEXTURE_2D, 0);
+
+      if (!sharedDrawData)
+        records.endFrame();
+
+      stats.streaming = chunks->getStats();
+    }
+
+    const TerrainStats &getStats() const { return stats; }
+    const TerrainSettings &getSettings() const { return settings; }
+    const HeightSource &getHeightSource() const { return *heightSource; }
+
+  private:
+    TerrainSettings settings;
+    std::unique_ptr<HeightSource> heightSource;
+    CdlodQuadtree quadtree;
+    std::unique_ptr<ChunkStreamer> chunks;
+    PatchMesh patch;
+
+    TerrainMode mode = TerrainMode::CDLOD;
+    ClipmapSettings clipmapSettings;
+    ClipmapTerrain clipmap;
+    bool clipmapReady = false;
+
+    DrawDataBuffer *sharedDrawData = nullptr;
+    DrawDataBuffer ownDrawData;
+    std::vector<int> nodeDrawIds;
+
+    std::vector<SelectedNode> selection;
+    glm::vec3 localCamera = glm::vec3(0.0f);
+    uint64_t frame = 0;
+    TerrainStats stats;
+
+    DrawDataBuffer &drawData()
+    {
+      if (sharedDrawData)
+        return *sharedDrawData;
 
-      printf("World Class: Draw()\n");
-      AssimpModel::draw(shader);
+      // created on first use, on the thread that renders
+      if (!ownDrawData.isReady())
+        ownDrawData.init(4096);
+      return ownDrawData;
     }
   };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,214 @@
+#ifndef PHYSICS_CHARACTER_PHYSICS_H
+#define PHYSICS_CHARACTER_PHYSICS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "terrainCollider.h"
+
+namespace nsi
+{
+  struct CharacterSettings
+  {
+    float gravity = -9.81f;
+    // steeper ground cannot be walked up and makes the body slide
+    float maxSlopeDegrees = 45.0f;
+    // ledges up to this height are climbed regardless of slope
+    float stepHeight = 0.4f;
+    // horizontal speed lost per second while grounded and not sliding
+    float groundFriction = 8.0f;
+  };
+
+  // a point on the ground (feet), moved by the user and by gravity
+  struct CharacterBody
+  {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+    // displacement requested by input for the next step
+    glm::vec3 move = glm::vec3(0.0f);
+    bool grounded = false;
+    bool flying = false;
+  };
+
+  class CharacterPhysics
+  {
+  public:
+    CharacterPhysics(const CharacterSettings &settings = CharacterSettings()) : settings(settings)
+    {
+      minGroundNormalY = std::cos(glm::radians(settings.maxSlopeDegrees));
+    }
+
+    const CharacterSettings &getSettings() const { return settings; }
+
+    // one fixed step for one body; without terrain the ground is the y = 0 plane
+    void step(CharacterBody &body, const TerrainCollider *terrain, float h) const
+    {
+      auto groundAt = [terrain](float x, float z)
+      { return terrain ? terrain->height(x, z) : 0.0f; };
+      auto normalAt = [terrain](float x, float z)
+      { return terrain ? terrain->normal(x, z) : glm::vec3(0.0f, 1.0f, 0.0f); };
+
+      if (body.flying)
+      {
+        body.position += body.move;
+        body.move = glm::vec3(0.0f);
+        body.position.y = std::max(body.position.y, groundAt(body.position.x, body.position.z));
+        return;
+      }
+
+      float groundNow = groundAt(body.position.x, body.position.z);
+      glm::vec2 move(body.move.x, body.move.z);
+      body.move = glm::vec3(0.0f);
+
+      glm::vec2 target = glm::vec2(body.position.x, body.position.z) + move;
+      float groundNext = groundAt(target.x, target.y);
+      bool blocked = resolveMove(body, move, target, groundNow, groundNext, normalAt(target.x, target.y));
+
+      float ground = blocked ? groundAt(body.position.x, body.position.z) : groundNext;
+      integrateVertical(body, ground, normalAt(body.position.x, body.position.z), h);
+    }
+
+    // one fixed step for many bodies; every ground and normal lookup is a batched query
+    // so the heightfield sampling vectorises
+    void stepBodies(std::vector<CharacterBody> &bodies, const TerrainCollider &terrain, float h)
+    {
+      size_t count = bodies.size();
+      for (std::vector<float> *scratch : {&xs, &zs, &offsetXs, &offsetZs, &ground, &next, &left, &right, &back, &front})
+      {
+        scratch->resize(count);
+      }
+
+      // ground under each body before and after its move
+      for (size_t i = 0; i < count; i++)
+      {
+        xs[i] = bodies[i].position.x;
+        zs[i] = bodies[i].position.z;
+        offsetXs[i] = xs[i] + bodies[i].move.x;
+        offsetZs[i] = zs[i] + bodies[i].move.z;
+      }
+      terrain.heights(xs.data(), zs.data(), ground.data(), count);
+      terrain.heights(offsetXs.data(), offsetZs.data(), next.data(), count);
+
+      for (size_t i = 0; i < count; i++)
+      {
+        CharacterBody &body = bodies[i];
+        glm::vec2 move(body.move.x, body.move.z);
+        body.move = glm::vec3(0.0f);
+
+        // the slope only matters when the climb is too high for a plain step
+        bool climb = body.grounded && next[i] - ground[i] > settings.stepHeight;
+        glm::vec3 normal = climb ? terrain.normal(offsetXs[i], offsetZs[i]) : glm::vec3(0.0f, 1.0f, 0.0f);
+        resolveMove(body, move, glm::vec2(offsetXs[i], offsetZs[i]), ground[i], next[i], normal);
+
+        xs[i] = body.position.x;
+        zs[i] = body.position.z;
+      }
+
+      // ground and central difference normals at the resolved positions
+      float d = terrain.getSpacing();
+      terrain.heights(xs.data(), zs.data(), ground.data(), count);
+
+      for (size_t i = 0; i < count; i++)
+        offsetXs[i] = xs[i] - d;
+      terrain.heights(offsetXs.data(), zs.data(), left.data(), count);
+      for (size_t i = 0; i < count; i++)
+        offsetXs[i] = xs[i] + d;
+      terrain.heights(offsetXs.data(), zs.data(), right.data(), count);
+      for (size_t i = 0; i < count; i++)
+        offsetZs[i] = zs[i] - d;
+      terrain.heights(xs.data(), offsetZs.data(), back.data(), count);
+      for (size_t i = 0; i < count; i++)
+        offsetZs[i] = zs[i] + d;
+      terrain.heights(xs.data(), offsetZs.data(), front.data(), count);
+
+      for (size_t i = 0; i < count; i++)
+      {
+        glm::vec3 normal = glm::normalize(glm::vec3(left[i] - right[i], 2.0f * d, back[i] - front[i]));
+        integrateVertical(bodies[i], ground[i], normal, h);
+      }
+    }
+
+  private:
+    CharacterSettings settings;
+    float minGroundNormalY;
+
+    // scratch for stepBodies
+    std::vector<float> xs, zs, offsetXs, offsetZs, ground, next, left, right, back, front;
+
+    // applies the horizontal move, blocking the uphill part on slopes that are too steep
+    // to walk and too high to step onto; returns true when the body did not reach target
+    bool resolveMove(CharacterBody &body, glm::vec2 move, glm::vec2 target, float groundNow, float groundNext, const glm::vec3 &normal) const
+    {
+      float rise = groundNext - groundNow;
+
+      if (body.grounded && rise > settings.stepHeight && normal.y < minGroundNormalY)
+      {
+        glm::vec2 downhill(normal.x, normal.z);
+        float length = glm::length(downhill);
+        if (length > 1e-6f)
+        {
+          // keep only the part of the move along the slope's contour
+          glm::vec2 uphill = -downhill / length;
+          move -= uphill * std::max(glm::dot(move, uphill), 0.0f);
+        }
+        else
+        {
+          move = glm::vec2(0.0f);
+        }
+
+        body.position.x += move.x;
+        body.position.z += move.y;
+        return true;
+      }
+
+      body.position.x = target.x;
+      body.position.z = target.y;
+      return false;
+    }
+
+    void integrateVertical(CharacterBody &body, float ground, const glm::vec3 &normal, float h) const
+    {
+      body.velocity.y += settings.gravity * h;
+      body.position.y += body.velocity.y * h;
+
+      bool steep = normal.y < minGroundNormalY;
+
+      // stay glued to the ground going down small steps, unless jumping
+      bool snap = body.grounded && body.velocity.y <= 0.0f && body.position.y - ground <= settings.stepHeight;
+
+      if (body.position.y <= ground || snap)
+      {
+        body.position.y = ground;
+        body.velocity.y = 0.0f;
+        body.grounded = true;
+
+        if (steep)
+        {
+          // gravity along the surface pulls the body downhill
+          glm::vec3 g(0.0f, settings.gravity, 0.0f);
+          glm::vec3 along = g - normal * glm::dot(g, normal);
+          body.velocity.x += along.x * h;
+          body.velocity.z += along.z * h;
+        }
+        else
+        {
+          float damping = std::max(0.0f, 1.0f - settings.groundFriction * h);
+          body.velocity.x *= damping;
+          body.velocity.z *= damping;
+        }
+      }
+      else
+      {
+        body.grounded = false;
+      }
+
+      body.position.x += body.velocity.x * h;
+      body.position.z += body.velocity.z * h;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef PHYSICS_TERRAIN_COLLIDER_H
+#define PHYSICS_TERRAIN_COLLIDER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+
+#include "../jobs/jobSystem.h"
+#include "../terrain/heightfield.h"
+#include "../terrain/heightSource.h"
+#include "../terrain/noise.h"
+
+namespace nsi
+{
+  // ground queries against a heightfield tile cached around a focus point; the tile is
+  // resampled from the height source (batched rows) whenever the focus drifts too far.
+  // With a job system the new tile is built on a job and swapped in by a later focus,
+  // queries meanwhile use the old tile and the source beyond it
+  class TerrainCollider
+  {
+  public:
+    TerrainCollider(const HeightSource &source, float tileSize = 512.0f, float spacing = 1.0f, JobSystem *jobs = nullptr)
+        : source(source), tileSize(tileSize), spacing(spacing), jobs(jobs) {}
+
+    TerrainCollider(const TerrainCollider &) = delete;
+    TerrainCollider &operator=(const TerrainCollider &) = delete;
+
+    ~TerrainCollider()
+    {
+      if (jobs)
+        jobs->wait(building);
+    }
+
+    // keeps the cached tile centred on the given position
+    void focus(float x, float z)
+    {
+      if (pending)
+      {
+        if (!built.load())
+          return;
+        field = std::move(next);
+        pending = false;
+      }
+
+      glm::vec2 center = field.origin + 0.5f * field.extent();
+      float margin = 0.25f * tileSize;
+      if (!field.empty() && std::abs(x - center.x) < margin && std::abs(z - center.y) < margin)
+        return;
+
+      int count = int(tileSize / spacing) + 1;
+      // snap to the sample grid so rebuilt tiles agree with each other
+      glm::vec2 origin = glm::floor((glm::vec2(x, z) - 0.5f * tileSize) / spacing) * spacing;
+      rebuilds++;
+
+      if (!jobs)
+      {
+        field = Heightfield(count, count, origin, spacing);
+        source.sampleGrid(origin, spacing, count, field.heights.data());
+        return;
+      }
+
+      // the job only touches next, which nothing else reads until built is set
+      next = Heightfield(count, count, origin, spacing);
+      built = false;
+      pending = true;
+      jobs->submit([this, origin, count]()
+                   {
+                     source.sampleGrid(origin, spacing, count, next.heights.data());
+                     built = true; },
+                   building);
+    }
+
+    float height(float x, float z) const
+    {
+      if (field.empty() || !field.contains(x, z))
+        return source.heightAt(x, z);
+
+      return field.sample(x, z);
+    }
+
+    glm::vec3 normal(float x, float z) const
+    {
+      float left = height(x - spacing, z);
+      float right = height(x + spacing, z);
+      float back = height(x, z - spacing);
+      float front = height(x, z + spacing);
+      return glm::normalize(glm::vec3(left - right, 2.0f * spacing, back - front));
+    }
+
+    // bilinear heights for many points at once, eight per iteration with AVX2
+    void heights(const float *xs, const float *zs, float *out, size_t count) const
+    {
+      size_t i = 0;
+
+#if NSI_NOISE_AVX2
+      if (simdEnabled && cpuHasAvx2() && !field.empty())
+        i = heights8(xs, zs, out, count);
+#endif
+
+      for (; i < count; i++)
+      {
+        out[i] = field.empty() ? source.heightAt(xs[i], zs[i]) : field.sample(xs[i], zs[i]);
+      }
+
+      // the batch clamps to the tile, points outside go to the source
+      if (!field.empty())
+      {
+        for (size_t j = 0; j < count; j++)
+        {
+          if (!field.contains(xs[j], zs[j]))
+            out[j] = source.heightAt(xs[j], zs[j]);
+        }
+      }
+    }
+
+    void setSimdEnabled(bool enabled) { simdEnabled = enabled; }
+
+    float getSpacing() const { return spacing; }
+    const Heightfield &getTile() const { return field; }
+    size_t getRebuilds() const { return rebuilds; }
+
+  private:
+    const HeightSource &source;
+    float tileSize;
+    float spacing;
+    Heightfield field;
+    size_t rebuilds = 0;
+    bool simdEnabled = true;
+
+    JobSystem *jobs = nullptr;
+    JobCounter building;
+    Heightfield next;
+    std::atomic<bool> built{false};
+    bool pending = false;
+
+#if NSI_NOISE_AVX2
+    __attribute__((target("avx2"))) size_t heights8(const float *xs, const float *zs, float *out, size_t count) const
+    {
+      const __m256 originX = _mm256_set1_ps(field.origin.x);
+      const __m256 originZ = _mm256_set1_ps(field.origin.y);
+      // divided like Heightfield::sample, a reciprocal would round differently
+      const __m256 cellSize = _mm256_set1_ps(field.spacing);
+      const __m256 zero = _mm256_setzero_ps();
+      const __m256 maxX = _mm256_set1_ps(float(field.width - 1));
+      const __m256 maxZ = _mm256_set1_ps(float(field.depth - 1));
+      const __m256i lastCellX = _mm256_set1_epi32(field.width - 2);
+      const __m256i lastCellZ = _mm256_set1_epi32(field.depth - 2);
+      const __m256i stride = _mm256_set1_epi32(field.width);
+      const __m256i one = _mm256_set1_epi32(1);
+      const float *heights = field.heights.data();
+
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8)
+      {
+        __m256 gx = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(xs + i), originX), cellSize);
+        __m256 gz = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(zs + i), originZ), cellSize);
+        gx = _mm256_min_ps(_mm256_max_ps(gx, zero), maxX);
+        gz = _mm256_min_ps(_mm256_max_ps(gz, zero), maxZ);
+
+        __m256i x0 = _mm256_min_epi32(_mm256_cvttps_epi32(gx), lastCellX);
+        __m256i z0 = _mm256_min_epi32(_mm256_cvttps_epi32(gz), lastCellZ);
+        __m256 fx = _mm256_sub_ps(gx, _mm256_cvtepi32_ps(x0));
+        __m256 fz = _mm256_sub_ps(gz, _mm256_cvtepi32_ps(z0));
+
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(z0, stride), x0);
+        __m256 h00 = _mm256_i32gather_ps(heights, index, 4);
+        __m256 h10 = _mm256_i32gather_ps(heights, _mm256_add_epi32(index, one), 4);
+        index = _mm256_add_epi32(index, stride);
+        __m256 h01 = _mm256_i32gather_ps(heights, index, 4);
+        __m256 h11 = _mm256_i32gather_ps(heights, _mm256_add_epi32(index, one), 4);
+
+        __m256 top = _mm256_add_ps(h00, _mm256_mul_ps(_mm256_sub_ps(h10, h00), fx));
+        __m256 bottom = _mm256_add_ps(h01, _mm256_mul_ps(_mm256_sub_ps(h11, h01), fx));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), fz)));
+      }
+
+      return i;
+    }
+#endif
+  };
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef RENDER_BINDLESS_MATERIALS_H
+#define RENDER_BINDLESS_MATERIALS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glshader/glshader.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../mesh/mesh.h"
+#include "shaderManager.h"
+
+namespace nsi
+{
+  // one texture of a material as the shaders see it (std140): a bindless handle read as
+  // uvec2, the array layer and the rect inside that layer
+  struct MaterialTexture
+  {
+    uint64_t handle = 0;
+    float layer = 0.0f;
+    float padding = 0.0f;
+    glm::vec4 rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+  };
+
+  // diffuse, specular, normal and height, in the order materialTextures reads them
+  struct Material
+  {
+    static constexpr int SLOTS = 4;
+    MaterialTexture textures[SLOTS];
+  };
+
+  // process-wide switch for sampling model textures through ARB_bindless_texture handles
+  class BindlessTextures
+  {
+  public:
+    static BindlessTextures &get()
+    {
+      static BindlessTextures bindless;
+      return bindless;
+    }
+
+    // with the render context current; only turns on where the driver has the extension
+    // (never on macOS, whose 4.1 core profile lacks it)
+    bool init(bool requested)
+    {
+      enabled = requested && GLEW_ARB_bindless_texture;
+      return enabled;
+    }
+
+    bool isEnabled() const { return enabled; }
+
+  private:
+    bool enabled = false;
+
+    BindlessTextures() = default;
+  };
+
+  // the materials of a model's meshes as bindless handles in one uniform block. Shaders
+  // declare `uniform Materials { MaterialTexture materials[]; }` (SLOTS entries per
+  // material) and `uniform int materialIndex`; a mesh then only selects its material and
+  // draws, without touching texture units
+  class MaterialBlock
+  {
+  public:
+    // uniform buffer binding point of the Materials block
+    static constexpr GLuint BINDING = 3;
+    // 16 KiB, the smallest GL_MAX_UNIFORM_BLOCK_SIZE allowed
+    static constexpr size_t MAX_MATERIALS = 16384 / sizeof(Material);
+
+    MaterialBlock() = default;
+    MaterialBlock(const MaterialBlock &) = delete;
+    MaterialBlock &operator=(const MaterialBlock &) = delete;
+
+    ~MaterialBlock()
+    {
+      if (buffer)
+        glDeleteBuffers(1, &buffer);
+    }
+
+    // render thread: identical materials are stored once, every mesh gets the index of
+    // its own. False when they do not fit one block; meshes then keep binding textures
+    bool build(const std::vector<Material> &meshMaterials, std::vector<int> &indices)
+    {
+      std::vector<Material> materials;
+      indices.assign(meshMaterials.size(), -1);
+      for (size_t i = 0; i < meshMaterials.size(); i++)
+      {
+        size_t found = 0;
+        while (found < materials.size() && std::memcmp(&materials[found], &meshMaterials[i], sizeof(Material)) != 0)
+          found++;
+        if (found == materials.size())
+          materials.push_back(meshMaterials[i]);
+        indices[i] = int(found);
+      }
+
+      if (materials.empty() || materials.size() > MAX_MATERIALS)
+      {
+        indices.assign(meshMaterials.size(), -1);
+        return false;
+      }
+
+      if (!buffer)
+        glGenBuffers(1, &buffer);
+      glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+      glBufferData(GL_UNIFORM_BUFFER, materials.size() * sizeof(Material), materials.data(), GL_STATIC_DRAW);
+      glBindBuffer(GL_UNIFORM_BUFFER, 0);
+      count = materials.size();
+      return true;
+    }
+
+    size_t getCount() const { return count; }
+
+    // render thread, before a model's meshes draw: false when the shader has no Materials
+    // block, textures are then bound per mesh as usual
+    bool bind(Shader &shader, TextureBindings &bindings)
+    {
+      if (!buffer || count == 0)
+        return false;
+
+      // material variants take turns within a draw, so each program is asked about once;
+      // after a shader reload the names may belong to other programs
+      uint64_t shaderGeneration = ShaderManager::get().getGeneration();
+      if (shaderGeneration != generation)
+      {
+        programs.clear();
+        generation = shaderGeneration;
+      }
+      auto known = std::find_if(programs.begin(), programs.end(), [&](const ProgramBlock &entry)
+                                { return entry.program == shader.ID; });
+      if (known == programs.end())
+      {
+        ProgramBlock entry;
+        entry.program = shader.ID;
+        GLuint block = glGetUniformBlockIndex(entry.program, "Materials");
+        entry.materialLocation = glGetUniformLocation(entry.program, "materialIndex");
+        entry.usable = block != GL_INVALID_INDEX && entry.materialLocation >= 0;
+        if (entry.usable)
+          glUniformBlockBinding(entry.program, block, BINDING);
+        programs.push_back(entry);
+        known = programs.end() - 1;
+      }
+      if (!known->usable)
+        return false;
+
+      glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffer);
+      bindings.materialLocation = known->materialLocation;
+      return true;
+    }
+
+  private:
+    GLuint buffer = 0;
+    size_t count = 0;
+
+    // the shaders asked about
+    struct ProgramBlock
+    {
+      GLuint program = 0;
+      GLint materialLocation = -1;
+      bool usable = false;
+    };
+    std::vector<ProgramBlock> programs;
+    uint64_t generation = 0;
+  };
+}
+
+#endif
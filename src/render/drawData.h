@@ -0,0 +1,115 @@
+#ifndef RENDER_DRAW_DATA_H
+#define RENDER_DRAW_DATA_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+#include "streamBuffer.h"
+
+namespace nsi
+{
+  // one draw's data as six RGBA32F texels: the model matrix by columns, then two vec4 of
+  // draw-specific parameters (material, instance or node data)
+  struct DrawRecord
+  {
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec4 params[2] = {glm::vec4(0.0f), glm::vec4(0.0f)};
+  };
+
+  // per-frame draw records for the terrain nodes and instanced models, uploaded once per
+  // frame and read in the shaders through a samplerBuffer, indexed by the `drawId` uniform:
+  //   texelFetch(drawData, drawId * 6 + i)
+  class DrawDataBuffer
+  {
+  public:
+    static constexpr int TEXELS_PER_RECORD = int(sizeof(DrawRecord) / sizeof(glm::vec4));
+
+    DrawDataBuffer() = default;
+    DrawDataBuffer(const DrawDataBuffer &) = delete;
+    DrawDataBuffer &operator=(const DrawDataBuffer &) = delete;
+
+    ~DrawDataBuffer()
+    {
+      if (texture)
+        glDeleteTextures(1, &texture);
+    }
+
+    bool init(size_t maxDrawsPerFrame = 16384, int frames = 3)
+    {
+      // the whole ring has to fit in one texture buffer
+      GLint maxTexels = 0;
+      glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+      size_t limit = size_t(std::max(maxTexels, 0)) / TEXELS_PER_RECORD / size_t(frames);
+      capacity = std::max<size_t>(1, std::min(maxDrawsPerFrame, limit));
+
+      if (!stream.init(GL_TEXTURE_BUFFER, capacity * sizeof(DrawRecord), frames))
+      {
+        std::cerr << "ERROR::DRAW_DATA::INIT_FAILED" << std::endl;
+        return false;
+      }
+
+      glGenTextures(1, &texture);
+      glBindTexture(GL_TEXTURE_BUFFER, texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, stream.getBuffer());
+      glBindTexture(GL_TEXTURE_BUFFER, 0);
+      return true;
+    }
+
+    bool isReady() const { return texture != 0; }
+
+    void beginFrame()
+    {
+      records = reinterpret_cast<DrawRecord *>(stream.beginFrame());
+      base = int(stream.getFrameOffset() / sizeof(DrawRecord));
+      count = 0;
+    }
+
+    // returns the draw id for the shader, -1 once this frame's records are used up
+    int push(const DrawRecord &record)
+    {
+      if (count >= capacity)
+        return -1;
+
+      records[count] = record;
+      return base + int(count++);
+    }
+
+    // call after the last push and before the first draw that reads the records
+    void commit()
+    {
+      stream.commit(count * sizeof(DrawRecord));
+    }
+
+    void bind(Shader &shader, int unit)
+    {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_BUFFER, texture);
+      shader.setInt("drawData", unit);
+      glActiveTexture(GL_TEXTURE0);
+    }
+
+    void endFrame()
+    {
+      stream.endFrame();
+    }
+
+    size_t getCount() const { return count; }
+    size_t getCapacity() const { return capacity; }
+    const StreamBufferStats &getStats() const { return stream.getStats(); }
+
+  private:
+    StreamBuffer stream;
+    GLuint texture = 0;
+
+    DrawRecord *records = nullptr;
+    size_t capacity = 0;
+    size_t count = 0;
+    int base = 0;
+  };
+}
+
+#endif
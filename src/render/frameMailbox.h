@@ -0,0 +1,91 @@
+#ifndef RENDER_FRAME_MAILBOX_H
+#define RENDER_FRAME_MAILBOX_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+namespace nsi
+{
+  // triple buffer between one producer and one consumer: the producer fills its own slot
+  // and swaps it with the pending one, the consumer swaps the pending slot for the one it
+  // was reading. Neither side ever touches the other's slot
+  template <typename T>
+  class FrameMailbox
+  {
+  public:
+    // slot the producer may write until the next publish
+    T &writeSlot() { return slots[writeIndex]; }
+
+    // hands the written slot over; with waitForPickup the producer stays at most one
+    // frame ahead, otherwise an unread frame is replaced by the newer one
+    void publish(bool waitForPickup)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (waitForPickup)
+        ready.wait(lock, [this]
+                   { return !fresh || closed; });
+
+      if (fresh)
+        dropped++;
+
+      std::swap(writeIndex, pendingIndex);
+      fresh = true;
+      published++;
+      ready.notify_all();
+    }
+
+    // blocks for the newest frame, nullptr once closed; the slot stays valid until the next call
+    const T *acquire()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this]
+                 { return fresh || closed; });
+
+      if (!fresh)
+        return nullptr;
+
+      std::swap(readIndex, pendingIndex);
+      fresh = false;
+      ready.notify_all();
+      return &slots[readIndex];
+    }
+
+    // wakes both sides for shutdown
+    void close()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closed = true;
+      ready.notify_all();
+    }
+
+    uint64_t getPublished() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return published;
+    }
+
+    uint64_t getDropped() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return dropped;
+    }
+
+  private:
+    T slots[3];
+    int writeIndex = 0;
+    int pendingIndex = 1;
+    int readIndex = 2;
+    bool fresh = false;
+    bool closed = false;
+
+    uint64_t published = 0;
+    uint64_t dropped = 0;
+
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+  };
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef RENDER_FRAME_PACKET_H
+#define RENDER_FRAME_PACKET_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../model/model.h"
+#include "../models/world/world.h"
+
+namespace nsi
+{
+  struct DrawItem
+  {
+    Model *model = nullptr;
+    Shader *shader = nullptr;
+    glm::mat4 transform = glm::mat4(1.0f);
+    // instead of shader: the model picks a variant per material
+    ShaderVariants *variants = nullptr;
+  };
+
+  // everything the render thread needs for one frame, written by the simulation thread
+  // and read-only once submitted
+  struct FramePacket
+  {
+    uint64_t frame = 0;
+
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+
+    TerrainMode terrainMode = TerrainMode::CDLOD;
+    std::vector<DrawItem> draws;
+
+    // print the renderer's stats after this frame
+    bool logStats = false;
+
+    // packets are recycled, this keeps the draw list's storage
+    void reset()
+    {
+      draws.clear();
+      logStats = false;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef RENDER_PROGRAM_CACHE_H
+#define RENDER_PROGRAM_CACHE_H
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace nsi
+{
+  struct ProgramCacheStats
+  {
+    size_t hits = 0;
+    size_t misses = 0;
+    // binaries the driver no longer accepted, recompiled
+    size_t rejected = 0;
+    // compiling and linking misses, loading hits
+    double compileSeconds = 0.0;
+    double loadSeconds = 0.0;
+    // what the hits took to compile when they were stored, minus loading them
+    double savedSeconds = 0.0;
+  };
+
+  // linked programs on disk as glGetProgramBinary blobs, one file per set of sources and
+  // driver (vendor, renderer and version), so a driver update never sees another's
+  // binaries. A binary the driver rejects anyway is dropped and the program compiled
+  // again. Render thread only, like everything touching programs
+  class ProgramCache
+  {
+  public:
+    static ProgramCache &get()
+    {
+      static ProgramCache cache;
+      return cache;
+    }
+
+    // empty disables the disk, programs are then compiled on every launch
+    void setDirectory(const std::string &directory) { this->directory = directory; }
+    const std::string &getDirectory() const { return directory; }
+
+    // with the render context current, before the first program; some drivers offer no
+    // binary formats at all, programs are then always compiled
+    void init()
+    {
+      GLint formats = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+      enabled = formats > 0 && !directory.empty();
+
+      driverHash = fnv1a(fnvBasis, glString(GL_VENDOR));
+      driverHash = fnv1a(driverHash, glString(GL_RENDERER));
+      driverHash = fnv1a(driverHash, glString(GL_VERSION));
+    }
+
+    bool isEnabled() const { return enabled; }
+
+    // identifies a program by its sources on this driver
+    uint64_t key(std::initializer_list<std::string_view> sources) const
+    {
+      uint64_t hash = driverHash;
+      for (std::string_view source : sources)
+      {
+        hash = fnv1a(hash, source);
+        // keeps "ab" + "c" apart from "a" + "bc"
+        hash = fnv1a(hash, std::string_view("\0", 1));
+      }
+      return hash;
+    }
+
+    // a linked program from the stored binary, 0 when there is none or the driver
+    // rejects it
+    GLuint load(uint64_t key)
+    {
+      if (!enabled)
+        return 0;
+
+      auto start = std::chrono::steady_clock::now();
+      std::string path = cacheFile(key);
+      std::ifstream file(path, std::ios::binary);
+      if (!file)
+        return 0;
+
+      Header header;
+      std::vector<char> binary;
+      bool valid = file.read(reinterpret_cast<char *>(&header), sizeof(header)) && std::memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+                   header.version == version && header.key == key && header.length > 0;
+      if (valid)
+      {
+        binary.resize(header.length);
+        valid = bool(file.read(binary.data(), std::streamsize(binary.size())));
+      }
+      file.close();
+
+      GLuint program = 0;
+      GLint linked = GL_FALSE;
+      if (valid)
+      {
+        program = glCreateProgram();
+        glProgramBinary(program, header.binaryFormat, binary.data(), GLsizei(binary.size()));
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+      }
+
+      if (!linked)
+      {
+        // stale after a driver change the version string missed, or damaged
+        if (program)
+          glDeleteProgram(program);
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        stats.rejected++;
+        return 0;
+      }
+
+      double seconds = secondsSince(start);
+      stats.hits++;
+      stats.loadSeconds += seconds;
+      stats.savedSeconds += std::max(0.0, double(header.compileMicros) * 1e-6 - seconds);
+      return program;
+    }
+
+    // after compiling a miss: counts its time and writes the binary for the next launch.
+    // The program should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    void store(uint64_t key, GLuint program, double compileSeconds)
+    {
+      stats.misses++;
+      stats.compileSeconds += compileSeconds;
+
+      GLint linked = GL_FALSE;
+      glGetProgramiv(program, GL_LINK_STATUS, &linked);
+      if (!enabled || !linked)
+        return;
+
+      GLint length = 0;
+      glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+      if (length <= 0)
+        return;
+
+      Header header{};
+      std::memcpy(header.magic, magic, sizeof(magic));
+      header.version = version;
+      header.key = key;
+      header.compileMicros = uint32_t(std::min(compileSeconds * 1e6, 4e9));
+      std::vector<char> binary(static_cast<size_t>(length));
+      GLsizei written = 0;
+      glGetProgramBinary(program, length, &written, &header.binaryFormat, binary.data());
+      if (written <= 0)
+        return;
+      header.length = uint32_t(written);
+
+      std::error_code error;
+      std::filesystem::create_directories(directory, error);
+
+      // written under a private name and renamed, so a crash never leaves half a binary
+      std::string path = cacheFile(key);
+      std::ostringstream temporary;
+      temporary << path << "." << std::this_thread::get_id() << ".tmp";
+      {
+        std::ofstream file(temporary.str(), std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(binary.data(), written);
+        if (!file)
+        {
+          std::cerr << "ERROR::PROGRAM_CACHE::CANNOT_WRITE " << temporary.str() << std::endl;
+          file.close();
+          std::filesystem::remove(temporary.str(), error);
+          return;
+        }
+      }
+
+      std::filesystem::rename(temporary.str(), path, error);
+      if (error)
+        std::filesystem::remove(temporary.str(), error);
+    }
+
+    const ProgramCacheStats &getStats() const { return stats; }
+
+  private:
+    static constexpr char magic[8] = {'N', 'S', 'I', 'P', 'R', 'O', 'G', 0};
+    static constexpr uint32_t version = 1;
+    static constexpr uint64_t fnvBasis = 0xcbf29ce484222325ull;
+
+    struct Header
+    {
+      char magic[8];
+      uint32_t version;
+      GLenum binaryFormat;
+      uint64_t key;
+      uint32_t length;
+      uint32_t compileMicros;
+    };
+
+    std::string directory = "cache/programs";
+    bool enabled = false;
+    uint64_t driverHash = fnvBasis;
+    ProgramCacheStats stats;
+
+    ProgramCache() = default;
+
+    // FNV-1a, stable across runs unlike std::hash
+    static uint64_t fnv1a(uint64_t hash, std::string_view bytes)
+    {
+      for (char c : bytes)
+      {
+        hash = (hash ^ uint8_t(c)) * 0x100000001b3ull;
+      }
+      return hash;
+    }
+
+    static std::string_view glString(GLenum name)
+    {
+      const GLubyte *value = glGetString(name);
+      return value ? std::string_view(reinterpret_cast<const char *>(value)) : std::string_view();
+    }
+
+    static double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::string cacheFile(uint64_t key) const
+    {
+      std::ostringstream name;
+      name << std::hex << key << ".bin";
+      return (std::filesystem::path(directory) / name.str()).string();
+    }
+  };
+}
+
+#endif
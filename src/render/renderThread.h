@@ -0,0 +1,97 @@
+#ifndef RENDER_RENDER_THREAD_H
+#define RENDER_RENDER_THREAD_H
+
+#include <SDL.h>
+#include <GL/glew.h>
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#include "frameMailbox.h"
+#include "framePacket.h"
+
+namespace nsi
+{
+  // owns the GL context while running: the simulation thread fills frame packets, this
+  // thread submits them to GL and swaps, so frame N+1 is built while N is drawn
+  class RenderThread
+  {
+  public:
+    using RenderFunction = std::function<void(const FramePacket &)>;
+
+    ~RenderThread()
+    {
+      stop();
+    }
+
+    // the context must not be current on the calling thread
+    void start(SDL_Window *window, SDL_GLContext context, RenderFunction render)
+    {
+      this->window = window;
+      this->context = context;
+      this->render = std::move(render);
+      thread = std::thread(&RenderThread::renderLoop, this);
+    }
+
+    // finishes the frame in flight and releases the context
+    void stop()
+    {
+      mailbox.close();
+      if (thread.joinable())
+        thread.join();
+    }
+
+    // packet to fill for the next frame, valid until submit
+    FramePacket &beginFrame()
+    {
+      FramePacket &packet = mailbox.writeSlot();
+      packet.reset();
+      return packet;
+    }
+
+    // waits while the previous packet has not been picked up yet
+    void submit()
+    {
+      mailbox.publish(true);
+    }
+
+    uint64_t getFramesRendered() const { return framesRendered.load(); }
+    uint64_t getFramesDropped() const { return mailbox.getDropped(); }
+
+  private:
+    SDL_Window *window = nullptr;
+    SDL_GLContext context = nullptr;
+    RenderFunction render;
+
+    FrameMailbox<FramePacket> mailbox;
+    std::thread thread;
+    std::atomic<uint64_t> framesRendered{0};
+
+    void renderLoop()
+    {
+      if (!SDL_GL_MakeCurrent(window, context))
+      {
+        std::cerr << "ERROR::RENDER_THREAD::MAKE_CURRENT_FAILED\n"
+                  << SDL_GetError() << std::endl;
+        // unblock the producer
+        mailbox.close();
+        return;
+      }
+
+      while (const FramePacket *packet = mailbox.acquire())
+      {
+        render(*packet);
+        SDL_GL_SwapWindow(window);
+        framesRendered++;
+      }
+
+      // hand the context back for teardown on the main thread
+      glFinish();
+      SDL_GL_MakeCurrent(window, nullptr);
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,613 @@
+#ifndef RENDER_SHADER_MANAGER_H
+#define RENDER_SHADER_MANAGER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glshader/glshader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../assets/assetPack.h"
+#include "../assets/fileWatcher.h"
+#include "programCache.h"
+
+namespace nsi
+{
+  // a shader file's text: from the pack's bytes when packed (unless loose asks for the
+  // file on disk), otherwise read into storage
+  inline bool readShaderSource(const char *path, PackFile &packed, std::string &storage, std::string_view &source, bool loose = false)
+  {
+    if (!loose && AssetPack::get().read(path, packed))
+    {
+      source = std::string_view(reinterpret_cast<const char *>(packed.data), packed.size);
+      return true;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+      std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+      return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    storage = stream.str();
+    source = storage;
+    return true;
+  }
+
+  // lines for `#define`: "NAME" or "NAME value"
+  using ShaderDefines = std::vector<std::string>;
+
+  // a shader file with its `#include "file"` lines (relative to the including file)
+  // replaced by that file, each file once, and the defines right after `#version`.
+  // Every file read is added to files, and its index there is its source string number
+  // in `#line`, so compile errors name file and line: one files list per stage, the
+  // top file is 0. False when a file is missing
+  inline bool preprocessShader(const std::string &path, const ShaderDefines &defines, std::string &out, std::vector<std::string> &files, bool loose = false, int depth = 0)
+  {
+    if (depth > 16)
+    {
+      std::cerr << "ERROR::SHADER::INCLUDE_TOO_DEEP " << path << std::endl;
+      return false;
+    }
+    if (std::find(files.begin(), files.end(), path) != files.end())
+      return true;
+    files.push_back(path);
+
+    PackFile packed;
+    std::string storage;
+    std::string_view source;
+    if (!readShaderSource(path.c_str(), packed, storage, source, loose))
+      return false;
+
+    std::string id = " " + std::to_string(files.size() - 1) + "\n";
+    if (depth > 0)
+      out += "#line 1" + id;
+
+    bool defined = depth > 0;
+    size_t line = 0;
+    size_t begin = 0;
+    while (begin < source.size())
+    {
+      size_t end = source.find('\n', begin);
+      end = end == std::string_view::npos ? source.size() : end + 1;
+      std::string_view text = source.substr(begin, end - begin);
+      begin = end;
+      line++;
+
+      std::string_view directive = text.substr(std::min(text.find_first_not_of(" \t"), text.size()));
+      if (directive.starts_with("#include"))
+      {
+        size_t open = directive.find('"');
+        size_t close = open == std::string_view::npos ? open : directive.find('"', open + 1);
+        if (close == std::string_view::npos)
+        {
+          std::cerr << "ERROR::SHADER::BAD_INCLUDE " << path << ":" << line << std::endl;
+          return false;
+        }
+        std::filesystem::path included = std::filesystem::path(path).parent_path() / std::string(directive.substr(open + 1, close - open - 1));
+        if (!preprocessShader(included.lexically_normal().generic_string(), defines, out, files, loose, depth + 1))
+          return false;
+        // compile errors keep pointing at the right line of this file
+        out += "#line " + std::to_string(line + 1) + id;
+        continue;
+      }
+
+      // defines go after #version, which has to come first; without one at the top
+      bool blank = directive.find_first_not_of("\r\n") == std::string_view::npos || directive.starts_with("//");
+      if (!defined && !blank && !directive.starts_with("#version"))
+      {
+        for (const std::string &define : defines)
+          out += "#define " + define + "\n";
+        out += "#line " + std::to_string(line) + id;
+        defined = true;
+      }
+      out += text;
+      if (text.empty() || text.back() != '\n')
+        out += '\n';
+      if (!defined && directive.starts_with("#version"))
+      {
+        for (const std::string &define : defines)
+          out += "#define " + define + "\n";
+        out += "#line " + std::to_string(line + 1) + id;
+        defined = true;
+      }
+    }
+    return true;
+  }
+
+  struct ShaderManagerStats
+  {
+    size_t submitted = 0;
+    // submits answered with a program this launch already has
+    size_t reused = 0;
+    size_t pending = 0;
+    size_t failed = 0;
+    // programs a draw had to wait for, still compiling when first used
+    size_t waited = 0;
+    // render thread time spent waiting on them
+    double waitSeconds = 0.0;
+    // from the first submit until the last program was ready
+    double readySeconds = 0.0;
+    // hot reloads swapped in, and those that failed and left the old program in place
+    size_t reloaded = 0;
+    size_t reloadsFailed = 0;
+  };
+
+  // hands every program to the driver up front and only asks about it when it is first
+  // used, so compiling runs alongside asset loading. With KHR_parallel_shader_compile
+  // (or the ARB version) the driver compiles on its own threads and poll() picks up
+  // finished programs without blocking; without it the status is still not queried
+  // until first use, which lets drivers that compile lazily overlap as well.
+  // With hot reload a program whose files change is compiled again in the background
+  // and swapped in by poll() at the start of a frame; the Shader everyone holds keeps
+  // its place and only its name changes, and a failed compile keeps the old one.
+  // Render thread only, like everything touching programs
+  class ShaderManager
+  {
+  public:
+    static ShaderManager &get()
+    {
+      static ShaderManager manager;
+      return manager;
+    }
+
+    // with the render context current, before the first submit
+    void init()
+    {
+      parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+      // as many compiler threads as the driver likes
+      if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+      else if (GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+
+    bool hasParallelCompile() const { return parallel; }
+
+    // watches every file the programs are built from and rebuilds them when one changes.
+    // Before the first submit: sources are then read from disk even with a pack open
+    void enableHotReload()
+    {
+      hotReload = true;
+      watcher.start();
+    }
+
+    bool isHotReloading() const { return hotReload; }
+
+    // reads the sources (with their includes and the defines) and starts compiling and
+    // linking without waiting for either. The program's name is usable right away; call
+    // ready() before drawing with it. The same files and defines give the same Shader for
+    // the rest of the launch, and the binary from the program cache is taken instead of
+    // compiling when the preprocessed sources are unchanged
+    Shader &submit(const char *vertexPath, const char *fragmentPath, const ShaderDefines &defines = {})
+    {
+      std::string name = programName(vertexPath, fragmentPath, defines);
+      auto known = programs.find(name);
+      if (known != programs.end())
+      {
+        stats.reused++;
+        return known->second.shader;
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      if (stats.submitted == 0)
+        firstSubmit = start;
+      stats.submitted++;
+
+      Program &program = programs[name];
+      program.vertexPath = vertexPath;
+      program.fragmentPath = fragmentPath;
+      program.defines = defines;
+
+      Pending entry;
+      if (build(name, program, entry))
+      {
+        program.shader = Shader::fromProgram(entry.program);
+        if (!loading())
+        {
+          stats.readySeconds = secondsSince(firstSubmit);
+          allReady = true;
+        }
+        return program.shader;
+      }
+
+      entry.seconds = secondsSince(start);
+      program.shader = Shader::fromProgram(entry.program);
+      pending.push_back(entry);
+      stats.pending = pending.size();
+      allReady = reported = false;
+      return program.shader;
+    }
+
+    // at a frame boundary: finishes the programs the driver is done with without
+    // waiting, swaps in reloads compiled since the last call and starts those for files
+    // that changed. True once, when the last submitted program has finished
+    bool poll()
+    {
+      for (size_t i = 0; i < pending.size();)
+      {
+        GLint complete = GL_FALSE;
+        if (parallel)
+          glGetProgramiv(pending[i].program, GL_COMPLETION_STATUS_KHR, &complete);
+        // without the extension a reload has had a frame and is finished regardless
+        if (complete || (pending[i].reload && !parallel))
+          finish(i);
+        else
+          i++;
+      }
+
+      if (hotReload)
+      {
+        for (const std::string &path : watcher.takeChanged())
+        {
+          for (auto &entry : programs)
+          {
+            if (std::find(entry.second.files.begin(), entry.second.files.end(), path) != entry.second.files.end())
+              reload(entry.first, entry.second);
+          }
+        }
+      }
+
+      bool done = allReady && !reported;
+      reported = reported || allReady;
+      return done;
+    }
+
+    // before every draw with a program: waits for it when it is still compiling, false
+    // while it is failed (until a reload links). Cheap once everything is ready
+    bool ready(const Shader &shader)
+    {
+      for (size_t i = 0; i < pending.size(); i++)
+      {
+        if (pending[i].program != shader.ID)
+          continue;
+
+        GLint complete = GL_FALSE;
+        if (parallel)
+          glGetProgramiv(pending[i].program, GL_COMPLETION_STATUS_KHR, &complete);
+        auto start = std::chrono::steady_clock::now();
+        bool linked = finish(i);
+        if (!complete)
+        {
+          stats.waited++;
+          stats.waitSeconds += secondsSince(start);
+        }
+        return linked;
+      }
+      if (failedPrograms == 0)
+        return true;
+      auto failed = std::find_if(programs.begin(), programs.end(), [&shader](const auto &entry)
+                                 { return &entry.second.shader == &shader; });
+      return failed == programs.end() || !failed->second.failed;
+    }
+
+    // changes whenever a reload swaps a program, for whatever keeps per-program state
+    // (uniform locations, block bindings) to look it up again
+    uint64_t getGeneration() const { return generation; }
+
+    const ShaderManagerStats &getStats() const { return stats; }
+
+  private:
+    struct Program
+    {
+      Shader shader;
+      std::string vertexPath;
+      std::string fragmentPath;
+      ShaderDefines defines;
+      // every file it was built from, includes too
+      std::vector<std::string> files;
+      // per stage, by source string number
+      std::vector<std::string> vertexFiles;
+      std::vector<std::string> fragmentFiles;
+      // its first build did not link and no reload has yet; not drawn with
+      bool failed = false;
+    };
+
+    struct Pending
+    {
+      GLuint program = 0;
+      GLuint vertex = 0;
+      GLuint fragment = 0;
+      uint64_t key = 0;
+      std::string name;
+      // replaces the program of name once linked, instead of being its first
+      bool reload = false;
+      // render thread time spent on it so far
+      double seconds = 0.0;
+    };
+
+    bool parallel = false;
+    bool hotReload = false;
+    FileWatcher watcher;
+    // every program of this launch by files and defines; Shaders handed out point here
+    std::map<std::string, Program> programs;
+    std::vector<Pending> pending;
+    std::chrono::steady_clock::time_point firstSubmit;
+    ShaderManagerStats stats;
+    uint64_t generation = 0;
+    // programs with failed set, so ready() only looks when there are some
+    size_t failedPrograms = 0;
+    bool allReady = false;
+    bool reported = false;
+
+    ShaderManager() = default;
+
+    static std::string programName(const char *vertexPath, const char *fragmentPath, ShaderDefines defines)
+    {
+      std::sort(defines.begin(), defines.end());
+      std::string name = std::string(vertexPath) + "|" + fragmentPath;
+      for (const std::string &define : defines)
+        name += "|" + define;
+      return name;
+    }
+
+    // programs still on their way to their first use
+    bool loading() const
+    {
+      return std::any_of(pending.begin(), pending.end(), [](const Pending &entry)
+                         { return !entry.reload; });
+    }
+
+    // preprocesses the program's files and either loads its binary (true, entry.program
+    // is linked) or starts compiling and linking it into entry
+    bool build(const std::string &name, Program &program, Pending &entry)
+    {
+      std::string vertex, fragment;
+      program.vertexFiles.clear();
+      program.fragmentFiles.clear();
+      preprocessShader(program.vertexPath, program.defines, vertex, program.vertexFiles, hotReload);
+      preprocessShader(program.fragmentPath, program.defines, fragment, program.fragmentFiles, hotReload);
+      program.files = program.vertexFiles;
+      for (const std::string &file : program.fragmentFiles)
+      {
+        if (std::find(program.files.begin(), program.files.end(), file) == program.files.end())
+          program.files.push_back(file);
+      }
+      if (hotReload)
+        watcher.watch(program.files);
+
+      ProgramCache &cache = ProgramCache::get();
+      entry.name = name;
+      entry.key = cache.key({vertex, fragment});
+      if ((entry.program = cache.load(entry.key)))
+        return true;
+
+      entry.vertex = compile(GL_VERTEX_SHADER, vertex);
+      entry.fragment = compile(GL_FRAGMENT_SHADER, fragment);
+      entry.program = glCreateProgram();
+      glAttachShader(entry.program, entry.vertex);
+      glAttachShader(entry.program, entry.fragment);
+      if (cache.isEnabled())
+        glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      glLinkProgram(entry.program);
+      return false;
+    }
+
+    // compiles the program again from its files; an earlier reload still compiling is
+    // dropped for this one, a first build still compiling is finished before it is
+    // replaced
+    void reload(const std::string &name, Program &program)
+    {
+      for (size_t i = 0; i < pending.size(); i++)
+      {
+        if (pending[i].name != name)
+          continue;
+        if (pending[i].reload)
+        {
+          release(pending[i]);
+          glDeleteProgram(pending[i].program);
+          pending.erase(pending.begin() + i);
+        }
+        else
+          finish(i);
+        break;
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      Pending entry;
+      entry.reload = true;
+      if (build(name, program, entry))
+      {
+        swap(program, entry.program);
+        return;
+      }
+      entry.seconds = secondsSince(start);
+      pending.push_back(entry);
+    }
+
+    // the new program takes the old one's place in the Shader everyone holds
+    void swap(Program &program, GLuint replacement)
+    {
+      glDeleteProgram(program.shader.ID);
+      program.shader.ID = replacement;
+      if (program.failed)
+      {
+        program.failed = false;
+        failedPrograms--;
+      }
+      generation++;
+      stats.reloaded++;
+      std::cout << "Shader reloaded: " << program.vertexPath << " + " << program.fragmentPath << std::endl;
+    }
+
+    static void release(const Pending &entry)
+    {
+      glDetachShader(entry.program, entry.vertex);
+      glDetachShader(entry.program, entry.fragment);
+      glDeleteShader(entry.vertex);
+      glDeleteShader(entry.fragment);
+    }
+
+    static GLuint compile(GLenum type, std::string_view source)
+    {
+      GLuint shader = glCreateShader(type);
+      const char *code = source.data();
+      GLint length = GLint(source.size());
+      glShaderSource(shader, 1, &code, &length);
+      glCompileShader(shader);
+      return shader;
+    }
+
+    static double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // the first status query, which waits when the driver is not done yet; logs what
+    // failed and hands a linked program to the cache. A linked reload is swapped in, a
+    // failed one dropped
+    bool finish(size_t index)
+    {
+      Pending entry = pending[index];
+      pending.erase(pending.begin() + index);
+      Program &program = programs[entry.name];
+
+      auto start = std::chrono::steady_clock::now();
+      GLint linked = GL_FALSE;
+      glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+      if (!linked)
+      {
+        logShader(entry.vertex, program.vertexFiles);
+        logShader(entry.fragment, program.fragmentFiles);
+        GLchar infoLog[1024];
+        glGetProgramInfoLog(entry.program, 1024, NULL, infoLog);
+        std::cout << "ERROR::PROGRAM_LINKING_ERROR: " << program.vertexPath << " + " << program.fragmentPath << "\n"
+                  << infoLog << std::endl;
+      }
+      release(entry);
+
+      // what this program cost the render thread; with parallel compiling most of the
+      // work happened on the driver's threads and is not counted
+      ProgramCache::get().store(entry.key, entry.program, entry.seconds + secondsSince(start));
+
+      if (entry.reload)
+      {
+        if (linked)
+          swap(program, entry.program);
+        else
+        {
+          std::cout << "Shader reload failed, keeping the previous program" << std::endl;
+          glDeleteProgram(entry.program);
+          stats.reloadsFailed++;
+        }
+        return linked == GL_TRUE;
+      }
+
+      if (!linked)
+      {
+        stats.failed++;
+        program.failed = true;
+        failedPrograms++;
+      }
+      stats.pending = pending.size();
+      if (!loading())
+      {
+        stats.readySeconds = secondsSince(firstSubmit);
+        allReady = true;
+      }
+      return linked == GL_TRUE;
+    }
+
+    // with the files behind the source string numbers the log's lines start with
+    static void logShader(GLuint shader, const std::vector<std::string> &files)
+    {
+      GLint success = GL_FALSE;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+      if (success)
+        return;
+      GLchar infoLog[1024];
+      glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+      std::cout << "ERROR::SHADER_COMPILATION_ERROR: " << (files.empty() ? std::string() : files[0]) << "\n";
+      for (size_t i = 0; i < files.size(); i++)
+        std::cout << "  " << i << ": " << files[i] << "\n";
+      std::cout << infoLog << std::endl;
+    }
+  };
+
+  // one shader source built for several feature sets: bit i of a set adds
+  // featureDefines[i] to the defines. A set is submitted the first time it is asked for
+  // and kept, so it compiles once per launch and comes from the binary cache after that
+  class ShaderVariants
+  {
+  public:
+    ShaderVariants() = default;
+    ShaderVariants(std::string vertexPath, std::string fragmentPath, std::vector<std::string> featureDefines, ShaderDefines defines = {})
+        : vertexPath(std::move(vertexPath)), fragmentPath(std::move(fragmentPath)), featureDefines(std::move(featureDefines)), defines(std::move(defines)) {}
+
+    // variants with any of features set build their fragment stage from fragmentPath
+    // instead, for a source too different to share one file
+    void setFragmentFor(unsigned features, std::string fragmentPath)
+    {
+      alternateFeatures = features;
+      alternateFragmentPath = std::move(fragmentPath);
+    }
+
+    Shader &variant(unsigned features)
+    {
+      auto found = variants.find(features);
+      if (found != variants.end())
+        return *found->second;
+
+      ShaderDefines variantDefines = defines;
+      for (size_t i = 0; i < featureDefines.size(); i++)
+      {
+        if (features & (1u << i))
+          variantDefines.push_back(featureDefines[i]);
+      }
+      const std::string &fragment = features & alternateFeatures ? alternateFragmentPath : fragmentPath;
+      Shader &shader = ShaderManager::get().submit(vertexPath.c_str(), fragment.c_str(), variantDefines);
+      variants[features] = &shader;
+      return shader;
+    }
+
+    // render thread, before a draw: the matrices every variant gets when it is bound
+    void setTransforms(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection)
+    {
+      this->model = model;
+      this->view = view;
+      this->projection = projection;
+    }
+
+    // render thread: makes the variant for features current, waiting for it when it is
+    // still compiling, with this draw's matrices set. Null when it failed, skip the draw
+    Shader *use(unsigned features)
+    {
+      Shader &shader = variant(features);
+      if (!ShaderManager::get().ready(shader))
+        return nullptr;
+      shader.use();
+      shader.setMat4("model", model);
+      shader.setMat4("view", view);
+      shader.setMat4("projection", projection);
+      return &shader;
+    }
+
+  private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> featureDefines;
+    ShaderDefines defines;
+    unsigned alternateFeatures = 0;
+    std::string alternateFragmentPath;
+    // the manager's, so reloads reach them
+    std::map<unsigned, Shader *> variants;
+
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+  };
+}
+
+#endif
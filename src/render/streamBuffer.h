@@ -0,0 +1,168 @@
+#ifndef RENDER_STREAM_BUFFER_H
+#define RENDER_STREAM_BUFFER_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace nsi
+{
+  struct StreamBufferStats
+  {
+    bool persistent = false;
+    // frames that had to wait for the GPU to release their region
+    size_t stalls = 0;
+    size_t bytesWritten = 0;
+  };
+
+  // per-frame dynamic data. With ARB_buffer_storage the buffer is mapped once, split into
+  // `frames` regions and written in place, each region fenced after its frame; otherwise
+  // a CPU staging copy is uploaded into a freshly orphaned buffer every frame
+  class StreamBuffer
+  {
+  public:
+    StreamBuffer() = default;
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    ~StreamBuffer()
+    {
+      release();
+    }
+
+    bool init(GLenum target, size_t frameBytes, int frames = 3)
+    {
+      release();
+
+      this->target = target;
+      frameSize = frameBytes;
+      frameCount = frames;
+
+      glGenBuffers(1, &buffer);
+      glBindBuffer(target, buffer);
+
+      if (GLEW_ARB_buffer_storage)
+      {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, GLsizeiptr(frameSize * frameCount), nullptr, flags);
+        mapped = static_cast<uint8_t *>(glMapBufferRange(target, 0, GLsizeiptr(frameSize * frameCount), flags));
+        if (!mapped)
+        {
+          // immutable storage cannot be respecified, start over with a plain buffer
+          std::cerr << "ERROR::STREAM_BUFFER::MAP_FAILED, falling back to orphaning" << std::endl;
+          glBindBuffer(target, 0);
+          glDeleteBuffers(1, &buffer);
+          glGenBuffers(1, &buffer);
+          glBindBuffer(target, buffer);
+        }
+      }
+
+      if (!mapped)
+      {
+        glBufferData(target, GLsizeiptr(frameSize), nullptr, GL_STREAM_DRAW);
+        staging.resize(frameSize);
+      }
+
+      glBindBuffer(target, 0);
+
+      fences.assign(size_t(frameCount), nullptr);
+      stats = StreamBufferStats();
+      stats.persistent = mapped != nullptr;
+      return buffer != 0;
+    }
+
+    // memory for this frame's data, frameBytes long; waits only when the GPU is still
+    // reading the region from `frames` frames ago
+    uint8_t *beginFrame()
+    {
+      if (!mapped)
+        return staging.data();
+
+      region = (region + 1) % frameCount;
+      GLsync &fence = fences[size_t(region)];
+      if (fence)
+      {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+          stats.stalls++;
+          while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+          {
+          }
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+      }
+
+      return mapped + size_t(region) * frameSize;
+    }
+
+    // makes the first usedBytes of this frame visible to draws issued afterwards
+    void commit(size_t usedBytes)
+    {
+      stats.bytesWritten += usedBytes;
+
+      // coherent mapping, nothing to do
+      if (mapped || usedBytes == 0)
+        return;
+
+      glBindBuffer(target, buffer);
+      glBufferData(target, GLsizeiptr(frameSize), nullptr, GL_STREAM_DRAW);
+      glBufferSubData(target, 0, GLsizeiptr(usedBytes), staging.data());
+      glBindBuffer(target, 0);
+    }
+
+    // after the frame's last draw that reads it
+    void endFrame()
+    {
+      if (mapped)
+        fences[size_t(region)] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLuint getBuffer() const { return buffer; }
+    size_t getFrameSize() const { return frameSize; }
+    // where this frame's region starts in the buffer
+    size_t getFrameOffset() const { return mapped ? size_t(region) * frameSize : 0; }
+    const StreamBufferStats &getStats() const { return stats; }
+
+  private:
+    GLenum target = GL_ARRAY_BUFFER;
+    GLuint buffer = 0;
+    size_t frameSize = 0;
+    int frameCount = 0;
+    int region = 0;
+
+    uint8_t *mapped = nullptr;
+    std::vector<uint8_t> staging;
+    std::vector<GLsync> fences;
+    StreamBufferStats stats;
+
+    void release()
+    {
+      for (GLsync fence : fences)
+      {
+        if (fence)
+          glDeleteSync(fence);
+      }
+      fences.clear();
+
+      if (mapped)
+      {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        glBindBuffer(target, 0);
+        mapped = nullptr;
+      }
+
+      if (buffer)
+        glDeleteBuffers(1, &buffer);
+      buffer = 0;
+      staging.clear();
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef RENDER_UPLOAD_THREAD_H
+#define RENDER_UPLOAD_THREAD_H
+
+#include <SDL.h>
+#include <GL/glew.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nsi
+{
+  struct UploadStats
+  {
+    size_t queued = 0;
+    // uploaded, waiting for the GPU to pass the fence
+    size_t inFlight = 0;
+    size_t completed = 0;
+    double uploadSeconds = 0.0;
+  };
+
+  // background uploads on a second GL context shared with the render context. upload()
+  // runs on this thread, creates buffers and textures and is followed by a fence; once
+  // the fence has passed, ready() runs on the render thread (from collect), which is
+  // where per-context objects like vertex arrays have to be made.
+  // Without a shared context both run inline on the render thread
+  class UploadThread
+  {
+  public:
+    using Task = std::function<void()>;
+
+    ~UploadThread()
+    {
+      stop();
+    }
+
+    // call on the thread that owns renderContext while it is current; it stays current
+    bool start(SDL_Window *window, SDL_GLContext renderContext)
+    {
+      // contexts need a drawable, a hidden window keeps this one off the main window
+      uploadWindow = SDL_CreateWindow("upload", 1, 1, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+      if (!uploadWindow)
+      {
+        std::cerr << "ERROR::UPLOAD_THREAD::WINDOW_FAILED\n"
+                  << SDL_GetError() << std::endl;
+        return false;
+      }
+
+      SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+      context = SDL_GL_CreateContext(uploadWindow);
+      SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+
+      // creating a context makes it current, hand the thread back to the render context
+      SDL_GL_MakeCurrent(window, renderContext);
+
+      if (!context)
+      {
+        std::cerr << "ERROR::UPLOAD_THREAD::SHARED_CONTEXT_FAILED\n"
+                  << SDL_GetError() << std::endl;
+        SDL_DestroyWindow(uploadWindow);
+        uploadWindow = nullptr;
+        return false;
+      }
+
+      stopping = false;
+      running = true;
+      thread = std::thread(&UploadThread::uploadLoop, this);
+      return true;
+    }
+
+    // finishes queued uploads; call from the thread that called start
+    void stop()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      wake.notify_all();
+
+      if (thread.joinable())
+        thread.join();
+
+      // their objects exist, only nobody is waiting for them anymore
+      for (Fenced &upload : uploaded)
+      {
+        glDeleteSync(upload.fence);
+      }
+      uploaded.clear();
+      running = false;
+
+      if (context)
+        SDL_GL_DestroyContext(context);
+      if (uploadWindow)
+        SDL_DestroyWindow(uploadWindow);
+      context = nullptr;
+      uploadWindow = nullptr;
+    }
+
+    bool isRunning() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return running;
+    }
+
+    void submit(Task upload, Task ready)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back({std::move(upload), std::move(ready)});
+      stats.queued++;
+      wake.notify_one();
+    }
+
+    // render thread, once per frame: publishes uploads whose fence has passed, never waits
+    // on the GPU. Returns how many became ready
+    size_t collect()
+    {
+      std::vector<Pending> direct;
+      std::vector<Fenced> fenced;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running)
+        {
+          direct.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.end()));
+          queue.clear();
+          stats.queued = 0;
+        }
+        fenced.swap(uploaded);
+      }
+
+      size_t ready = 0;
+      for (Pending &task : direct)
+      {
+        task.upload();
+        task.ready();
+        ready++;
+      }
+
+      std::vector<Fenced> waiting;
+      for (Fenced &upload : fenced)
+      {
+        GLenum status = glClientWaitSync(upload.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+          waiting.push_back(std::move(upload));
+          continue;
+        }
+
+        glDeleteSync(upload.fence);
+        upload.ready();
+        ready++;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      // newer uploads may have arrived meanwhile, keep them after the older ones
+      waiting.insert(waiting.end(), std::make_move_iterator(uploaded.begin()), std::make_move_iterator(uploaded.end()));
+      uploaded.swap(waiting);
+      stats.inFlight = uploaded.size();
+      stats.completed += ready;
+      return ready;
+    }
+
+    UploadStats getStats() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return stats;
+    }
+
+  private:
+    struct Pending
+    {
+      Task upload;
+      Task ready;
+    };
+
+    struct Fenced
+    {
+      GLsync fence;
+      Task ready;
+    };
+
+    SDL_Window *uploadWindow = nullptr;
+    SDL_GLContext context = nullptr;
+    std::thread thread;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Pending> queue;
+    std::vector<Fenced> uploaded;
+    bool stopping = false;
+    bool running = false;
+    UploadStats stats;
+
+    void uploadLoop()
+    {
+      if (!SDL_GL_MakeCurrent(uploadWindow, context))
+      {
+        std::cerr << "ERROR::UPLOAD_THREAD::MAKE_CURRENT_FAILED\n"
+                  << SDL_GetError() << std::endl;
+        // collect() uploads on the render thread from now on
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        return;
+      }
+
+      while (true)
+      {
+        Pending task;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          wake.wait(lock, [this]()
+                    { return stopping || !queue.empty(); });
+          if (queue.empty())
+            break;
+
+          task = std::move(queue.front());
+          queue.pop_front();
+          stats.queued--;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        task.upload();
+
+        // flushed so the fence actually reaches the GPU and the render context can see it
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        uploaded.push_back({fence, std::move(task.ready)});
+        stats.inFlight = uploaded.size();
+        stats.uploadSeconds += seconds;
+      }
+
+      glFinish();
+      SDL_GL_MakeCurrent(uploadWindow, nullptr);
+    }
+  };
+}
+
+#endif
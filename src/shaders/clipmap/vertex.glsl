@@ -0,0 +1,75 @@
+#version 330 core
+
+// geometry clipmap level: static ring geometry, heights from the level's texture layer
+
+// (x, z) in quads from the level origin, z = 1 / 2 for the column / row trim strip
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// camera position in terrain space
+uniform vec3 cameraPosition;
+
+// per-level draw records, 6 texels each: model matrix columns, (levelOrigin, levelSpacing,
+// level), (trimShift, -, -)
+uniform samplerBuffer drawData;
+uniform int drawId;
+
+uniform int levelCount;
+uniform float gridSize;
+uniform float textureSize;
+uniform float transitionWidth;
+
+// one toroidally addressed layer per level
+uniform sampler2DArray heightmaps;
+
+out vec3 worldPos;
+out vec2 terrainPos;
+flat out int levelIndex;
+flat out float levelSpacing;
+out float viewDistance;
+
+float sampleLevel(vec2 position, int layer, float spacing)
+{
+  vec2 texel = position / spacing;
+  return textureLod(heightmaps, vec3((texel + 0.5) / textureSize, float(layer)), 0.0).r;
+}
+
+void main()
+{
+  int record = drawId * 6;
+  mat4 model = mat4(texelFetch(drawData, record), texelFetch(drawData, record + 1),
+                    texelFetch(drawData, record + 2), texelFetch(drawData, record + 3));
+  vec4 placement = texelFetch(drawData, record + 4);
+  vec2 levelOrigin = placement.xy;
+  levelSpacing = placement.z;
+  int level = int(placement.w);
+  vec2 trimShift = texelFetch(drawData, record + 5).xy;
+
+  vec2 grid = aPos.xy;
+  if (aPos.z == 1.0)
+    grid.x += trimShift.x;
+  else if (aPos.z == 2.0)
+    grid.y += trimShift.y;
+
+  vec2 position = levelOrigin + grid * levelSpacing;
+  float height = sampleLevel(position, level, levelSpacing);
+
+  // fade into the coarser level's surface towards the outer edge so the rings meet exactly
+  if (level + 1 < levelCount)
+  {
+    vec2 fromViewer = abs(position - cameraPosition.xz) / levelSpacing;
+    vec2 alpha = clamp((fromViewer - (gridSize * 0.5 - transitionWidth - 2.0)) / transitionWidth, 0.0, 1.0);
+    float coarse = sampleLevel(position, level + 1, levelSpacing * 2.0);
+    height = mix(height, coarse, max(alpha.x, alpha.y));
+  }
+
+  vec4 world = model * vec4(position.x, height, position.y, 1.0);
+  worldPos = world.xyz;
+  terrainPos = position;
+  levelIndex = level;
+  viewDistance = distance(cameraPosition, vec3(position.x, height, position.y));
+
+  gl_Position = projection * view * world;
+}
@@ -0,0 +1,15 @@
+// the model fragment shaders' light: one directional light, with a highlight only in
+// variants whose material has a specular map
+uniform vec3 lightDirection = vec3(-0.4, -1.0, -0.3);
+
+vec3 shadeMaterial(vec3 albedo, vec3 normal, float specular, vec3 viewDirection)
+{
+  vec3 toLight = -normalize(lightDirection);
+  float diffuse = max(dot(normal, toLight), 0.0);
+  vec3 color = albedo * (0.3 + 0.7 * diffuse);
+#ifdef HAS_SPECULAR_MAP
+  vec3 halfway = normalize(toLight + viewDirection);
+  color += vec3(specular * pow(max(dot(normal, halfway), 0.0), 32.0));
+#endif
+  return color;
+}
@@ -0,0 +1,66 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 Normal;
+#ifdef HAS_NORMAL_MAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#endif
+#ifdef HAS_SPECULAR_MAP
+in vec3 ViewDirection;
+#endif
+
+// model textures are layers of texture arrays; rect places the texture inside its layer.
+// Only the maps of this variant's material are declared
+#ifdef HAS_DIFFUSE_MAP
+uniform sampler2DArray texture_diffuse1;
+uniform float texture_diffuse1_layer;
+uniform vec4 texture_diffuse1_rect = vec4(1.0, 1.0, 0.0, 0.0);
+#endif
+#ifdef HAS_SPECULAR_MAP
+uniform sampler2DArray texture_specular1;
+uniform float texture_specular1_layer;
+uniform vec4 texture_specular1_rect = vec4(1.0, 1.0, 0.0, 0.0);
+#endif
+#ifdef HAS_NORMAL_MAP
+uniform sampler2DArray texture_normal1;
+uniform float texture_normal1_layer;
+uniform vec4 texture_normal1_rect = vec4(1.0, 1.0, 0.0, 0.0);
+#endif
+
+#include "../include/lighting.glsl"
+
+// wraps inside the rect like GL_REPEAT would, gradients of the unwrapped coordinates
+// keep the mip level steady across the wrap
+vec4 sampleLayer(sampler2DArray tex, float layer, vec4 rect, vec2 uv)
+{
+  vec2 local = fract(uv) * rect.xy + rect.zw;
+  return textureGrad(tex, vec3(local, layer), dFdx(uv) * rect.xy, dFdy(uv) * rect.xy);
+}
+
+void main()
+{
+  vec4 albedo = vec4(1.0);
+#ifdef HAS_DIFFUSE_MAP
+  albedo = sampleLayer(texture_diffuse1, texture_diffuse1_layer, texture_diffuse1_rect, TexCoords);
+#endif
+
+  vec3 normal = normalize(Normal);
+#ifdef HAS_NORMAL_MAP
+  // only x and y are stored (two-channel RGTC has no blue), z follows from unit length
+  vec3 tangentNormal;
+  tangentNormal.xy = sampleLayer(texture_normal1, texture_normal1_layer, texture_normal1_rect, TexCoords).rg * 2.0 - 1.0;
+  tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
+  normal = normalize(mat3(normalize(Tangent), normalize(Bitangent), normal) * tangentNormal);
+#endif
+
+  float specular = 0.0;
+  vec3 viewDirection = vec3(0.0);
+#ifdef HAS_SPECULAR_MAP
+  specular = sampleLayer(texture_specular1, texture_specular1_layer, texture_specular1_rect, TexCoords).r;
+  viewDirection = normalize(ViewDirection);
+#endif
+
+  FragColor = vec4(shadeMaterial(albedo.rgb, normal, specular, viewDirection), albedo.a);
+}
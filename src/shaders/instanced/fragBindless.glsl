@@ -0,0 +1,67 @@
+#version 400 core
+#extension GL_ARB_bindless_texture : require
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 Normal;
+#ifdef HAS_NORMAL_MAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#endif
+#ifdef HAS_SPECULAR_MAP
+in vec3 ViewDirection;
+#endif
+
+// frag.glsl with textures taken from the model's material block instead of texture units
+struct MaterialTexture
+{
+  uvec2 handle;
+  float layer;
+  float padding;
+  vec4 rect;
+};
+
+// four textures per material: diffuse, specular, normal, height
+layout (std140) uniform Materials
+{
+  MaterialTexture materials[512];
+};
+
+uniform int materialIndex;
+
+#include "../include/lighting.glsl"
+
+// wraps inside the rect like GL_REPEAT would, gradients of the unwrapped coordinates
+// keep the mip level steady across the wrap. Variants only sample the maps their
+// material has, so every handle read here is set
+vec4 sampleMaterial(MaterialTexture entry, vec2 uv)
+{
+  vec2 local = fract(uv) * entry.rect.xy + entry.rect.zw;
+  return textureGrad(sampler2DArray(entry.handle), vec3(local, entry.layer), dFdx(uv) * entry.rect.xy, dFdy(uv) * entry.rect.xy);
+}
+
+void main()
+{
+  vec4 albedo = vec4(1.0);
+#ifdef HAS_DIFFUSE_MAP
+  albedo = sampleMaterial(materials[materialIndex * 4], TexCoords);
+#endif
+
+  vec3 normal = normalize(Normal);
+#ifdef HAS_NORMAL_MAP
+  // only x and y are stored (two-channel RGTC has no blue), z follows from unit length
+  vec3 tangentNormal;
+  tangentNormal.xy = sampleMaterial(materials[materialIndex * 4 + 2], TexCoords).rg * 2.0 - 1.0;
+  tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
+  normal = normalize(mat3(normalize(Tangent), normalize(Bitangent), normal) * tangentNormal);
+#endif
+
+  float specular = 0.0;
+  vec3 viewDirection = vec3(0.0);
+#ifdef HAS_SPECULAR_MAP
+  specular = sampleMaterial(materials[materialIndex * 4 + 1], TexCoords).r;
+  viewDirection = normalize(ViewDirection);
+#endif
+
+  FragColor = vec4(shadeMaterial(albedo.rgb, normal, specular, viewDirection), albedo.a);
+}
@@ -0,0 +1,54 @@
+#version 330 core
+
+// instanced model: mesh attributes plus one matrix per instance, the model matrix from the
+// draw record (6 texels, columns first) or, with drawId -1, the uniform
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+#ifdef HAS_NORMAL_MAP
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+#endif
+layout (location = 5) in mat4 aInstance;
+
+uniform samplerBuffer drawData;
+uniform int drawId;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec2 TexCoords;
+out vec3 Normal;
+#ifdef HAS_NORMAL_MAP
+out vec3 Tangent;
+out vec3 Bitangent;
+#endif
+#ifdef HAS_SPECULAR_MAP
+out vec3 ViewDirection;
+#endif
+
+void main()
+{
+  mat4 placement = model;
+  if (drawId >= 0)
+  {
+    int record = drawId * 6;
+    placement = mat4(texelFetch(drawData, record), texelFetch(drawData, record + 1),
+                     texelFetch(drawData, record + 2), texelFetch(drawData, record + 3));
+  }
+  mat4 world = placement * aInstance;
+  mat3 normalMatrix = mat3(world);
+  TexCoords = aTexCoords;
+  Normal = normalMatrix * aNormal;
+#ifdef HAS_NORMAL_MAP
+  Tangent = normalMatrix * aTangent;
+  Bitangent = normalMatrix * aBitangent;
+#endif
+  vec4 position = world * vec4(aPos, 1.0);
+#ifdef HAS_SPECULAR_MAP
+  // the camera is where view puts the origin
+  vec3 camera = -transpose(mat3(view)) * view[3].xyz;
+  ViewDirection = camera - position.xyz;
+#endif
+  gl_Position = projection * view * position;
+}
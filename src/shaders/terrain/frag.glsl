@@ -0,0 +1,31 @@
+#version 330 core
+
+in vec3 worldPos;
+in vec3 normal;
+in float viewDistance;
+
+out vec4 FragColor;
+
+uniform vec3 lightDirection = vec3(-0.4, -1.0, -0.3);
+uniform vec3 fogColor = vec3(0.1, 0.1, 0.1);
+uniform float fogDistance = 8000.0;
+
+void main()
+{
+  vec3 n = normalize(normal);
+
+  // grass on flats, rock on slopes, snow up high
+  float slope = 1.0 - n.y;
+  vec3 grass = vec3(0.25, 0.35, 0.15);
+  vec3 rock = vec3(0.40, 0.37, 0.33);
+  vec3 snow = vec3(0.90, 0.90, 0.92);
+
+  vec3 albedo = mix(grass, rock, smoothstep(0.15, 0.35, slope));
+  albedo = mix(albedo, snow, smoothstep(0.6, 0.9, n.y) * smoothstep(300.0, 450.0, worldPos.y));
+
+  float diffuse = max(dot(n, normalize(-lightDirection)), 0.0);
+  vec3 color = albedo * (0.25 + 0.75 * diffuse);
+
+  float fog = smoothstep(0.0, fogDistance, viewDistance);
+  FragColor = vec4(mix(color, fogColor, fog), 1.0);
+}
@@ -0,0 +1,64 @@
+#version 330 core
+
+// CDLOD terrain patch: one shared grid, placed and morphed per node
+
+// integer grid coordinates 0..gridSize
+layout (location = 0) in vec2 aGrid;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// camera position in terrain space
+uniform vec3 cameraPosition;
+
+uniform float gridSize;
+
+// per-node draw records, 6 texels each: model matrix columns, (nodeOrigin, nodeSize, -),
+// (morphRange, -, -) where morphRange is the distance morphing to the parent grid starts / ends
+uniform samplerBuffer drawData;
+uniform int drawId;
+
+// (normal.xyz, height) per grid vertex
+uniform sampler2D heightNormalMap;
+
+out vec3 worldPos;
+out vec3 normal;
+out float viewDistance;
+
+vec4 fetchTexel(vec2 grid)
+{
+  return textureLod(heightNormalMap, (grid + 0.5) / (gridSize + 1.0), 0.0);
+}
+
+void main()
+{
+  int record = drawId * 6;
+  mat4 model = mat4(texelFetch(drawData, record), texelFetch(drawData, record + 1),
+                    texelFetch(drawData, record + 2), texelFetch(drawData, record + 3));
+  vec4 node = texelFetch(drawData, record + 4);
+  vec2 nodeOrigin = node.xy;
+  float nodeSize = node.z;
+  vec2 morphRange = texelFetch(drawData, record + 5).xy;
+
+  float cellSize = nodeSize / gridSize;
+
+  // distance on the unmorphed vertex decides how far it moves
+  vec2 local = nodeOrigin + aGrid * cellSize;
+  float height = fetchTexel(aGrid).w;
+  float dist = distance(cameraPosition, vec3(local.x, height, local.y));
+  float morph = clamp((dist - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+
+  // odd vertices slide onto their even neighbours, matching the parent's grid at morph = 1
+  vec2 oddOffset = fract(aGrid * 0.5) * 2.0;
+  vec2 grid = aGrid - oddOffset * morph;
+
+  vec4 texel = fetchTexel(grid);
+  vec2 morphed = nodeOrigin + grid * cellSize;
+
+  vec4 world = model * vec4(morphed.x, texel.w, morphed.y, 1.0);
+  worldPos = world.xyz;
+  normal = mat3(model) * texel.xyz;
+  viewDistance = distance(cameraPosition, vec3(morphed.x, texel.w, morphed.y));
+
+  gl_Position = projection * view * world;
+}
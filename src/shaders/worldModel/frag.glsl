@@ -3,9 +3,14 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D texture_diffuse1;
+// model textures are layers of texture arrays; rect places the texture inside its layer
+uniform sampler2DArray texture_diffuse1;
+uniform float texture_diffuse1_layer;
+uniform vec4 texture_diffuse1_rect = vec4(1.0, 1.0, 0.0, 0.0);
 
 void main()
 {
-    FragColor = texture(texture_diffuse1, TexCoords);
+    vec2 local = fract(TexCoords) * texture_diffuse1_rect.xy + texture_diffuse1_rect.zw;
+    FragColor = textureGrad(texture_diffuse1, vec3(local, texture_diffuse1_layer),
+                            dFdx(TexCoords) * texture_diffuse1_rect.xy, dFdy(TexCoords) * texture_diffuse1_rect.xy);
 }
@@ -0,0 +1,233 @@
+#ifndef TERRAIN_CDLOD_QUADTREE_H
+#define TERRAIN_CDLOD_QUADTREE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../camera/frustum.h"
+#include "terrainChunk.h"
+
+namespace nsi
+{
+  struct TerrainSettings
+  {
+    // side length of the square world, centred on the origin
+    float worldSize = 16384.0f;
+    // number of quadtree levels, the root is level lodLevels - 1
+    int lodLevels = 10;
+    // quads per patch side, must be a power of two
+    int gridSize = 32;
+    // lod range of a level as a multiple of its node size
+    float lodRangeScale = 2.5f;
+    // fraction of a level's range where morphing towards the parent starts
+    float morphStartRatio = 0.66f;
+    // children are requested once the viewer is this much past the finer range, so they
+    // are usually resident by the time the node has to split
+    float prefetchRatio = 1.5f;
+
+    // streaming, chunk builds running at once on the job system; 0 leaves one of its threads free
+    int streamingJobs = 0;
+    size_t uploadBudgetBytes = 512 * 1024;
+    size_t cpuBudgetBytes = 256 * 1024 * 1024;
+    size_t gpuBudgetBytes = 128 * 1024 * 1024;
+    // how much being behind the camera delays a chunk
+    float viewDirectionWeight = 2.0f;
+    // evicted chunk textures kept around for reuse
+    int spareChunkTextures = 8;
+  };
+
+  // one drawable patch; quadrantMask selects which quarters of the node are drawn
+  struct SelectedNode
+  {
+    ChunkKey key;
+    glm::vec2 origin;
+    float size;
+    glm::vec2 morphRange;
+    uint8_t quadrantMask;
+  };
+
+  // CDLOD node selection (Strugar 2010): each node is drawn by the finest level whose
+  // range contains it, and vertices morph into the parent grid before the switch
+  class CdlodQuadtree
+  {
+  public:
+    static constexpr uint8_t ALL_QUADRANTS = 0xF;
+
+    CdlodQuadtree() {}
+
+    CdlodQuadtree(const TerrainSettings &settings) : settings(settings)
+    {
+      ranges.resize(settings.lodLevels);
+      for (int level = 0; level < settings.lodLevels; level++)
+      {
+        ranges[level] = nodeSize(level) * settings.lodRangeScale;
+      }
+    }
+
+    int rootLevel() const { return settings.lodLevels - 1; }
+
+    ChunkKey rootKey() const { return ChunkKey{rootLevel(), 0, 0}; }
+
+    float nodeSize(int level) const
+    {
+      return settings.worldSize / float(1 << (settings.lodLevels - 1 - level));
+    }
+
+    glm::vec2 nodeOrigin(const ChunkKey &key) const
+    {
+      float size = nodeSize(key.level);
+      return glm::vec2(-0.5f * settings.worldSize) + glm::vec2(float(key.x), float(key.z)) * size;
+    }
+
+    float lodRange(int level) const { return ranges[level]; }
+
+    glm::vec2 morphRange(int level) const
+    {
+      float end = ranges[level];
+      float previous = level > 0 ? ranges[level - 1] : 0.0f;
+      float start = previous + (end - previous) * settings.morphStartRatio;
+      return glm::vec2(start, end);
+    }
+
+    // distance from the viewer to a node's box, used to order chunk requests
+    float distanceTo(const ChunkKey &key, const glm::vec3 &viewer, glm::vec2 heightBounds) const
+    {
+      glm::vec3 boxMin, boxMax;
+      nodeBox(key, heightBounds, boxMin, boxMax);
+      glm::vec3 closest = glm::clamp(viewer, boxMin, boxMax);
+      return glm::length(viewer - closest);
+    }
+
+    // nodes are only refined once all four children are resident, otherwise the parent
+    // keeps covering the area so missing data never leaves holes
+    void select(const glm::vec3 &viewer, const Frustum &frustum, ChunkProvider &provider, std::vector<SelectedNode> &out) const
+    {
+      out.clear();
+
+      ChunkKey root = rootKey();
+      const TerrainChunk *chunk = provider.find(root);
+      if (!chunk)
+      {
+        provider.request(root, 0.0f);
+        return;
+      }
+      provider.use(root);
+
+      if (!selectNode(root, *chunk, viewer, frustum, provider, out))
+      {
+        // beyond the coarsest range, the root still covers the world
+        glm::vec3 boxMin, boxMax;
+        nodeBox(root, glm::vec2(chunk->minHeight, chunk->maxHeight), boxMin, boxMax);
+        if (frustum.intersects(boxMin, boxMax))
+          out.push_back(makeNode(root, ALL_QUADRANTS));
+      }
+    }
+
+  private:
+    TerrainSettings settings;
+    std::vector<float> ranges;
+
+    void nodeBox(const ChunkKey &key, glm::vec2 heightBounds, glm::vec3 &boxMin, glm::vec3 &boxMax) const
+    {
+      glm::vec2 origin = nodeOrigin(key);
+      float size = nodeSize(key.level);
+      boxMin = glm::vec3(origin.x, heightBounds.x, origin.y);
+      boxMax = glm::vec3(origin.x + size, heightBounds.y, origin.y + size);
+    }
+
+    static bool sphereIntersectsBox(const glm::vec3 &center, float radius, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+      glm::vec3 closest = glm::clamp(center, boxMin, boxMax);
+      glm::vec3 delta = center - closest;
+      return glm::dot(delta, delta) <= radius * radius;
+    }
+
+    SelectedNode makeNode(const ChunkKey &key, uint8_t mask) const
+    {
+      return SelectedNode{key, nodeOrigin(key), nodeSize(key.level), morphRange(key.level), mask};
+    }
+
+    void prefetchChildren(const ChunkKey &key, const TerrainChunk &chunk, const glm::vec3 &viewer, ChunkProvider &provider) const
+    {
+      for (int i = 0; i < 4; i++)
+      {
+        ChunkKey child{key.level - 1, key.x * 2 + (i & 1), key.z * 2 + (i >> 1)};
+        if (!provider.find(child))
+          provider.request(child, distanceTo(child, viewer, glm::vec2(chunk.minHeight, chunk.maxHeight)));
+      }
+    }
+
+    // returns false when the node is outside its own lod range and the parent has to draw it
+    bool selectNode(const ChunkKey &key, const TerrainChunk &chunk, const glm::vec3 &viewer, const Frustum &frustum, ChunkProvider &provider, std::vector<SelectedNode> &out) const
+    {
+      glm::vec3 boxMin, boxMax;
+      nodeBox(key, glm::vec2(chunk.minHeight, chunk.maxHeight), boxMin, boxMax);
+
+      if (!sphereIntersectsBox(viewer, ranges[key.level], boxMin, boxMax))
+        return false;
+      // kept even when its children cover it, so refining never loses the coarse level
+      provider.use(key);
+
+      // culled, but handled
+      if (!frustum.intersects(boxMin, boxMax))
+        return true;
+
+      if (key.level == 0)
+      {
+        out.push_back(makeNode(key, ALL_QUADRANTS));
+        return true;
+      }
+
+      if (!sphereIntersectsBox(viewer, ranges[key.level - 1], boxMin, boxMax))
+      {
+        if (sphereIntersectsBox(viewer, ranges[key.level - 1] * settings.prefetchRatio, boxMin, boxMax))
+          prefetchChildren(key, chunk, viewer, provider);
+
+        out.push_back(makeNode(key, ALL_QUADRANTS));
+        return true;
+      }
+
+      // children in quadrant order: (0,0) (1,0) (0,1) (1,1)
+      ChunkKey children[4];
+      const TerrainChunk *childChunks[4];
+      bool childrenReady = true;
+
+      for (int i = 0; i < 4; i++)
+      {
+        children[i] = ChunkKey{key.level - 1, key.x * 2 + (i & 1), key.z * 2 + (i >> 1)};
+        childChunks[i] = provider.find(children[i]);
+
+        if (!childChunks[i])
+        {
+          provider.request(children[i], distanceTo(children[i], viewer, glm::vec2(chunk.minHeight, chunk.maxHeight)));
+          childrenReady = false;
+        }
+        else
+          provider.use(children[i]);
+      }
+
+      if (!childrenReady)
+      {
+        out.push_back(makeNode(key, ALL_QUADRANTS));
+        return true;
+      }
+
+      uint8_t mask = 0;
+      for (int i = 0; i < 4; i++)
+      {
+        if (!selectNode(children[i], *childChunks[i], viewer, frustum, provider, out))
+          mask |= uint8_t(1 << i);
+      }
+
+      if (mask)
+        out.push_back(makeNode(key, mask));
+
+      return true;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,435 @@
+#ifndef TERRAIN_CHUNK_STREAMER_H
+#define TERRAIN_CHUNK_STREAMER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../jobs/jobSystem.h"
+#include "cdlodQuadtree.h"
+#include "heightSource.h"
+#include "terrainChunk.h"
+
+namespace nsi
+{
+  struct StreamingStats
+  {
+    size_t residentChunks = 0;
+    size_t gpuBytes = 0;
+    size_t cpuChunks = 0;
+    size_t cpuBytes = 0;
+    size_t queued = 0;
+    size_t inFlight = 0;
+    size_t uploadsThisFrame = 0;
+    size_t uploadedBytesThisFrame = 0;
+    size_t evictedGpu = 0;
+    size_t evictedCpu = 0;
+  };
+
+  // generates chunk data as jobs and moves it to the GPU under a per-frame
+  // upload budget; both CPU copies and GPU textures are evicted least recently used first
+  class ChunkStreamer : public ChunkProvider
+  {
+  public:
+    // without jobs one chunk is built on the render thread per frame
+    ChunkStreamer(const HeightSource &source, const CdlodQuadtree &quadtree, const TerrainSettings &settings, JobSystem *jobs = nullptr)
+        : source(source), quadtree(quadtree), settings(settings), jobs(jobs)
+    {
+    }
+
+    ChunkStreamer(const ChunkStreamer &) = delete;
+    ChunkStreamer &operator=(const ChunkStreamer &) = delete;
+
+    ~ChunkStreamer() override
+    {
+      // running builds finish the chunk in hand and stop
+      {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.clear();
+      }
+      if (jobs)
+        jobs->wait(builds);
+
+      for (auto &entry : resident)
+      {
+        glDeleteTextures(1, &entry.second.texture);
+      }
+      if (!texturePool.empty())
+        glDeleteTextures(GLsizei(texturePool.size()), texturePool.data());
+    }
+
+    const TerrainChunk *find(const ChunkKey &key) const override
+    {
+      auto it = resident.find(key);
+      return it == resident.end() ? nullptr : &it->second;
+    }
+
+    // priority grows with distance, and with the angle away from where the camera looks
+    void request(const ChunkKey &key, float distance) override
+    {
+      glm::vec2 origin = quadtree.nodeOrigin(key);
+      float half = 0.5f * quadtree.nodeSize(key.level);
+      glm::vec3 toNode = glm::vec3(origin.x + half, viewer.y, origin.y + half) - viewer;
+
+      float facing = 1.0f;
+      float length = glm::length(toNode);
+      if (length > 1e-3f)
+        facing = 0.5f * (1.0f - glm::dot(toNode / length, viewForward));
+
+      float priority = distance * (1.0f + settings.viewDirectionWeight * facing);
+
+      auto it = wanted.find(key);
+      if (it == wanted.end() || priority < it->second)
+        wanted[key] = priority;
+    }
+
+    void use(const ChunkKey &key) override
+    {
+      auto it = resident.find(key);
+      if (it == resident.end())
+        return;
+      it->second.lastUsedFrame = frame;
+      inUse.insert(key);
+    }
+
+    // builds and uploads a chunk right away, used for the root so there is always something to draw
+    void load(const ChunkKey &key, uint64_t frame)
+    {
+      if (resident.count(key))
+        return;
+
+      ChunkData data = buildChunkData(source, key, quadtree.nodeOrigin(key), quadtree.nodeSize(key.level), settings.gridSize);
+      upload(data, frame);
+    }
+
+    // before the frame's selection, which marks what it uses
+    void beginFrame(const glm::vec3 &viewerPosition, const glm::vec3 &forward, uint64_t frame)
+    {
+      this->frame = frame;
+      viewer = viewerPosition;
+      viewForward = glm::length(forward) > 1e-6f ? glm::normalize(forward) : glm::vec3(0.0f, 0.0f, -1.0f);
+      wanted.clear();
+      inUse.clear();
+    }
+
+    void update(uint64_t frame)
+    {
+      stats.uploadsThisFrame = 0;
+      stats.uploadedBytesThisFrame = 0;
+
+      collectCompleted(frame);
+      uploadWanted(frame);
+      scheduleWanted();
+      evictGpu(frame);
+      evictCpu();
+
+      stats.residentChunks = resident.size();
+      stats.cpuChunks = cpuCache.size();
+      stats.inFlight = inFlight.load();
+    }
+
+    const StreamingStats &getStats() const { return stats; }
+
+  private:
+    struct CpuEntry
+    {
+      ChunkData data;
+      uint64_t lastUsedFrame = 0;
+    };
+
+    struct BuildRequest
+    {
+      ChunkKey key;
+      float priority;
+    };
+
+    const HeightSource &source;
+    const CdlodQuadtree &quadtree;
+    TerrainSettings settings;
+
+    // render thread state
+    std::unordered_map<ChunkKey, TerrainChunk, ChunkKeyHash> resident;
+    std::unordered_map<ChunkKey, CpuEntry, ChunkKeyHash> cpuCache;
+    std::unordered_map<ChunkKey, float, ChunkKeyHash> wanted;
+    // visited by this frame's selection, never evicted
+    std::unordered_set<ChunkKey, ChunkKeyHash> inUse;
+    uint64_t frame = 0;
+    std::vector<GLuint> texturePool;
+    glm::vec3 viewer = glm::vec3(0.0f);
+    glm::vec3 viewForward = glm::vec3(0.0f, 0.0f, -1.0f);
+    StreamingStats stats;
+
+    // shared with the build jobs
+    JobSystem *jobs;
+    JobCounter builds;
+    std::mutex queueMutex;
+    // sorted so the most urgent request is at the back
+    std::vector<BuildRequest> queue;
+    std::unordered_set<ChunkKey, ChunkKeyHash> building;
+    std::vector<ChunkData> completed;
+    std::atomic<size_t> inFlight{0};
+    // build jobs submitted and not yet out of work
+    size_t buildJobs = 0;
+
+    size_t chunkBytes() const
+    {
+      size_t resolution = size_t(settings.gridSize) + 1;
+      return resolution * resolution * sizeof(glm::vec4);
+    }
+
+    // build jobs running at once; the rest of the job system stays free for frame work
+    size_t maxBuildJobs() const
+    {
+      if (settings.streamingJobs > 0)
+        return size_t(settings.streamingJobs);
+      return size_t(std::max(1, jobs->concurrency() - 1));
+    }
+
+    // one build job: builds the most urgent request, then hands the next one to a job of
+    // its own, so no job runs long and one waiting for its own group never picks up many
+    void buildQueued()
+    {
+      BuildRequest request;
+      {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (queue.empty())
+        {
+          buildJobs--;
+          return;
+        }
+
+        request = queue.back();
+        queue.pop_back();
+        building.insert(request.key);
+        inFlight++;
+      }
+
+      ChunkData data = buildChunkData(source, request.key, quadtree.nodeOrigin(request.key), quadtree.nodeSize(request.key.level), settings.gridSize);
+
+      // stays in building until collected, so it is not queued again meanwhile
+      bool more = false;
+      {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        completed.push_back(std::move(data));
+        inFlight--;
+        more = jobs && !queue.empty();
+        if (!more)
+          buildJobs--;
+      }
+
+      // submitted before this job is counted finished, so builds never drains in between
+      if (more)
+      {
+        jobs->submit([this]()
+                     { buildQueued(); },
+                     builds);
+      }
+    }
+
+    void collectCompleted(uint64_t frame)
+    {
+      std::vector<ChunkData> finished;
+      {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        finished.swap(completed);
+        for (const ChunkData &data : finished)
+          building.erase(data.key);
+      }
+
+      for (ChunkData &data : finished)
+      {
+        ChunkKey key = data.key;
+        auto existing = cpuCache.find(key);
+        if (existing != cpuCache.end())
+          stats.cpuBytes -= existing->second.data.bytes();
+        stats.cpuBytes += data.bytes();
+        cpuCache[key] = CpuEntry{std::move(data), frame};
+      }
+    }
+
+    // uploads the most urgent chunks that already have CPU data, within the byte budget
+    void uploadWanted(uint64_t frame)
+    {
+      std::vector<BuildRequest> ready;
+      for (auto &entry : wanted)
+      {
+        if (!resident.count(entry.first) && cpuCache.count(entry.first))
+          ready.push_back({entry.first, entry.second});
+      }
+
+      std::sort(ready.begin(), ready.end(), [](const BuildRequest &a, const BuildRequest &b)
+                { return a.key.level != b.key.level ? a.key.level > b.key.level : a.priority < b.priority; });
+
+      for (const BuildRequest &request : ready)
+      {
+        // always let one through so a tiny budget cannot stall streaming
+        if (stats.uploadsThisFrame > 0 && stats.uploadedBytesThisFrame + chunkBytes() > settings.uploadBudgetBytes)
+          break;
+
+        CpuEntry &entry = cpuCache[request.key];
+        entry.lastUsedFrame = frame;
+        upload(entry.data, frame);
+      }
+    }
+
+    void upload(const ChunkData &data, uint64_t frame)
+    {
+      TerrainChunk chunk;
+      chunk.key = data.key;
+      chunk.minHeight = data.minHeight;
+      chunk.maxHeight = data.maxHeight;
+      chunk.lastUsedFrame = frame;
+
+      // every chunk has the same size, so evicted textures are refilled instead of reallocated
+      if (!texturePool.empty())
+      {
+        chunk.texture = texturePool.back();
+        texturePool.pop_back();
+
+        glBindTexture(GL_TEXTURE_2D, chunk.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, data.resolution, data.resolution, GL_RGBA, GL_FLOAT, data.texels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+      }
+      else
+      {
+        chunk.texture = uploadChunkTexture(data);
+      }
+
+      resident[data.key] = chunk;
+      stats.gpuBytes += data.bytes();
+      stats.uploadsThisFrame++;
+      stats.uploadedBytesThisFrame += data.bytes();
+    }
+
+    // replaces the build queue with this frame's wanted chunks that have no data yet
+    void scheduleWanted()
+    {
+      std::vector<BuildRequest> next;
+      for (auto &entry : wanted)
+      {
+        if (!resident.count(entry.first) && !cpuCache.count(entry.first))
+          next.push_back({entry.first, entry.second});
+      }
+
+      std::sort(next.begin(), next.end(), [](const BuildRequest &a, const BuildRequest &b)
+                { return a.key.level != b.key.level ? a.key.level < b.key.level : a.priority > b.priority; });
+
+      size_t submit = 0;
+      {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        next.erase(std::remove_if(next.begin(), next.end(), [this](const BuildRequest &request)
+                                  { return building.count(request.key) > 0; }),
+                   next.end());
+        queue.swap(next);
+        stats.queued = queue.size();
+
+        if (jobs)
+        {
+          size_t limit = std::min(queue.size(), maxBuildJobs());
+          if (buildJobs < limit)
+            submit = limit - buildJobs;
+          buildJobs += submit;
+        }
+      }
+
+      // only the most urgent one, collected next frame like a job's
+      if (!jobs)
+      {
+        if (!queue.empty())
+        {
+          queue.erase(queue.begin(), queue.end() - 1);
+          buildJobs++;
+          buildQueued();
+        }
+        return;
+      }
+
+      for (size_t i = 0; i < submit; i++)
+      {
+        jobs->submit([this]()
+                     { buildQueued(); },
+                     builds);
+      }
+    }
+
+    void evictGpu(uint64_t frame)
+    {
+      if (stats.gpuBytes <= settings.gpuBudgetBytes)
+        return;
+
+      std::vector<const TerrainChunk *> candidates;
+      for (auto &entry : resident)
+      {
+        if (!inUse.count(entry.first) && entry.second.lastUsedFrame != frame && !(entry.first == quadtree.rootKey()))
+          candidates.push_back(&entry.second);
+      }
+
+      std::sort(candidates.begin(), candidates.end(), [](const TerrainChunk *a, const TerrainChunk *b)
+                { return a->lastUsedFrame < b->lastUsedFrame; });
+
+      std::vector<ChunkKey> victims;
+      size_t bytes = stats.gpuBytes;
+      for (const TerrainChunk *chunk : candidates)
+      {
+        if (bytes <= settings.gpuBudgetBytes)
+          break;
+        victims.push_back(chunk->key);
+        bytes -= chunkBytes();
+      }
+
+      for (const ChunkKey &key : victims)
+      {
+        auto it = resident.find(key);
+        texturePool.push_back(it->second.texture);
+        resident.erase(it);
+        stats.gpuBytes -= chunkBytes();
+        stats.evictedGpu++;
+      }
+
+      // keep a handful of spare textures, free the rest
+      size_t spare = size_t(std::max(0, settings.spareChunkTextures));
+      if (texturePool.size() > spare)
+      {
+        glDeleteTextures(GLsizei(texturePool.size() - spare), texturePool.data() + spare);
+        texturePool.resize(spare);
+      }
+    }
+
+    void evictCpu()
+    {
+      if (stats.cpuBytes <= settings.cpuBudgetBytes)
+        return;
+
+      std::vector<std::pair<uint64_t, ChunkKey>> candidates;
+      for (auto &entry : cpuCache)
+      {
+        if (!(entry.first == quadtree.rootKey()))
+          candidates.push_back({entry.second.lastUsedFrame, entry.first});
+      }
+
+      std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b)
+                { return a.first < b.first; });
+
+      for (const auto &candidate : candidates)
+      {
+        if (stats.cpuBytes <= settings.cpuBudgetBytes)
+          break;
+
+        auto it = cpuCache.find(candidate.second);
+        stats.cpuBytes -= it->second.data.bytes();
+        cpuCache.erase(it);
+        stats.evictedCpu++;
+      }
+    }
+  };
+}
+
+#endif
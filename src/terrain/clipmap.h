@@ -0,0 +1,367 @@
+#ifndef TERRAIN_CLIPMAP_H
+#define TERRAIN_CLIPMAP_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../render/drawData.h"
+#include "heightSource.h"
+
+namespace nsi
+{
+  struct ClipmapSettings
+  {
+    int levels = 9;
+    // quads per level side, must be a multiple of 4
+    int gridSize = 128;
+    // vertex spacing of the finest level in world units
+    float spacing = 1.0f;
+    // width of the blend band towards the next coarser level, in quads
+    int transitionWidth = 12;
+  };
+
+  struct ClipmapStats
+  {
+    size_t drawCalls = 0;
+    size_t triangles = 0;
+    size_t uploadedTexels = 0;
+  };
+
+  // geometry clipmaps (Losasso & Hoppe 2004): nested square rings centred on the viewer,
+  // each twice as coarse as the previous. Geometry is static; each level reads heights
+  // from one layer of a toroidally addressed texture array, so moving the viewer only
+  // uploads the rows and columns that scrolled into view
+  class ClipmapTerrain
+  {
+  public:
+    ClipmapTerrain() {}
+
+    ClipmapTerrain(const ClipmapTerrain &) = delete;
+    ClipmapTerrain &operator=(const ClipmapTerrain &) = delete;
+
+    ~ClipmapTerrain()
+    {
+      if (heightmaps)
+        glDeleteTextures(1, &heightmaps);
+      fullGrid.release();
+      ring.release();
+    }
+
+    void init(const HeightSource &source, const ClipmapSettings &settings)
+    {
+      this->source = &source;
+      this->settings = settings;
+      this->settings.gridSize = std::max(8, settings.gridSize / 4 * 4);
+
+      // one texel of border on the low side, two on the high side for normals
+      textureSize = this->settings.gridSize + 4;
+      levels.assign(this->settings.levels, LevelState());
+      scratch.resize(size_t(textureSize) * textureSize);
+
+      glGenTextures(1, &heightmaps);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, heightmaps);
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, textureSize, textureSize, this->settings.levels, 0, GL_RED, GL_FLOAT, nullptr);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+      buildMeshes();
+    }
+
+    // snaps every level around the viewer and uploads the newly exposed strips
+    void update(const glm::vec3 &viewer)
+    {
+      this->viewer = viewer;
+      stats.uploadedTexels = 0;
+
+      int n = settings.gridSize;
+      for (int level = 0; level < settings.levels; level++)
+      {
+        LevelState &state = levels[level];
+        float spacing = levelSpacing(level);
+
+        // origins sit on even vertices so each level lines up with the next coarser one
+        state.originX = 2 * int64_t(std::floor(viewer.x / (2.0f * spacing))) - n / 2;
+        state.originZ = 2 * int64_t(std::floor(viewer.z / (2.0f * spacing))) - n / 2;
+
+        scroll(level, state.originX - 1, state.originZ - 1);
+      }
+
+      // where each finer level sits inside its parent's hole decides which side gets the trim
+      for (int level = 1; level < settings.levels; level++)
+      {
+        const LevelState &fine = levels[level - 1];
+        LevelState &state = levels[level];
+        state.trimParity.x = int(fine.originX / 2 - state.originX) - n / 4;
+        state.trimParity.y = int(fine.originZ / 2 - state.originZ) - n / 4;
+      }
+    }
+
+    // one draw record per level after update: the model matrix, then the level's origin,
+    // spacing, index and trim shift, which the shader reads instead of uniforms
+    void pushRecords(const glm::mat4 &model, DrawDataBuffer &records)
+    {
+      int n = settings.gridSize;
+      levelDrawIds.clear();
+      for (int level = 0; level < settings.levels; level++)
+      {
+        const LevelState &state = levels[level];
+        float spacing = levelSpacing(level);
+
+        DrawRecord record;
+        record.model = model;
+        record.params[0] = glm::vec4(glm::vec2(float(state.originX), float(state.originZ)) * spacing, spacing, float(level));
+        // trims are built for parity 0 and slide across the hole for parity 1
+        record.params[1] = glm::vec4(glm::vec2(state.trimParity) * float(-n / 2), 0.0f, 0.0f);
+        levelDrawIds.push_back(records.push(record));
+      }
+    }
+
+    // with the records pushRecords wrote this frame bound on unit 1
+    void draw(Shader &shader, DrawDataBuffer &records)
+    {
+      stats.drawCalls = 0;
+      stats.triangles = 0;
+
+      int n = settings.gridSize;
+
+      shader.setVec3("cameraPosition", viewer);
+      shader.setFloat("gridSize", float(n));
+      shader.setFloat("textureSize", float(textureSize));
+      shader.setFloat("transitionWidth", float(settings.transitionWidth));
+      shader.setInt("levelCount", settings.levels);
+      shader.setInt("heightmaps", 0);
+      records.bind(shader, 1);
+      // looked up once, it changes for every level
+      GLint drawIdLocation = glGetUniformLocation(shader.ID, "drawId");
+
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, heightmaps);
+
+      for (int level = 0; level < settings.levels; level++)
+      {
+        if (size_t(level) >= levelDrawIds.size() || levelDrawIds[level] < 0)
+          continue;
+        glUniform1i(drawIdLocation, levelDrawIds[level]);
+
+        const LevelMesh &mesh = level == 0 ? fullGrid : ring;
+        glBindVertexArray(mesh.VAO);
+        glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+
+        stats.drawCalls++;
+        stats.triangles += mesh.indexCount / 3;
+      }
+
+      glBindVertexArray(0);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    const ClipmapStats &getStats() const { return stats; }
+
+  private:
+    struct LevelMesh
+    {
+      GLuint VAO = 0, VBO = 0, EBO = 0;
+      GLsizei indexCount = 0;
+
+      void release()
+      {
+        if (EBO)
+          glDeleteBuffers(1, &EBO);
+        if (VBO)
+          glDeleteBuffers(1, &VBO);
+        if (VAO)
+          glDeleteVertexArrays(1, &VAO);
+        VAO = VBO = EBO = 0;
+      }
+    };
+
+    struct LevelState
+    {
+      // first vertex of the level, in units of the level's spacing
+      int64_t originX = 0;
+      int64_t originZ = 0;
+      // first texel held by the level's layer, same units
+      int64_t residentX = 0;
+      int64_t residentZ = 0;
+      glm::ivec2 trimParity = glm::ivec2(0);
+      bool valid = false;
+    };
+
+    const HeightSource *source = nullptr;
+    ClipmapSettings settings;
+    int textureSize = 0;
+    GLuint heightmaps = 0;
+    LevelMesh fullGrid;
+    LevelMesh ring;
+    std::vector<LevelState> levels;
+    // this frame's draw record per level, -1 where the records ran out
+    std::vector<int> levelDrawIds;
+    std::vector<float> scratch;
+    glm::vec3 viewer = glm::vec3(0.0f);
+    ClipmapStats stats;
+
+    float levelSpacing(int level) const { return settings.spacing * float(1 << level); }
+
+    static int64_t wrap(int64_t value, int64_t size)
+    {
+      int64_t r = value % size;
+      return r < 0 ? r + size : r;
+    }
+
+    // moves a level's resident window, uploading only what entered it
+    void scroll(int level, int64_t windowX, int64_t windowZ)
+    {
+      LevelState &state = levels[level];
+      int64_t size = textureSize;
+
+      int64_t deltaX = windowX - state.residentX;
+      int64_t deltaZ = windowZ - state.residentZ;
+      if (!state.valid || std::abs(deltaX) >= size || std::abs(deltaZ) >= size)
+      {
+        uploadRegion(level, windowX, windowZ, size, size);
+      }
+      else
+      {
+        // columns first over the new rows, then rows over the new columns
+        if (deltaX > 0)
+          uploadRegion(level, state.residentX + size, windowZ, deltaX, size);
+        else if (deltaX < 0)
+          uploadRegion(level, windowX, windowZ, -deltaX, size);
+
+        if (deltaZ > 0)
+          uploadRegion(level, windowX, state.residentZ + size, size, deltaZ);
+        else if (deltaZ < 0)
+          uploadRegion(level, windowX, windowZ, size, -deltaZ);
+      }
+
+      state.residentX = windowX;
+      state.residentZ = windowZ;
+      state.valid = true;
+    }
+
+    // samples a rectangle of level vertices and writes it where it wraps into the layer
+    void uploadRegion(int level, int64_t x0, int64_t z0, int64_t width, int64_t depth)
+    {
+      if (width <= 0 || depth <= 0)
+        return;
+
+      float spacing = levelSpacing(level);
+      int64_t size = textureSize;
+
+      glBindTexture(GL_TEXTURE_2D_ARRAY, heightmaps);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+      // split at the texture edge in both directions, at most four pieces
+      for (int64_t z = z0; z < z0 + depth;)
+      {
+        int64_t tz = wrap(z, size);
+        int64_t rows = std::min(z0 + depth - z, size - tz);
+
+        for (int64_t x = x0; x < x0 + width;)
+        {
+          int64_t tx = wrap(x, size);
+          int64_t columns = std::min(x0 + width - x, size - tx);
+
+          // world index * spacing stays exact for the level's own grid
+          float originX = float(x) * spacing;
+          for (int64_t row = 0; row < rows; row++)
+          {
+            source->sampleRow(originX, spacing, 0, int(columns), float(z + row) * spacing, scratch.data() + row * columns);
+          }
+
+          glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, GLint(tx), GLint(tz), level, GLsizei(columns), GLsizei(rows), 1, GL_RED, GL_FLOAT, scratch.data());
+          stats.uploadedTexels += size_t(columns * rows);
+
+          x += columns;
+        }
+
+        z += rows;
+      }
+
+      glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    // vertices are (x, z, trim) in quads; trim 1 / 2 marks the column / row strip
+    void buildMeshes()
+    {
+      int n = settings.gridSize;
+      int holeStart = n / 4;
+      int holeEnd = 3 * n / 4 + 1;
+
+      std::vector<glm::vec3> vertices;
+      std::vector<unsigned int> indices;
+
+      auto addGrid = [&](int x0, int z0, int columns, int rows, float trim, bool skipHole)
+      {
+        unsigned int base = unsigned(vertices.size());
+        for (int z = 0; z <= rows; z++)
+        {
+          for (int x = 0; x <= columns; x++)
+          {
+            vertices.push_back(glm::vec3(float(x0 + x), float(z0 + z), trim));
+          }
+        }
+
+        for (int z = 0; z < rows; z++)
+        {
+          for (int x = 0; x < columns; x++)
+          {
+            int cellX = x0 + x;
+            int cellZ = z0 + z;
+            if (skipHole && cellX >= holeStart && cellX < holeEnd && cellZ >= holeStart && cellZ < holeEnd)
+              continue;
+
+            unsigned int i0 = base + z * (columns + 1) + x;
+            unsigned int i1 = i0 + 1;
+            unsigned int i2 = i0 + (columns + 1);
+            unsigned int i3 = i2 + 1;
+            indices.insert(indices.end(), {i0, i2, i1, i1, i2, i3});
+          }
+        }
+      };
+
+      addGrid(0, 0, n, n, 0.0f, false);
+      upload(fullGrid, vertices, indices);
+
+      vertices.clear();
+      indices.clear();
+      addGrid(0, 0, n, n, 0.0f, true);
+      // L-shaped trim for parity 0, the shader mirrors each strip for parity 1
+      addGrid(3 * n / 4, holeStart, 1, holeEnd - holeStart, 1.0f, false);
+      addGrid(holeStart, 3 * n / 4, holeEnd - holeStart, 1, 2.0f, false);
+      upload(ring, vertices, indices);
+    }
+
+    void upload(LevelMesh &mesh, const std::vector<glm::vec3> &vertices, const std::vector<unsigned int> &indices)
+    {
+      glGenVertexArrays(1, &mesh.VAO);
+      glGenBuffers(1, &mesh.VBO);
+      glGenBuffers(1, &mesh.EBO);
+
+      glBindVertexArray(mesh.VAO);
+
+      glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+      glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+      glEnableVertexAttribArray(0);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+
+      glBindVertexArray(0);
+
+      mesh.indexCount = GLsizei(indices.size());
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef TERRAIN_HEIGHT_SOURCE_H
+#define TERRAIN_HEIGHT_SOURCE_H
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "heightfield.h"
+#include "../assets/assetRegistry.h"
+#include "../assets/packIOSystem.h"
+#include "../jobs/jobSystem.h"
+
+namespace nsi
+{
+  // anything the terrain can pull heights from
+  class HeightSource
+  {
+  public:
+    virtual ~HeightSource() = default;
+
+    virtual float heightAt(float x, float z) const = 0;
+
+    // lowest / highest height the source can produce, used for node bounds before data is resident
+    virtual glm::vec2 heightRange() const = 0;
+
+    // out[i] = height at (originX + (firstColumn + i) * spacing, z)
+    virtual void sampleRow(float originX, float spacing, int firstColumn, int count, float z, float *out) const
+    {
+      for (int i = 0; i < count; i++)
+      {
+        out[i] = heightAt(originX + float(firstColumn + i) * spacing, z);
+      }
+    }
+
+    // fills count * count samples starting at origin, row-major along +x
+    void sampleGrid(glm::vec2 origin, float spacing, int count, float *out) const
+    {
+      for (int row = 0; row < count; row++)
+      {
+        sampleRow(origin.x, spacing, 0, count, origin.y + float(row) * spacing, out + size_t(row) * count);
+      }
+    }
+  };
+
+  // heightfield rasterized from one mesh file, shared through the asset registry
+  struct MeshHeightData
+  {
+    Heightfield field;
+    // lowest point of the mesh, used outside it and for cells no triangle covers
+    float baseHeight = 0.0f;
+
+    size_t getMemoryBytes() const { return field.heights.size() * sizeof(float); }
+  };
+
+  // rasterizes a triangle mesh (e.g. a scanned OBJ) into a heightfield seen from above
+  class MeshHeightSource : public HeightSource
+  {
+  public:
+    // with a job system the mesh is rasterized in bands of rows on its workers. Sources of
+    // the same file and resolution share one heightfield
+    MeshHeightSource(const std::string &filePath, int resolution = 1024, JobSystem *jobs = nullptr)
+    {
+      data = AssetRegistry::get().acquire<MeshHeightData>("heightfield", filePath, unsigned(resolution), [&]()
+                                                          { return loadMesh(filePath, resolution, jobs); });
+
+      // a failed import is not cached, the source just stays flat
+      if (!data)
+        data = std::make_shared<MeshHeightData>();
+    }
+
+    float heightAt(float x, float z) const override
+    {
+      const Heightfield &field = data->field;
+      if (field.empty() || !field.contains(x, z))
+        return data->baseHeight;
+
+      return field.sample(x, z);
+    }
+
+    glm::vec2 heightRange() const override
+    {
+      return data->field.empty() ? glm::vec2(data->baseHeight) : data->field.range();
+    }
+
+    const Heightfield &getHeightfield() const { return data->field; }
+
+  private:
+    std::shared_ptr<const MeshHeightData> data;
+
+    static std::shared_ptr<MeshHeightData> loadMesh(const std::string &path, int resolution, JobSystem *jobs)
+    {
+      Assimp::Importer importer;
+      usePack(importer, jobs);
+      const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
+
+      if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+      {
+        std::cerr << "ERROR::TERRAIN::HEIGHT_SOURCE::" << importer.GetErrorString() << std::endl;
+        return nullptr;
+      }
+
+      glm::vec3 boundsMin(std::numeric_limits<float>::max());
+      glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+
+      for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+      {
+        const aiMesh *mesh = scene->mMeshes[m];
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+          glm::vec3 p(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+          boundsMin = glm::min(boundsMin, p);
+          boundsMax = glm::max(boundsMax, p);
+        }
+      }
+
+      auto data = std::make_shared<MeshHeightData>();
+      if (boundsMin.x > boundsMax.x)
+        return data;
+
+      float &baseHeight = data->baseHeight;
+      baseHeight = boundsMin.y;
+
+      float longest = std::max(boundsMax.x - boundsMin.x, boundsMax.z - boundsMin.z);
+      float spacing = std::max(longest / float(resolution), 1e-4f);
+      int width = int(std::ceil((boundsMax.x - boundsMin.x) / spacing)) + 1;
+      int depth = int(std::ceil((boundsMax.z - boundsMin.z) / spacing)) + 1;
+
+      Heightfield &field = data->field;
+      field = Heightfield(width, depth, glm::vec2(boundsMin.x, boundsMin.z), spacing, std::numeric_limits<float>::lowest());
+
+      std::vector<glm::vec3> triangles;
+      for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+      {
+        const aiMesh *mesh = scene->mMeshes[m];
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+        {
+          const aiFace &face = mesh->mFaces[f];
+          if (face.mNumIndices != 3)
+            continue;
+
+          for (int k = 0; k < 3; k++)
+          {
+            const aiVector3D &v = mesh->mVertices[face.mIndices[k]];
+            triangles.push_back(glm::vec3(v.x, v.y, v.z));
+          }
+        }
+      }
+
+      // bands of rows never share a sample, and max() makes the order irrelevant, so
+      // bands rasterize independently and the result matches the serial one
+      const int bandRows = 32;
+      int bands = (depth + bandRows - 1) / bandRows;
+      std::vector<std::vector<size_t>> bins(bands);
+      for (size_t t = 0; t < triangles.size(); t += 3)
+      {
+        float zMin = std::min({triangles[t].z, triangles[t + 1].z, triangles[t + 2].z});
+        float zMax = std::max({triangles[t].z, triangles[t + 1].z, triangles[t + 2].z});
+        int first = std::clamp(int(std::floor((zMin - field.origin.y) / spacing)) / bandRows, 0, bands - 1);
+        int last = std::clamp(int(std::ceil((zMax - field.origin.y) / spacing)) / bandRows, 0, bands - 1);
+        for (int band = first; band <= last; band++)
+        {
+          bins[band].push_back(t);
+        }
+      }
+
+      auto rasterizeBands = [&](size_t begin, size_t end)
+      {
+        for (size_t band = begin; band < end; band++)
+        {
+          int rowBegin = int(band) * bandRows;
+          int rowEnd = std::min(depth, rowBegin + bandRows);
+          for (size_t t : bins[band])
+          {
+            rasterizeTriangle(field, triangles[t], triangles[t + 1], triangles[t + 2], rowBegin, rowEnd);
+          }
+        }
+      };
+
+      if (jobs)
+        jobs->parallelFor(size_t(bands), 1, rasterizeBands);
+      else
+        rasterizeBands(0, size_t(bands));
+
+      // cells no triangle covered fall back to the lowest point of the mesh
+      for (float &h : field.heights)
+      {
+        if (h == std::numeric_limits<float>::lowest())
+          h = baseHeight;
+      }
+
+      return data;
+    }
+
+    // keeps the highest surface hit at each grid sample, only touching rows [rowBegin, rowEnd)
+    static void rasterizeTriangle(Heightfield &field, glm::vec3 a, glm::vec3 b, glm::vec3 c, int rowBegin, int rowEnd)
+    {
+      float area = (b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z);
+      if (std::abs(area) < 1e-12f)
+        return;
+
+      int x0 = std::max(0, int(std::floor((std::min({a.x, b.x, c.x}) - field.origin.x) / field.spacing)));
+      int x1 = std::min(field.width - 1, int(std::ceil((std::max({a.x, b.x, c.x}) - field.origin.x) / field.spacing)));
+      int z0 = std::max(rowBegin, int(std::floor((std::min({a.z, b.z, c.z}) - field.origin.y) / field.spacing)));
+      int z1 = std::min(rowEnd - 1, int(std::ceil((std::max({a.z, b.z, c.z}) - field.origin.y) / field.spacing)));
+
+      for (int z = z0; z <= z1; z++)
+      {
+        for (int x = x0; x <= x1; x++)
+        {
+          float px = field.origin.x + x * field.spacing;
+          float pz = field.origin.y + z * field.spacing;
+
+          // barycentric weights in the xz plane
+          float w0 = ((b.x - px) * (c.z - pz) - (c.x - px) * (b.z - pz)) / area;
+          float w1 = ((c.x - px) * (a.z - pz) - (a.x - px) * (c.z - pz)) / area;
+          float w2 = 1.0f - w0 - w1;
+
+          const float epsilon = -1e-5f;
+          if (w0 < epsilon || w1 < epsilon || w2 < epsilon)
+            continue;
+
+          float h = w0 * a.y + w1 * b.y + w2 * c.y;
+          float &cell = field.at(x, z);
+          cell = std::max(cell, h);
+        }
+      }
+    }
+  };
+
+  // source mesh where it exists and a fill source everywhere else, blended over a margin
+  // inside the mesh border so the two meet without a cliff
+  class BlendedHeightSource : public HeightSource
+  {
+  public:
+    BlendedHeightSource(std::unique_ptr<MeshHeightSource> detail, std::unique_ptr<HeightSource> fill, float blendMargin = 50.0f)
+        : detail(std::move(detail)), fill(std::move(fill)), blendMargin(std::max(blendMargin, 1e-3f)) {}
+
+    float heightAt(float x, float z) const override
+    {
+      return blend(x, z, fill->heightAt(x, z));
+    }
+
+    glm::vec2 heightRange() const override
+    {
+      glm::vec2 a = detail->heightRange();
+      glm::vec2 b = fill->heightRange();
+      return glm::vec2(std::min(a.x, b.x), std::max(a.y, b.y));
+    }
+
+    // the fill source keeps its batched path, only samples over the mesh are revisited
+    void sampleRow(float originX, float spacing, int firstColumn, int count, float z, float *out) const override
+    {
+      fill->sampleRow(originX, spacing, firstColumn, count, z, out);
+
+      const Heightfield &field = detail->getHeightfield();
+      if (field.empty())
+        return;
+
+      for (int i = 0; i < count; i++)
+      {
+        float x = originX + float(firstColumn + i) * spacing;
+        if (field.contains(x, z))
+          out[i] = blend(x, z, out[i]);
+      }
+    }
+
+  private:
+    std::unique_ptr<MeshHeightSource> detail;
+    std::unique_ptr<HeightSource> fill;
+    float blendMargin;
+
+    float blend(float x, float z, float fillHeight) const
+    {
+      const Heightfield &field = detail->getHeightfield();
+      if (field.empty() || !field.contains(x, z))
+        return fillHeight;
+
+      glm::vec2 local = glm::vec2(x, z) - field.origin;
+      glm::vec2 size = field.extent();
+      float border = std::min(std::min(local.x, size.x - local.x), std::min(local.y, size.y - local.y));
+
+      float t = std::clamp(border / blendMargin, 0.0f, 1.0f);
+      t = t * t * (3.0f - 2.0f * t);
+      return fillHeight + (field.sample(x, z) - fillHeight) * t;
+    }
+  };
+}
+
+#endif
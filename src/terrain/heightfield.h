@@ -0,0 +1,91 @@
+#ifndef TERRAIN_HEIGHTFIELD_H
+#define TERRAIN_HEIGHTFIELD_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace nsi
+{
+  // regular grid of height samples laid out row-major along +x, rows along +z
+  struct Heightfield
+  {
+    int width = 0;
+    int depth = 0;
+    glm::vec2 origin = glm::vec2(0.0f);
+    float spacing = 1.0f;
+    std::vector<float> heights;
+
+    Heightfield() {}
+
+    Heightfield(int width, int depth, glm::vec2 origin, float spacing, float fill = 0.0f)
+        : width(width), depth(depth), origin(origin), spacing(spacing), heights(size_t(width) * depth, fill) {}
+
+    bool empty() const { return heights.empty(); }
+
+    float &at(int x, int z) { return heights[size_t(z) * width + x]; }
+    float at(int x, int z) const { return heights[size_t(z) * width + x]; }
+
+    float atClamped(int x, int z) const
+    {
+      x = std::clamp(x, 0, width - 1);
+      z = std::clamp(z, 0, depth - 1);
+      return at(x, z);
+    }
+
+    glm::vec2 extent() const { return glm::vec2((width - 1) * spacing, (depth - 1) * spacing); }
+
+    bool contains(float x, float z) const
+    {
+      glm::vec2 local = glm::vec2(x, z) - origin;
+      glm::vec2 size = extent();
+      return local.x >= 0.0f && local.y >= 0.0f && local.x <= size.x && local.y <= size.y;
+    }
+
+    // bilinear sample in world units, clamped to the grid edge
+    float sample(float x, float z) const
+    {
+      float gx = (x - origin.x) / spacing;
+      float gz = (z - origin.y) / spacing;
+
+      gx = std::clamp(gx, 0.0f, float(width - 1));
+      gz = std::clamp(gz, 0.0f, float(depth - 1));
+
+      int x0 = std::min(int(gx), width - 2);
+      int z0 = std::min(int(gz), depth - 2);
+      float fx = gx - x0;
+      float fz = gz - z0;
+
+      float h00 = at(x0, z0);
+      float h10 = at(x0 + 1, z0);
+      float h01 = at(x0, z0 + 1);
+      float h11 = at(x0 + 1, z0 + 1);
+
+      float top = h00 + (h10 - h00) * fx;
+      float bottom = h01 + (h11 - h01) * fx;
+      return top + (bottom - top) * fz;
+    }
+
+    glm::vec3 normal(float x, float z) const
+    {
+      float left = sample(x - spacing, z);
+      float right = sample(x + spacing, z);
+      float back = sample(x, z - spacing);
+      float front = sample(x, z + spacing);
+      return glm::normalize(glm::vec3(left - right, 2.0f * spacing, back - front));
+    }
+
+    glm::vec2 range() const
+    {
+      if (heights.empty())
+        return glm::vec2(0.0f);
+
+      auto [lo, hi] = std::minmax_element(heights.begin(), heights.end());
+      return glm::vec2(*lo, *hi);
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef TERRAIN_NOISE_H
+#define TERRAIN_NOISE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define NSI_NOISE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace nsi
+{
+  // 2D simplex noise (Gustavson) with a seeded permutation table. The AVX2 path evaluates
+  // eight samples with exactly the scalar operation order and no FMA, so both paths
+  // return bit-identical values and results never depend on how work was split
+  class SimplexNoise
+  {
+  public:
+    explicit SimplexNoise(uint32_t seed = 0)
+    {
+      for (int i = 0; i < 256; i++)
+      {
+        perm[i] = i;
+      }
+
+      // Fisher-Yates on splitmix64, std::shuffle is not portable across standard libraries
+      uint64_t state = seed;
+      for (int i = 255; i > 0; i--)
+      {
+        int j = int(splitmix64(state) % uint64_t(i + 1));
+        std::swap(perm[i], perm[j]);
+      }
+
+      for (int i = 0; i < 256; i++)
+      {
+        perm[i + 256] = perm[i];
+      }
+    }
+
+    // roughly in [-1, 1]
+    float sample(float x, float y) const
+    {
+      float s = (x + y) * F2;
+      float fi = std::floor(x + s);
+      float fj = std::floor(y + s);
+      float t = (fi + fj) * G2;
+
+      float x0 = x - (fi - t);
+      float y0 = y - (fj - t);
+
+      float i1 = x0 > y0 ? 1.0f : 0.0f;
+      float j1 = 1.0f - i1;
+
+      float x1 = x0 - i1 + G2;
+      float y1 = y0 - j1 + G2;
+      float x2 = x0 + G2_2_MINUS_1;
+      float y2 = y0 + G2_2_MINUS_1;
+
+      int ii = int(fi) & 255;
+      int jj = int(fj) & 255;
+      int ii1 = int(i1);
+      int jj1 = int(j1);
+
+      int g0 = perm[ii + perm[jj]] & 7;
+      int g1 = perm[ii + ii1 + perm[jj + jj1]] & 7;
+      int g2 = perm[ii + 1 + perm[jj + 1]] & 7;
+
+      float n = corner(x0, y0, g0) + corner(x1, y1, g1);
+      n = n + corner(x2, y2, g2);
+      return 70.0f * n;
+    }
+
+#if NSI_NOISE_AVX2
+    __attribute__((target("avx2"))) __m256 sample8(__m256 x, __m256 y) const
+    {
+      const __m256 f2 = _mm256_set1_ps(F2);
+      const __m256 g2 = _mm256_set1_ps(G2);
+      const __m256 one = _mm256_set1_ps(1.0f);
+
+      __m256 s = _mm256_mul_ps(_mm256_add_ps(x, y), f2);
+      __m256 fi = _mm256_floor_ps(_mm256_add_ps(x, s));
+      __m256 fj = _mm256_floor_ps(_mm256_add_ps(y, s));
+      __m256 t = _mm256_mul_ps(_mm256_add_ps(fi, fj), g2);
+
+      __m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(fi, t));
+      __m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(fj, t));
+
+      __m256 i1 = _mm256_and_ps(_mm256_cmp_ps(x0, y0, _CMP_GT_OQ), one);
+      __m256 j1 = _mm256_sub_ps(one, i1);
+
+      __m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, i1), g2);
+      __m256 y1 = _mm256_add_ps(_mm256_sub_ps(y0, j1), g2);
+      __m256 x2 = _mm256_add_ps(x0, _mm256_set1_ps(G2_2_MINUS_1));
+      __m256 y2 = _mm256_add_ps(y0, _mm256_set1_ps(G2_2_MINUS_1));
+
+      const __m256i mask255 = _mm256_set1_epi32(255);
+      const __m256i mask7 = _mm256_set1_epi32(7);
+      const __m256i oneI = _mm256_set1_epi32(1);
+
+      __m256i ii = _mm256_and_si256(_mm256_cvttps_epi32(fi), mask255);
+      __m256i jj = _mm256_and_si256(_mm256_cvttps_epi32(fj), mask255);
+      __m256i ii1 = _mm256_cvttps_epi32(i1);
+      __m256i jj1 = _mm256_cvttps_epi32(j1);
+
+      __m256i pj0 = _mm256_i32gather_epi32(perm, jj, 4);
+      __m256i pj1 = _mm256_i32gather_epi32(perm, _mm256_add_epi32(jj, jj1), 4);
+      __m256i pj2 = _mm256_i32gather_epi32(perm, _mm256_add_epi32(jj, oneI), 4);
+
+      __m256i g0 = _mm256_and_si256(_mm256_i32gather_epi32(perm, _mm256_add_epi32(ii, pj0), 4), mask7);
+      __m256i g1 = _mm256_and_si256(_mm256_i32gather_epi32(perm, _mm256_add_epi32(_mm256_add_epi32(ii, ii1), pj1), 4), mask7);
+      __m256i g2i = _mm256_and_si256(_mm256_i32gather_epi32(perm, _mm256_add_epi32(_mm256_add_epi32(ii, oneI), pj2), 4), mask7);
+
+      __m256 n = _mm256_add_ps(corner8(x0, y0, g0), corner8(x1, y1, g1));
+      n = _mm256_add_ps(n, corner8(x2, y2, g2i));
+      return _mm256_mul_ps(_mm256_set1_ps(70.0f), n);
+    }
+#endif
+
+  private:
+    static constexpr float F2 = 0.366025403784f;
+    static constexpr float G2 = 0.211324865405f;
+    static constexpr float G2_2_MINUS_1 = 2.0f * G2 - 1.0f;
+
+    static constexpr float GRAD_X[8] = {1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f};
+    static constexpr float GRAD_Y[8] = {1.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 1.0f, -1.0f};
+
+    alignas(32) int32_t perm[512];
+
+    static uint64_t splitmix64(uint64_t &state)
+    {
+      uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
+
+    static float corner(float x, float y, int gradient)
+    {
+      float t = 0.5f - x * x - y * y;
+      t = std::max(t, 0.0f);
+      float t2 = t * t;
+      return t2 * t2 * (GRAD_X[gradient] * x + GRAD_Y[gradient] * y);
+    }
+
+#if NSI_NOISE_AVX2
+    __attribute__((target("avx2"))) static __m256 corner8(__m256 x, __m256 y, __m256i gradient)
+    {
+      __m256 gx = _mm256_permutevar8x32_ps(_mm256_loadu_ps(GRAD_X), gradient);
+      __m256 gy = _mm256_permutevar8x32_ps(_mm256_loadu_ps(GRAD_Y), gradient);
+
+      __m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+      t = _mm256_max_ps(t, _mm256_setzero_ps());
+      __m256 t2 = _mm256_mul_ps(t, t);
+      __m256 dot = _mm256_add_ps(_mm256_mul_ps(gx, x), _mm256_mul_ps(gy, y));
+      return _mm256_mul_ps(_mm256_mul_ps(t2, t2), dot);
+    }
+#endif
+  };
+
+  inline bool cpuHasAvx2()
+  {
+#if NSI_NOISE_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+  }
+}
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef TERRAIN_NOISE_HEIGHT_SOURCE_H
+#define TERRAIN_NOISE_HEIGHT_SOURCE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../jobs/jobSystem.h"
+#include "heightfield.h"
+#include "heightSource.h"
+#include "noise.h"
+
+namespace nsi
+{
+  struct NoiseSettings
+  {
+    uint32_t seed = 1337;
+    // base feature size is 1 / frequency world units
+    float frequency = 1.0f / 1500.0f;
+    int octaves = 7;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    // 0 = smooth fBm hills, 1 = ridged mountains
+    float ridgedMix = 0.6f;
+    // domain warp displacement in world units, 0 disables warping
+    float warpStrength = 400.0f;
+    float warpFrequency = 1.0f / 3000.0f;
+    int warpOctaves = 2;
+    float amplitude = 600.0f;
+    float baseHeight = 0.0f;
+  };
+
+  // fBm / ridged simplex terrain with domain warping; rows are evaluated eight samples
+  // at a time when the CPU has AVX2
+  class NoiseHeightSource : public HeightSource
+  {
+  public:
+    static constexpr int MAX_OCTAVES = 16;
+
+    NoiseHeightSource(const NoiseSettings &settings = NoiseSettings()) : settings(settings), noise(settings.seed)
+    {
+      this->settings.octaves = std::clamp(settings.octaves, 1, MAX_OCTAVES);
+      this->settings.warpOctaves = std::clamp(settings.warpOctaves, 1, MAX_OCTAVES);
+
+      // per octave offsets decorrelate the octaves around the origin
+      SimplexNoise offsets(settings.seed ^ 0x5bd1e995u);
+      for (int i = 0; i < MAX_OCTAVES; i++)
+      {
+        octaveOffset[i] = glm::vec2(offsets.sample(float(i) * 1.7f, 0.5f), offsets.sample(0.5f, float(i) * 1.3f)) * 1000.0f;
+      }
+
+      invNorm = 1.0f / amplitudeSum(this->settings.octaves);
+      invWarpNorm = 1.0f / amplitudeSum(this->settings.warpOctaves);
+      warpScale = settings.warpStrength * settings.frequency;
+    }
+
+    float heightAt(float x, float z) const override
+    {
+      float px = x * settings.frequency;
+      float pz = z * settings.frequency;
+
+      if (settings.warpStrength != 0.0f)
+      {
+        float wx = x * settings.warpFrequency;
+        float wz = z * settings.warpFrequency;
+        float dx = fbm(wx + 5.2f, wz + 1.3f, settings.warpOctaves, 0.0f, invWarpNorm);
+        float dz = fbm(wx + 9.7f, wz + 2.8f, settings.warpOctaves, 0.0f, invWarpNorm);
+        px = px + dx * warpScale;
+        pz = pz + dz * warpScale;
+      }
+
+      return settings.baseHeight + settings.amplitude * fbm(px, pz, settings.octaves, settings.ridgedMix, invNorm);
+    }
+
+    glm::vec2 heightRange() const override
+    {
+      // simplex peaks slightly above 1
+      float extent = settings.amplitude * 1.1f;
+      return glm::vec2(settings.baseHeight - extent, settings.baseHeight + extent);
+    }
+
+    void sampleRow(float originX, float spacing, int firstColumn, int count, float z, float *out) const override
+    {
+      int i = 0;
+
+#if NSI_NOISE_AVX2
+      if (simdEnabled && cpuHasAvx2())
+        i = sampleRow8(originX, spacing, firstColumn, count, z, out);
+#endif
+
+      for (; i < count; i++)
+      {
+        out[i] = heightAt(originX + float(firstColumn + i) * spacing, z);
+      }
+    }
+
+    // benchmarks compare against the scalar path
+    void setSimdEnabled(bool enabled) { simdEnabled = enabled; }
+
+    const NoiseSettings &getSettings() const { return settings; }
+
+  private:
+    NoiseSettings settings;
+    SimplexNoise noise;
+    glm::vec2 octaveOffset[MAX_OCTAVES];
+    float invNorm = 1.0f;
+    float invWarpNorm = 1.0f;
+    float warpScale = 0.0f;
+    bool simdEnabled = true;
+
+    float amplitudeSum(int octaves) const
+    {
+      float sum = 0.0f;
+      float amplitude = 1.0f;
+      for (int o = 0; o < octaves; o++)
+      {
+        sum += amplitude;
+        amplitude *= settings.gain;
+      }
+      return sum;
+    }
+
+    float fbm(float x, float y, int octaves, float ridgedMix, float norm) const
+    {
+      float sum = 0.0f;
+      float amplitude = 1.0f;
+
+      for (int o = 0; o < octaves; o++)
+      {
+        float n = noise.sample(x + octaveOffset[o].x, y + octaveOffset[o].y);
+
+        // ridges where the noise crosses zero
+        float ridge = 1.0f - std::fabs(n);
+        ridge = ridge * ridge * 2.0f - 1.0f;
+        float value = n + (ridge - n) * ridgedMix;
+
+        sum = sum + value * amplitude;
+        amplitude = amplitude * settings.gain;
+        x = x * settings.lacunarity;
+        y = y * settings.lacunarity;
+      }
+
+      return sum * norm;
+    }
+
+#if NSI_NOISE_AVX2
+    __attribute__((target("avx2"))) __m256 fbm8(__m256 x, __m256 y, int octaves, float ridgedMix, float norm) const
+    {
+      const __m256 signMask = _mm256_set1_ps(-0.0f);
+      const __m256 one = _mm256_set1_ps(1.0f);
+      const __m256 two = _mm256_set1_ps(2.0f);
+      const __m256 mix = _mm256_set1_ps(ridgedMix);
+      const __m256 gain = _mm256_set1_ps(settings.gain);
+      const __m256 lacunarity = _mm256_set1_ps(settings.lacunarity);
+
+      __m256 sum = _mm256_setzero_ps();
+      __m256 amplitude = one;
+
+      for (int o = 0; o < octaves; o++)
+      {
+        __m256 n = noise.sample8(_mm256_add_ps(x, _mm256_set1_ps(octaveOffset[o].x)), _mm256_add_ps(y, _mm256_set1_ps(octaveOffset[o].y)));
+
+        __m256 ridge = _mm256_sub_ps(one, _mm256_andnot_ps(signMask, n));
+        ridge = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(ridge, ridge), two), one);
+        __m256 value = _mm256_add_ps(n, _mm256_mul_ps(_mm256_sub_ps(ridge, n), mix));
+
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(value, amplitude));
+        amplitude = _mm256_mul_ps(amplitude, gain);
+        x = _mm256_mul_ps(x, lacunarity);
+        y = _mm256_mul_ps(y, lacunarity);
+      }
+
+      return _mm256_mul_ps(sum, _mm256_set1_ps(norm));
+    }
+
+    __attribute__((target("avx2"))) int sampleRow8(float originX, float spacing, int firstColumn, int count, float z, float *out) const
+    {
+      const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+      const __m256 zv = _mm256_set1_ps(z);
+      const __m256 frequency = _mm256_set1_ps(settings.frequency);
+      const __m256 warpFrequency = _mm256_set1_ps(settings.warpFrequency);
+      const __m256 scale = _mm256_set1_ps(warpScale);
+
+      int i = 0;
+      for (; i + 8 <= count; i += 8)
+      {
+        __m256i column = _mm256_add_epi32(_mm256_set1_epi32(firstColumn + i), lanes);
+        __m256 x = _mm256_add_ps(_mm256_set1_ps(originX), _mm256_mul_ps(_mm256_cvtepi32_ps(column), _mm256_set1_ps(spacing)));
+
+        __m256 px = _mm256_mul_ps(x, frequency);
+        __m256 pz = _mm256_mul_ps(zv, frequency);
+
+        if (settings.warpStrength != 0.0f)
+        {
+          __m256 wx = _mm256_mul_ps(x, warpFrequency);
+          __m256 wz = _mm256_mul_ps(zv, warpFrequency);
+          __m256 dx = fbm8(_mm256_add_ps(wx, _mm256_set1_ps(5.2f)), _mm256_add_ps(wz, _mm256_set1_ps(1.3f)), settings.warpOctaves, 0.0f, invWarpNorm);
+          __m256 dz = fbm8(_mm256_add_ps(wx, _mm256_set1_ps(9.7f)), _mm256_add_ps(wz, _mm256_set1_ps(2.8f)), settings.warpOctaves, 0.0f, invWarpNorm);
+          px = _mm256_add_ps(px, _mm256_mul_ps(dx, scale));
+          pz = _mm256_add_ps(pz, _mm256_mul_ps(dz, scale));
+        }
+
+        __m256 h = fbm8(px, pz, settings.octaves, settings.ridgedMix, invNorm);
+        h = _mm256_add_ps(_mm256_set1_ps(settings.baseHeight), _mm256_mul_ps(_mm256_set1_ps(settings.amplitude), h));
+        _mm256_storeu_ps(out + i, h);
+      }
+
+      return i;
+    }
+#endif
+  };
+
+  // fills a large heightfield in square tiles spread over the job system; every sample is
+  // computed independently, so the result is identical for any worker count
+  inline Heightfield generateHeightfield(const NoiseHeightSource &source, glm::vec2 origin, float spacing, int width, int depth, JobSystem &jobs, int tileSize = 64)
+  {
+    Heightfield field(width, depth, origin, spacing);
+
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesZ = (depth + tileSize - 1) / tileSize;
+
+    jobs.parallelFor(size_t(tilesX) * tilesZ, 1, [&](size_t begin, size_t end)
+                     {
+                       for (size_t tile = begin; tile < end; tile++)
+                       {
+                         int x0 = int(tile % tilesX) * tileSize;
+                         int z0 = int(tile / tilesX) * tileSize;
+                         int columns = std::min(tileSize, width - x0);
+                         int rows = std::min(tileSize, depth - z0);
+
+                         for (int row = z0; row < z0 + rows; row++)
+                         {
+                           float z = origin.y + float(row) * spacing;
+                           source.sampleRow(origin.x, spacing, x0, columns, z, &field.at(x0, row));
+                         }
+                       } });
+
+    return field;
+  }
+}
+
+#endif
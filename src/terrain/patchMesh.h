@@ -0,0 +1,128 @@
+#ifndef TERRAIN_PATCH_MESH_H
+#define TERRAIN_PATCH_MESH_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace nsi
+{
+  // the one grid every terrain node is drawn with; vertices are integer grid coordinates
+  // and indices are grouped per quadrant so a node can draw any subset of its quarters
+  class PatchMesh
+  {
+  public:
+    PatchMesh() {}
+
+    PatchMesh(const PatchMesh &) = delete;
+    PatchMesh &operator=(const PatchMesh &) = delete;
+
+    ~PatchMesh()
+    {
+      if (EBO)
+        glDeleteBuffers(1, &EBO);
+      if (VBO)
+        glDeleteBuffers(1, &VBO);
+      if (VAO)
+        glDeleteVertexArrays(1, &VAO);
+    }
+
+    void init(int gridSize)
+    {
+      this->gridSize = gridSize;
+
+      std::vector<glm::vec2> vertices;
+      vertices.reserve((gridSize + 1) * (gridSize + 1));
+      for (int z = 0; z <= gridSize; z++)
+      {
+        for (int x = 0; x <= gridSize; x++)
+        {
+          vertices.push_back(glm::vec2(float(x), float(z)));
+        }
+      }
+
+      int half = gridSize / 2;
+      std::vector<unsigned int> indices;
+      indices.reserve(gridSize * gridSize * 6);
+
+      for (int quadrant = 0; quadrant < 4; quadrant++)
+      {
+        int startX = (quadrant & 1) * half;
+        int startZ = (quadrant >> 1) * half;
+
+        for (int z = startZ; z < startZ + half; z++)
+        {
+          for (int x = startX; x < startX + half; x++)
+          {
+            unsigned int i0 = z * (gridSize + 1) + x;
+            unsigned int i1 = i0 + 1;
+            unsigned int i2 = i0 + (gridSize + 1);
+            unsigned int i3 = i2 + 1;
+
+            indices.insert(indices.end(), {i0, i2, i1, i1, i2, i3});
+          }
+        }
+      }
+
+      quadrantIndexCount = half * half * 6;
+
+      glGenVertexArrays(1, &VAO);
+      glGenBuffers(1, &VBO);
+      glGenBuffers(1, &EBO);
+
+      glBindVertexArray(VAO);
+
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), vertices.data(), GL_STATIC_DRAW);
+
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+      // grid coordinate attribute
+      glEnableVertexAttribArray(0);
+      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)0);
+
+      glBindVertexArray(0);
+    }
+
+    int getGridSize() const { return gridSize; }
+
+    int trianglesPerQuadrant() const { return quadrantIndexCount / 3; }
+
+    // merges neighbouring quadrants into one draw call; returns draw calls issued
+    int drawQuadrants(uint8_t mask) const
+    {
+      int calls = 0;
+
+      glBindVertexArray(VAO);
+      for (int quadrant = 0; quadrant < 4;)
+      {
+        if (!(mask & (1 << quadrant)))
+        {
+          quadrant++;
+          continue;
+        }
+
+        int first = quadrant;
+        while (quadrant < 4 && (mask & (1 << quadrant)))
+          quadrant++;
+
+        size_t offset = size_t(first) * quadrantIndexCount * sizeof(unsigned int);
+        glDrawElements(GL_TRIANGLES, (quadrant - first) * quadrantIndexCount, GL_UNSIGNED_INT, (void *)offset);
+        calls++;
+      }
+      glBindVertexArray(0);
+
+      return calls;
+    }
+
+  private:
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    int gridSize = 0;
+    int quadrantIndexCount = 0;
+  };
+}
+
+#endif
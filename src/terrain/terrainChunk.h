@@ -0,0 +1,137 @@
+#ifndef TERRAIN_CHUNK_H
+#define TERRAIN_CHUNK_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "heightSource.h"
+
+namespace nsi
+{
+  // quadtree node address; level 0 is the finest lod
+  struct ChunkKey
+  {
+    int level = 0;
+    int x = 0;
+    int z = 0;
+
+    bool operator==(const ChunkKey &other) const
+    {
+      return level == other.level && x == other.x && z == other.z;
+    }
+  };
+
+  struct ChunkKeyHash
+  {
+    size_t operator()(const ChunkKey &key) const
+    {
+      uint64_t packed = (uint64_t(uint32_t(key.level)) << 48) ^ (uint64_t(uint32_t(key.x)) << 24) ^ uint64_t(uint32_t(key.z));
+      return std::hash<uint64_t>()(packed);
+    }
+  };
+
+  // CPU side of a chunk: (gridSize + 1)^2 texels of (normal.xyz, height)
+  struct ChunkData
+  {
+    ChunkKey key;
+    int resolution = 0;
+    std::vector<glm::vec4> texels;
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+
+    size_t bytes() const { return texels.size() * sizeof(glm::vec4); }
+  };
+
+  // a chunk the renderer can draw
+  struct TerrainChunk
+  {
+    ChunkKey key;
+    GLuint texture = 0;
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+    uint64_t lastUsedFrame = 0;
+  };
+
+  // what the quadtree selection needs from whoever owns chunk residency
+  class ChunkProvider
+  {
+  public:
+    virtual ~ChunkProvider() = default;
+
+    // nullptr while the chunk is not ready to draw
+    virtual const TerrainChunk *find(const ChunkKey &key) const = 0;
+
+    // lower priority values are served first
+    virtual void request(const ChunkKey &key, float priority) = 0;
+
+    // a resident chunk the selection visited this frame; it must survive until drawn
+    virtual void use(const ChunkKey &key) {}
+  };
+
+  // samples one node's heights plus a one texel border so normals are continuous across chunks
+  inline ChunkData buildChunkData(const HeightSource &source, const ChunkKey &key, glm::vec2 origin, float size, int gridSize)
+  {
+    ChunkData data;
+    data.key = key;
+    data.resolution = gridSize + 1;
+
+    float spacing = size / float(gridSize);
+    int bordered = gridSize + 3;
+
+    std::vector<float> heights(size_t(bordered) * bordered);
+    source.sampleGrid(origin - glm::vec2(spacing), spacing, bordered, heights.data());
+
+    data.texels.resize(size_t(data.resolution) * data.resolution);
+    data.minHeight = std::numeric_limits<float>::max();
+    data.maxHeight = std::numeric_limits<float>::lowest();
+
+    for (int z = 0; z < data.resolution; z++)
+    {
+      for (int x = 0; x < data.resolution; x++)
+      {
+        int bx = x + 1;
+        int bz = z + 1;
+
+        float h = heights[bz * bordered + bx];
+        float left = heights[bz * bordered + bx - 1];
+        float right = heights[bz * bordered + bx + 1];
+        float back = heights[(bz - 1) * bordered + bx];
+        float front = heights[(bz + 1) * bordered + bx];
+
+        glm::vec3 normal = glm::normalize(glm::vec3(left - right, 2.0f * spacing, back - front));
+        data.texels[z * data.resolution + x] = glm::vec4(normal, h);
+
+        data.minHeight = std::min(data.minHeight, h);
+        data.maxHeight = std::max(data.maxHeight, h);
+      }
+    }
+
+    return data;
+  }
+
+  inline GLuint uploadChunkTexture(const ChunkData &data)
+  {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, data.resolution, data.resolution, 0, GL_RGBA, GL_FLOAT, data.texels.data());
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+  }
+}
+
+#endif